@@ -0,0 +1,433 @@
+//
+// hexeditor.c library file
+// blockcache.c
+//
+// Provides a cache of pages of the original file, with read-ahead.
+//
+// Demonstration:
+//
+//   Buckets:   [0] -> page 4 -> page 12     Pages are found by hashing their index into a bucket.
+//              [1] -> page 9
+//              [2]
+//              [3] -> page 7
+//
+//   Age:       newest  page 9 <-> page 7 <-> page 4 <-> page 12  oldest
+//
+// Every page that is read moves to the newest end of the age list, and once the cache holds as many pages as its
+// memory budget allows, the oldest page is reused for the next page read (least recently used eviction).
+//
+// Read-ahead runs on its own thread. When the editor scrolls, it asks for the next few pages in the direction of the
+// scroll, which are read in the background, so holding down an arrow key finds its pages already cached. A new
+// request replaces one that has not started yet, so read-ahead never falls behind the editor.
+//
+
+// Avoid redefinition errors during compilation
+#ifndef FILE_BLOCKCACHE_SEEN
+#define FILE_BLOCKCACHE_SEEN
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "filemap.h"
+
+#define BLOCKCACHE_MIN_PAGE 4096 // Smallest page size.
+#define BLOCKCACHE_MAX_PAGE 65536 // Largest page size.
+#define BLOCKCACHE_READAHEAD 8 // Fewest pages read ahead of a scroll.
+
+typedef struct cachePage
+{
+    unsigned long int index; // The number of the page in the file (offset / page size).
+    unsigned char *data; // The contents of the page.
+    struct cachePage *newer; // The page used after this one.
+    struct cachePage *older; // The page used before this one.
+    struct cachePage *nextInBucket; // The next page in the same bucket.
+} cachePage;
+
+typedef struct
+{
+    fileMap *file; // The file being cached.
+    unsigned long int pageSize; // The size of each page in bytes.
+    int pageLimit; // The most pages the memory budget allows.
+    int pageCount; // The number of pages allocated.
+    cachePage **buckets; // The pages, hashed by index.
+    int bucketCount; // The number of buckets.
+    cachePage *newest; // The page used most recently.
+    cachePage *oldest; // The page used least recently.
+    pthread_mutex_t lock; // Protects everything above and the read-ahead request.
+    pthread_cond_t wake; // Signalled when read-ahead is requested or the cache is being freed.
+    pthread_t thread; // The read-ahead thread.
+    unsigned long int aheadIndex; // The first page to read ahead.
+    int aheadDirection; // 1 to read pages after aheadIndex, -1 for pages before it.
+    int aheadPending; // Whether a read-ahead request is waiting.
+    int aheadPages; // The number of pages read ahead of a scroll.
+    int stopping; // Set when the cache is being freed.
+    unsigned long int generation; // Changed whenever every page is dropped, so that reads in progress are retried.
+    unsigned long int hits; // Reads of pages that were cached.
+    unsigned long int misses; // Reads of pages that had to be read from the file.
+} blockCache;
+
+// Finds a cached page. The lock must be held. Only available in scope of blockcache.c
+// cache: pointer to the cache.
+// index: the number of the page.
+//
+// Returns: the page, or NULL if it is not cached.
+static cachePage *findCachePage(blockCache *cache, unsigned long int index)
+{
+    for (cachePage *page = cache->buckets[index % cache->bucketCount]; page; page = page->nextInBucket)
+    {
+        if (page->index == index)
+        {
+            return page;
+        }
+    }
+
+    return NULL;
+}
+
+// Removes a page from the age list. The lock must be held. Only available in scope of blockcache.c
+// cache: pointer to the cache.
+// page: the page.
+static void unlinkCachePage(blockCache *cache, cachePage *page)
+{
+    if (page->newer)
+    {
+        page->newer->older = page->older;
+    }
+    else
+    {
+        cache->newest = page->older;
+    }
+    if (page->older)
+    {
+        page->older->newer = page->newer;
+    }
+    else
+    {
+        cache->oldest = page->newer;
+    }
+}
+
+// Puts a page at the newest end of the age list. The lock must be held. Only available in scope of blockcache.c
+// cache: pointer to the cache.
+// page: the page, which must not be in the age list.
+static void linkCachePage(blockCache *cache, cachePage *page)
+{
+    page->older = cache->newest;
+    page->newer = NULL;
+    if (cache->newest)
+    {
+        cache->newest->newer = page;
+    }
+    cache->newest = page;
+    if (cache->oldest == NULL)
+    {
+        cache->oldest = page;
+    }
+}
+
+// Removes a page from its bucket. The lock must be held. Only available in scope of blockcache.c
+// cache: pointer to the cache.
+// page: the page.
+static void removeCachePage(blockCache *cache, cachePage *page)
+{
+    cachePage **link = &cache->buckets[page->index % cache->bucketCount]; // The pointer to the page.
+    while (*link != page)
+    {
+        link = &(*link)->nextInBucket;
+    }
+    *link = page->nextInBucket;
+}
+
+// Reads a page from the file into the cache, unless it is already cached. Only available in scope of blockcache.c
+// cache: pointer to the cache. The lock must not be held.
+// index: the number of the page.
+// buffer: where the page is read to, which must hold pageSize bytes.
+//
+// Returns: the page. The lock is held on return.
+static cachePage *loadCachePage(blockCache *cache, unsigned long int index, unsigned char *buffer)
+{
+    pthread_mutex_lock(&cache->lock);
+    while (1)
+    {
+        unsigned long int generation = cache->generation; // Whether the read below is still current afterwards.
+        pthread_mutex_unlock(&cache->lock);
+
+        // Read the page without holding the lock, so that other readers are not held up by the file.
+        readFileMap(cache->file, index * cache->pageSize, buffer, cache->pageSize);
+
+        // Read the page again if the file was written to while it was being read.
+        pthread_mutex_lock(&cache->lock);
+        if (cache->generation == generation)
+        {
+            break;
+        }
+    }
+
+    // Another thread may have read the page in the meantime.
+    cachePage *page = findCachePage(cache, index);
+    if (page)
+    {
+        return page;
+    }
+
+    // Use a new page while the budget allows, otherwise reuse the oldest page.
+    if (cache->pageCount < cache->pageLimit || cache->oldest == NULL)
+    {
+        page = (cachePage *)calloc(1, sizeof(cachePage));
+        page->data = (unsigned char *)malloc(cache->pageSize);
+        cache->pageCount++;
+    }
+    else
+    {
+        page = cache->oldest;
+        unlinkCachePage(cache, page);
+        removeCachePage(cache, page);
+    }
+
+    page->index = index;
+    memcpy(page->data, buffer, cache->pageSize);
+    page->nextInBucket = cache->buckets[index % cache->bucketCount];
+    cache->buckets[index % cache->bucketCount] = page;
+    linkCachePage(cache, page);
+
+    return page;
+}
+
+// The loop the read-ahead thread runs. Only available in scope of blockcache.c
+// argument: pointer to the cache.
+//
+// Returns: NULL.
+static void *runBlockCacheReadAhead(void *argument)
+{
+    blockCache *cache = (blockCache *)argument;
+    unsigned char *buffer = (unsigned char *)malloc(cache->pageSize); // The page being read.
+    unsigned long int pages = (cache->file->size + cache->pageSize - 1) / cache->pageSize; // Number of pages in the file.
+
+    pthread_mutex_lock(&cache->lock);
+    while (1)
+    {
+        while (!cache->aheadPending && !cache->stopping)
+        {
+            pthread_cond_wait(&cache->wake, &cache->lock);
+        }
+        if (cache->stopping)
+        {
+            break;
+        }
+
+        unsigned long int index = cache->aheadIndex;
+        int direction = cache->aheadDirection;
+        cache->aheadPending = 0;
+
+        // Read each page that is not cached, stopping early if a newer request arrives.
+        for (int i = 0; i < cache->aheadPages && index < pages && !cache->aheadPending && !cache->stopping; i++)
+        {
+            if (findCachePage(cache, index) == NULL)
+            {
+                pthread_mutex_unlock(&cache->lock);
+                loadCachePage(cache, index, buffer);
+            }
+
+            if (direction < 0 && index == 0)
+            {
+                break;
+            }
+            index += direction;
+        }
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    free(buffer);
+    return NULL;
+}
+
+// Generate a block cache.
+// file: the file being cached.
+// pageSize: the size of each page, between BLOCKCACHE_MIN_PAGE and BLOCKCACHE_MAX_PAGE. Rounded to a power of two.
+// budget: the most memory the pages may use, in bytes. At least 2 * BLOCKCACHE_READAHEAD pages are always allowed.
+//
+// Returns: the generated cache.
+blockCache *buildBlockCache(fileMap *file, unsigned long int pageSize, unsigned long int budget)
+{
+    // Allocate memory for cache.
+    blockCache *obj = (blockCache *)calloc(1, sizeof(blockCache));
+
+    // Initialise cache variables.
+    obj->file = file;
+    obj->pageSize = BLOCKCACHE_MIN_PAGE;
+    while (obj->pageSize < pageSize && obj->pageSize < BLOCKCACHE_MAX_PAGE)
+    {
+        obj->pageSize *= 2;
+    }
+    obj->pageLimit = budget / obj->pageSize;
+    if (obj->pageLimit < 2 * BLOCKCACHE_READAHEAD)
+    {
+        obj->pageLimit = 2 * BLOCKCACHE_READAHEAD;
+    }
+    obj->aheadPages = BLOCKCACHE_READAHEAD;
+    obj->bucketCount = obj->pageLimit * 2 + 1;
+    obj->buckets = (cachePage **)calloc(obj->bucketCount, sizeof(cachePage *));
+    pthread_mutex_init(&obj->lock, NULL);
+    pthread_cond_init(&obj->wake, NULL);
+    pthread_create(&obj->thread, NULL, runBlockCacheReadAhead, obj);
+
+    return obj;
+}
+
+// Copies a segment of the file into a buffer through the cache. Any part of the segment past the end of the file is
+// filled with zeroes.
+// cache: pointer to the cache.
+// offset: the start position of reading from the file.
+// buffer: the buffer being written to.
+// length: the number of bytes to read.
+//
+// Returns: the number of bytes that were read from the file.
+unsigned long int readBlockCache(blockCache *cache, unsigned long int offset, void *buffer, unsigned long int length)
+{
+    unsigned long int available = offset < cache->file->size ? cache->file->size - offset : 0; // Bytes that exist past offset.
+    unsigned long int count = length < available ? length : available; // Bytes that will be read.
+    unsigned char *pageBuffer = NULL; // Buffer for pages that have to be read, allocated on the first miss.
+
+    for (unsigned long int done = 0; done < count; )
+    {
+        unsigned long int index = (offset + done) / cache->pageSize; // The page being read.
+        unsigned long int skip = (offset + done) % cache->pageSize; // Bytes of the page before the segment.
+        unsigned long int part = cache->pageSize - skip < count - done ? cache->pageSize - skip : count - done;
+
+        pthread_mutex_lock(&cache->lock);
+        cachePage *page = findCachePage(cache, index);
+        if (page)
+        {
+            cache->hits++;
+        }
+        else
+        {
+            cache->misses++;
+            pthread_mutex_unlock(&cache->lock);
+            if (pageBuffer == NULL)
+            {
+                pageBuffer = (unsigned char *)malloc(cache->pageSize);
+            }
+            page = loadCachePage(cache, index, pageBuffer);
+        }
+
+        // Mark the page as the newest and copy from it.
+        unlinkCachePage(cache, page);
+        linkCachePage(cache, page);
+        memcpy((char *)buffer + done, page->data + skip, part);
+        pthread_mutex_unlock(&cache->lock);
+
+        done += part;
+    }
+
+    free(pageBuffer);
+    memset((char *)buffer + count, 0, length - count);
+    return count;
+}
+
+// Asks for the pages next to an offset to be read in the background.
+// cache: pointer to the cache.
+// offset: the offset the editor is moving towards.
+// direction: 1 to read the pages from offset onwards, -1 for the pages from offset backwards.
+void readAheadBlockCache(blockCache *cache, unsigned long int offset, int direction)
+{
+    pthread_mutex_lock(&cache->lock);
+    cache->aheadIndex = offset / cache->pageSize;
+    cache->aheadDirection = direction < 0 ? -1 : 1;
+    cache->aheadPending = 1;
+    pthread_cond_signal(&cache->wake);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// Changes the memory budget of a cache and how far it reads ahead, for when more of the file is shown at once. Pages
+// over the new budget are dropped, oldest first.
+// cache: pointer to the cache.
+// budget: the most memory the pages may use, in bytes. Always allows at least twice the pages read ahead.
+// aheadBytes: the number of bytes read ahead of a scroll. At least BLOCKCACHE_READAHEAD pages are read ahead.
+void resizeBlockCache(blockCache *cache, unsigned long int budget, unsigned long int aheadBytes)
+{
+    pthread_mutex_lock(&cache->lock);
+
+    cache->aheadPages = (aheadBytes + cache->pageSize - 1) / cache->pageSize;
+    if (cache->aheadPages < BLOCKCACHE_READAHEAD)
+    {
+        cache->aheadPages = BLOCKCACHE_READAHEAD;
+    }
+    cache->pageLimit = budget / cache->pageSize;
+    if (cache->pageLimit < 2 * cache->aheadPages)
+    {
+        cache->pageLimit = 2 * cache->aheadPages;
+    }
+
+    // Drop the oldest pages until the cache fits.
+    while (cache->pageCount > cache->pageLimit)
+    {
+        cachePage *page = cache->oldest;
+        unlinkCachePage(cache, page);
+        removeCachePage(cache, page);
+        free(page->data);
+        free(page);
+        cache->pageCount--;
+    }
+
+    // Rehash the pages into more buckets if the cache can now hold more pages than there are buckets.
+    if (cache->pageLimit * 2 + 1 > cache->bucketCount)
+    {
+        free(cache->buckets);
+        cache->bucketCount = cache->pageLimit * 2 + 1;
+        cache->buckets = (cachePage **)calloc(cache->bucketCount, sizeof(cachePage *));
+        for (cachePage *page = cache->newest; page; page = page->older)
+        {
+            page->nextInBucket = cache->buckets[page->index % cache->bucketCount];
+            cache->buckets[page->index % cache->bucketCount] = page;
+        }
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// Drops every page, for when the file has been written to.
+// cache: pointer to the cache.
+void invalidateBlockCache(blockCache *cache)
+{
+    pthread_mutex_lock(&cache->lock);
+    for (cachePage *page = cache->newest; page; )
+    {
+        cachePage *older = page->older;
+        free(page->data);
+        free(page);
+        page = older;
+    }
+    memset(cache->buckets, 0, sizeof(cachePage *) * cache->bucketCount);
+    cache->newest = NULL;
+    cache->oldest = NULL;
+    cache->pageCount = 0;
+    cache->generation++;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// Stops read-ahead and frees a cache. The file is not closed.
+// cache: pointer to the cache.
+void freeBlockCache(blockCache *cache)
+{
+    if (cache == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    cache->stopping = 1;
+    pthread_cond_signal(&cache->wake);
+    pthread_mutex_unlock(&cache->lock);
+    pthread_join(cache->thread, NULL);
+
+    invalidateBlockCache(cache);
+    pthread_mutex_destroy(&cache->lock);
+    pthread_cond_destroy(&cache->wake);
+    free(cache->buckets);
+    free(cache);
+}
+
+#endif
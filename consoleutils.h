@@ -9,6 +9,10 @@
 #ifndef FILE_CONSOLEUTILS_SEEN
 #define FILE_CONSOLEUTILS_SEEN
 
+#include <stdio.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/signalfd.h>
 #include <sys/ioctl.h>
 #include <termios.h>
 #include <unistd.h>
@@ -16,6 +20,48 @@
 struct winsize w; // The window size of the current terminal
 struct termios oldt; // The initial terminal on execution of the program.
 struct termios currentt; // The current terminal after changing settings.
+#define INPUT_QUEUE_LENGTH 4096 // Most bytes of input read from STDIN at once.
+#define ESCAPE_TIMEOUT 50 // Milliseconds to wait for the rest of an escape sequence before treating escape as its own key.
+
+// Keys that are sent as escape sequences, numbered after every character.
+enum Key
+{
+    keyEscape = 256,
+    keyUp,
+    keyDown,
+    keyRight,
+    keyLeft,
+    keyPageUp,
+    keyPageDown,
+    keyHome,
+    keyEnd,
+    keyInsert,
+    keyDelete,
+    keyUnknown
+};
+
+int windowResized; // Set when the terminal has been resized, until updateWindowSize() is called.
+int signalFd = -1; // The file descriptor signals are read from instead of being handled.
+
+static unsigned char inputQueue[INPUT_QUEUE_LENGTH]; // Input read from STDIN that has not been used yet.
+static int inputHead; // The next byte of inputQueue to use.
+static int inputTail; // The end of the bytes in inputQueue.
+static int inputPeeking; // Set while peekKey() reads ahead, so that no more input is read.
+
+// Restores the initial console and shows the cursor again, then ends the program the way the signal would have.
+// Only available in scope of consoleutils.c
+// signal: the signal number.
+static void handleTerminate(int signal)
+{
+    const char reset[] = "\033[0;0m\033[?25h\n"; // Resets colours and shows the cursor.
+    tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
+    write(STDOUT_FILENO, reset, sizeof(reset) - 1);
+
+    struct sigaction original = { 0 };
+    original.sa_handler = SIG_DFL;
+    sigaction(signal, &original, NULL);
+    raise(signal);
+}
 
 // Removes the requirement for an EOL at character input.
 void toggleEOFRequirement()
@@ -41,12 +87,237 @@ void restoreConsole(int terminal)
     }
 }
 
+// Waits for input to be available on STDIN, including input that has been read but not used yet.
+// timeout: the longest time to wait in milliseconds, or -1 to wait until there is input.
+//
+// Returns: 1 if input is available, 0 if the time ran out.
+int waitForInput(int timeout)
+{
+    if (inputHead < inputTail)
+    {
+        return 1;
+    }
+
+    struct pollfd input = { STDIN_FILENO, POLLIN, 0 };
+    return poll(&input, 1, timeout) > 0;
+}
+
+// Waits for input on STDIN or a signal, such as the terminal being resized.
+// timeout: the longest time to wait in milliseconds, or -1 to wait until something happens.
+//
+// Returns: 1 if input is available, 0 if a signal arrived or the time ran out.
+int waitForEvents(int timeout)
+{
+    if (inputHead < inputTail)
+    {
+        return 1;
+    }
+
+    struct pollfd events[2] = { { STDIN_FILENO, POLLIN, 0 }, { signalFd, POLLIN, 0 } };
+    if (poll(events, signalFd == -1 ? 1 : 2, timeout) <= 0)
+    {
+        return 0;
+    }
+
+    // Record the signals that arrived.
+    if (events[1].revents & POLLIN)
+    {
+        struct signalfd_siginfo info;
+        while (read(signalFd, &info, sizeof(info)) == sizeof(info))
+        {
+            if (info.ssi_signo == SIGWINCH)
+            {
+                windowResized = 1;
+            }
+        }
+    }
+
+    return (events[0].revents & (POLLIN | POLLHUP)) != 0;
+}
+
+// Reads a byte of input, reading every byte that is waiting on STDIN at once. Only available in scope of consoleutils.c
+// timeout: the longest time to wait for input in milliseconds, or -1 to wait until there is input.
+//
+// Returns: the byte, or EOF if there is no input.
+static int readInputByte(int timeout)
+{
+    if (inputHead == inputTail)
+    {
+        if (inputPeeking || !waitForInput(timeout))
+        {
+            return EOF;
+        }
+
+        ssize_t count = read(STDIN_FILENO, inputQueue, INPUT_QUEUE_LENGTH);
+        if (count <= 0)
+        {
+            return EOF;
+        }
+        inputHead = 0;
+        inputTail = count;
+    }
+
+    return inputQueue[inputHead++];
+}
+
+// Reads a line of input, for use while the console requires an EOL. Input that was read before is used first.
+// buffer: the buffer the line is read to, without the newline.
+// length: the size of buffer. Anything past it on the line is discarded.
+void readInputLine(char *buffer, int length)
+{
+    int used = 0; // Bytes written to buffer.
+    for (int c = readInputByte(-1); c != '\n' && c != EOF; c = readInputByte(-1))
+    {
+        if (used < length - 1)
+        {
+            buffer[used++] = c;
+        }
+    }
+    buffer[used] = '\0';
+}
+
+// Reads the window size again if the terminal has been resized.
+//
+// Returns: 1 if the window size changed, otherwise 0.
+int updateWindowSize()
+{
+    if (!windowResized)
+    {
+        return 0;
+    }
+    windowResized = 0;
+
+    struct winsize previous = w; // The window size before the resize.
+    ioctl(0, TIOCGWINSZ, &w);
+    return w.ws_row != previous.ws_row || w.ws_col != previous.ws_col;
+}
+
+// Reads a key, decoding the escape sequences sent by arrows, page up / down, home and end. Sequences may be sent as
+// ESC [ or ESC O, and may carry numbers (such as ESC [ 5 ~ for page up, or ESC [ 1 ; 5 A for an arrow with a
+// modifier, which is read as the plain arrow).
+//
+// Returns: the character, a value of enum Key, or EOF if no key could be read.
+int readKey()
+{
+    int c = readInputByte(-1);
+    if (c != 27)
+    {
+        return c;
+    }
+
+    // Escape on its own is a key.
+    int introducer = readInputByte(ESCAPE_TIMEOUT); // The character after escape, [ for CSI or O for SS3.
+    if (introducer == EOF)
+    {
+        return keyEscape;
+    }
+    if (introducer != '[' && introducer != 'O')
+    {
+        return keyUnknown;
+    }
+
+    // Read the parameter bytes, keeping the first number, up to the final byte.
+    int number = 0; // The first number of the parameters.
+    int inNumber = 1; // Whether the first number is still being read.
+    int d = readInputByte(ESCAPE_TIMEOUT);
+    while (d >= 0x20 && d <= 0x3F)
+    {
+        if (d >= '0' && d <= '9' && inNumber)
+        {
+            number = number * 10 + d - '0';
+        }
+        else
+        {
+            inNumber = 0;
+        }
+        d = readInputByte(ESCAPE_TIMEOUT);
+    }
+
+    switch (d)
+    {
+        case 'A':
+            return keyUp;
+        case 'B':
+            return keyDown;
+        case 'C':
+            return keyRight;
+        case 'D':
+            return keyLeft;
+        case 'H':
+            return keyHome;
+        case 'F':
+            return keyEnd;
+        case '~':
+            switch (number)
+            {
+                case 1:
+                case 7:
+                    return keyHome;
+                case 2:
+                    return keyInsert;
+                case 3:
+                    return keyDelete;
+                case 4:
+                case 8:
+                    return keyEnd;
+                case 5:
+                    return keyPageUp;
+                case 6:
+                    return keyPageDown;
+            }
+            return keyUnknown;
+        default:
+            return keyUnknown;
+    }
+}
+
+// Finds the key readKey() would return next, without using it. Only input that has already been read is looked at.
+//
+// Returns: the key, or EOF if no complete key has been read yet.
+int peekKey()
+{
+    if (inputHead == inputTail)
+    {
+        return EOF;
+    }
+
+    int head = inputHead; // Where the key starts.
+    inputPeeking = 1;
+    int key = readKey();
+    inputPeeking = 0;
+
+    // A sequence that has not been read in full is not a key yet.
+    if (key == keyEscape && inputHead == inputTail && inputQueue[inputTail - 1] == 27)
+    {
+        key = EOF;
+    }
+    inputHead = head;
+
+    return key;
+}
+
 // Initialises variables for these functions to work.
 void initialiseConsoleutils()
 {
     tcgetattr(STDIN_FILENO, &oldt);
     currentt = oldt;
     ioctl(0, TIOCGWINSZ, &w);
+
+    // Read the terminal being resized from a file descriptor, so that it can be waited for along with input. The
+    // signal is blocked before any thread is started, so that every thread inherits the mask.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGWINCH);
+    sigprocmask(SIG_BLOCK, &signals, NULL);
+    signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    // Restore the console if the program is interrupted, terminated or loses its terminal.
+    struct sigaction terminate = { 0 };
+    terminate.sa_handler = handleTerminate;
+    sigemptyset(&terminate.sa_mask);
+    sigaction(SIGINT, &terminate, NULL);
+    sigaction(SIGTERM, &terminate, NULL);
+    sigaction(SIGHUP, &terminate, NULL);
 }
 
 #endif
@@ -9,13 +9,18 @@
 //   +-----------+-----------+-----------+-----------+-----------+
 //   |           |           |           |           |           |
 //   |  Segment  |  Segment  |  Segment  |  Segment  |  Segment  |
-//   |     0     |     1     |     2     |     3     |     4     |
+//   |     3     |     4     |     0     |     1     |     2     |
 //   |           |           |           |           |           |
 //   +-----------+-----------+-----------+-----------+-----------+
+//                           ^ back
 //
 // Values can be inserted at the front of the deque (first non-filled segment) or inserted at the back of the
 // deque (first segment) which pushes all of the other segments up 1 segment, if the deque has space.
-// 
+//
+// Every segment lives in one block of memory that is allocated when the deque is built. The block is used as a
+// circle: segment 0 is wherever back points to, and the segments after it wrap around to the start of the block.
+// Inserting or deleting at either end only moves back or changes the count, so it never allocates or moves segments.
+//
 
 // Avoid redefinition errors during compilation
 #ifndef FILE_DEQUE_SEEN
@@ -27,10 +32,11 @@
 
 typedef struct
 {
-    int front; // Distance from beginnning of allocated memory.
+    int back; // The slot of the block that holds segment 0.
+    int count; // The number of segments in use.
     int arrayLength; // Length of each element of the deque.
     int length; // Length of the deque.
-    char **d; // Underlying data.
+    char *d; // Underlying data, length slots of arrayLength bytes.
 } deque;
 
 // Checks deque object is valid. Only available in scope of deque.c
@@ -64,21 +70,38 @@ static void checkDequeArguments(deque *deque, char *array)
     }
 }
 
+// Finds where a segment is stored. Only available in scope of deque.c
+// deque: pointer to the deque.
+// index: the number of the segment, from the back.
+//
+// Returns: pointer to the segment.
+static char *findDequeSegment(deque *deque, int index)
+{
+    int slot = deque->back + index; // The slot of the segment, wrapped around the end of the block.
+    if (slot >= deque->length)
+    {
+        slot -= deque->length;
+    }
+
+    return deque->d + (long int)slot * deque->arrayLength;
+}
+
 // Generate a deque.
 // length: the length of the deque.
 // arrayLength: the length of each element of the deque.
 //
 // Returns: the generated deque.
 deque *buildDeque(int length, int arrayLength)
-{   
+{
     // Allocate memory for deque.
-    deque *obj = (deque *)malloc(length * arrayLength + sizeof(int) * 4);
+    deque *obj = (deque *)malloc(sizeof(deque));
 
     // Initialise deque variables.
-    obj->front = -1;
+    obj->back = 0;
+    obj->count = 0;
     obj->length = length;
     obj->arrayLength = arrayLength;
-    obj->d = (char **)malloc(length * arrayLength);
+    obj->d = (char *)malloc((long int)length * arrayLength);
 
     return obj;
 }
@@ -90,23 +113,17 @@ deque *buildDeque(int length, int arrayLength)
 void deleteDequeBack(deque *deque)
 {
     checkDequeIsValid(deque);
-    
+
     // Check if deque is empty
-    if (deque->front == -1)
+    if (deque->count == 0)
     {
         fprintf(stderr, "Deque empty\n");
+        exit(1);
     }
 
-    // Iterate through each segment of the deque
-    for (int i = 1; i < deque->front + 1; i++) // i refers to the segment in the deque
-    {
-        // Push all segments down one to fill the null segment 0.
-        free(deque->d[i - 1]);
-        deque->d[i - 1] = (char *)malloc(deque->arrayLength);
-        memcpy(deque->d[i - 1], deque->d[i], deque->arrayLength);
-    }
-    
-    deque->front--;
+    // Segment 1 becomes segment 0.
+    deque->back = deque->back + 1 == deque->length ? 0 : deque->back + 1;
+    deque->count--;
 }
 
 // Enqueue an array to the front. For pushing overflowing values out of queue, use pushDequeFront()
@@ -119,16 +136,15 @@ void insertDequeFront(deque *deque, char *array)
     checkDequeArguments(deque, array);
 
     // Check deque has space.
-    if (deque->front >= deque->length - 1)
+    if (deque->count == deque->length)
     {
         fprintf(stderr, "Deque full\n");
         exit(1);
     }
 
-    deque->front++;
     // Insert the value onto the front of the array.
-    deque->d[deque->front] = (char *)malloc(deque->arrayLength);
-    memcpy(deque->d[deque->front], array, deque->arrayLength);
+    memcpy(findDequeSegment(deque, deque->count), array, deque->arrayLength);
+    deque->count++;
 }
 
 // Enqueue an array to the back. For pushing overflowing values out of queue, use pushDequeBack()
@@ -141,23 +157,16 @@ void insertDequeBack(deque *deque, char *array)
     checkDequeArguments(deque, array);
 
     // Check deque has space.
-    if (deque->front >= deque->length - 1)
+    if (deque->count == deque->length)
     {
         fprintf(stderr, "Deque full\n");
         exit(1);
     }
 
-    // Push all existing segments forward one.
-    for(int i = deque->front; i > -1; i--)
-    {
-        deque->d[i + 1] = deque->d[i];
-    }
-
-    // Replace segment 0 with value.
-    deque->d[0] = array;
-
-    deque->front++;
-
+    // Move back one slot, which pushes all existing segments forward one, and replace segment 0 with value.
+    deque->back = deque->back == 0 ? deque->length - 1 : deque->back - 1;
+    memcpy(findDequeSegment(deque, 0), array, deque->arrayLength);
+    deque->count++;
 }
 
 // Delete the frontmost array from the queue.
@@ -169,14 +178,14 @@ void deleteDequeFront(deque *deque)
     checkDequeIsValid(deque);
 
     // Check deque has space.
-    if (deque->front == -1)
+    if (deque->count == 0)
     {
         fprintf(stderr, "Deque empty\n");
+        exit(1);
     }
 
     // Remove frontmost segment.
-    free(deque->d[deque->front]);
-    deque->front--;
+    deque->count--;
 }
 
 // Enqueue an array to the front. If the queue is full, push out the backmost element.
@@ -189,15 +198,11 @@ void pushDequeFront(deque *deque, char *array)
     checkDequeArguments(deque, array);
 
     // If the deque doesn't have enough space, remove back segment and insert, otherwise insert normally.
-    if (deque->front >= deque->length - 1)
+    if (deque->count == deque->length)
     {
         deleteDequeBack(deque);
-        insertDequeFront(deque, array);
-    }
-    else
-    {
-        insertDequeFront(deque, array);
     }
+    insertDequeFront(deque, array);
 }
 
 // Enqueue an array to the back. If the queue is full, push out the frontmost element.
@@ -210,15 +215,32 @@ void pushDequeBack(deque *deque, char *array)
     checkDequeArguments(deque, array);
 
     // If the deque doesn't have enough space, remove front segment and insert, otherwise insert normally.
-    if (deque->front >= deque->length - 1)
+    if (deque->count == deque->length)
     {
         deleteDequeFront(deque);
-        insertDequeBack(deque, array);
     }
-    else
+    insertDequeBack(deque, array);
+}
+
+// Copies a segment of the deque. Only available in scope of deque.c
+// deque: pointer to the deque to read from.
+// index: the number of the segment, from the back.
+// nullInjector: if set, automatically injects the null terminator character to the output.
+//
+// Returns: the copy, which must be freed.
+static char *copyDequeSegment(deque *deque, int index, int nullInjector)
+{
+    char *val = findDequeSegment(deque, index); // The value of the segment.
+
+    // Allocate memory for output, and copy the val to output, inserting the terminator at end if needed.
+    char *output = (char *)malloc(deque->arrayLength + (nullInjector ? 1 : 0));
+    memcpy(output, val, deque->arrayLength);
+    if (nullInjector)
     {
-        insertDequeBack(deque, array);
+        output[deque->arrayLength] = '\0';
     }
+
+    return output;
 }
 
 // Reads the backmost elemnt of the deque.
@@ -231,27 +253,12 @@ char *readDequeBack(deque *deque, int nullInjector)
     checkDequeIsValid(deque);
 
     // Check deque has entries.
-    if (deque->front == -1)
+    if (deque->count == 0)
     {
         return NULL;
     }
 
-    char *val = deque->d[0]; // The value of first segment.
-    char *output; // The output.
-    if (nullInjector)
-    {
-        // Allocate memory for output, and copy the val to output, inserting the terminator at end.
-        output = (char *)malloc(deque->arrayLength + 1);
-        memcpy(output, val, deque->arrayLength + 1);
-        output[deque->arrayLength] = '\0';
-    }
-    else
-    {
-        // Allocate memory for output, and copy the val to output
-        output = (char *)malloc(deque->arrayLength);
-        memcpy(output, val, deque->arrayLength);
-    }
-    return output;
+    return copyDequeSegment(deque, 0, nullInjector);
 }
 
 // Reads the frontmost element of the deque.
@@ -264,56 +271,59 @@ char *readDequeFront(deque *deque, int nullInjector)
     checkDequeIsValid(deque);
 
     // Check deque has entries.
-    if (deque->front == -1)
+    if (deque->count == 0)
     {
         return NULL;
     }
 
-    char *val = deque->d[deque->front]; // The value of last segment.
-    char *output; // The output.
-    if (nullInjector)
-    {
-        // Allocate memory for output, and copy the val to output, inserting the terminator at end.
-        output = (char *)malloc(deque->arrayLength + 1);
-        memcpy(output, val, deque->arrayLength + 1);
-        output[deque->arrayLength] = '\0';
-    }
-    else
-    {
-        // Allocate memory for output, and copy the val to output
-        output = (char *)malloc(deque->arrayLength);
-        memcpy(output, val, deque->arrayLength);
-    }
-    return output;
+    return copyDequeSegment(deque, deque->count - 1, nullInjector);
 }
 
-// Reads a byte from a specified location in the deque. 
+// Reads a byte from a specified location in the deque.
 // index: the value of the index at which the array of the value is stored.
 // elementIndex: the value of the index at which the specific character exists at.
 //
 // Returns: the value of the byte at the specified location.
 char readDequeByte(deque *deque, int index, int elementIndex)
 {
-    return deque->d[index][elementIndex];
+    return findDequeSegment(deque, index)[elementIndex];
 }
 
-// Replaces a byte at a specified location in the deque. 
+// Replaces a byte at a specified location in the deque.
 // index: the value of the index at which the array of the value is stored.
 // elementIndex: the value of the index at which the specific character exists at.
 // byte: the new value of the specified location.
+//
+// Returns: the new value of the specified location.
 char writeDequeByte(deque *deque, int index, int elementIndex, char byte)
 {
-    deque->d[index][elementIndex] = byte;
+    findDequeSegment(deque, index)[elementIndex] = byte;
+    return byte;
 }
 
-// Free all lines of the deque
-void freeDequeLines(deque *deque)
+// Change the number and length of the segments of a deque. The deque is emptied.
+// deque: pointer to the deque.
+// length: the new length of the deque.
+// arrayLength: the new length of each element of the deque.
+void resizeDeque(deque *deque, int length, int arrayLength)
 {
-    for (int i = 0; i < deque->front + 1; i++)
+    checkDequeIsValid(deque);
+
+    if ((long int)length * arrayLength > (long int)deque->length * deque->arrayLength)
     {
-        free(deque->d[i]);
+        deque->d = (char *)realloc(deque->d, (long int)length * arrayLength);
     }
-    deque->front = -1;
+    deque->length = length;
+    deque->arrayLength = arrayLength;
+    deque->back = 0;
+    deque->count = 0;
+}
+
+// Empty the deque. The memory of the segments is kept for reuse.
+void freeDequeLines(deque *deque)
+{
+    deque->back = 0;
+    deque->count = 0;
 }
 
 #endif
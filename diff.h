@@ -0,0 +1,383 @@
+//
+// hexeditor.c library file
+// diff.c
+//
+// Provides an index of the ranges in which the contents of a piece table differ from another file, compared byte for
+// byte at the same offsets.
+//
+// Demonstration:
+//
+//   Contents:  00 11 22 33 44 55 66 77 88
+//   Other:     00 11 AA BB 44 55 66 CC         (one byte shorter)
+//
+//   Ranges:    [0x2, 0x4) [0x7, 0x9)           Ordered and never touching. Bytes past the end of the shorter side
+//                                              always differ.
+//
+// The index is built up front, with chunks of DIFF_CHUNK bytes compared in parallel by the thread pool. Blocks are
+// compared 16 bytes at a time with SSE2, and a block of equal bytes costs one comparison and one mask check for each
+// 16 bytes. Finding the next or previous difference, or whether a byte differs, is a binary search of the ranges.
+//
+// An edit only changes the bytes it covers, so updateDiffIndex() compares just those bytes again and splices the
+// result into the ranges, rather than comparing the whole of both files again.
+//
+
+// Avoid redefinition errors during compilation
+#ifndef FILE_DIFF_SEEN
+#define FILE_DIFF_SEEN
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DIFF_X86
+#endif
+
+#include "filemap.h"
+#include "piecetable.h"
+#include "threadpool.h"
+
+#define DIFF_BLOCK 1048576 // Size of the blocks the contents are compared in.
+#define DIFF_CHUNK 16777216 // Size of the chunks the contents are split into for comparing in parallel.
+
+typedef struct
+{
+    unsigned long int start; // The first byte that differs.
+    unsigned long int end; // One past the last byte that differs.
+} diffRange;
+
+typedef struct
+{
+    diffRange *ranges; // The ranges that differ, in order.
+    unsigned long int count; // The number of ranges.
+    unsigned long int capacity; // Allocated number of ranges.
+} diffRanges;
+
+typedef struct
+{
+    diffRanges differences; // The ranges that differ, in order and never touching.
+    unsigned long int compared; // The number of bytes both sides have, which are compared byte for byte.
+    unsigned long int size; // The number of bytes the longer side has. Everything past compared differs.
+} diffIndex;
+
+typedef struct
+{
+    pieceTable *table; // The contents being compared.
+    fileMap *other; // The file they are compared with.
+    unsigned long int from; // The first byte compared.
+    unsigned long int to; // One past the last byte compared.
+    diffRanges *chunkRanges; // The ranges found by each chunk.
+} diffJob;
+
+// Adds a range to the end of a list, joining it to the last range if they touch. Only available in scope of diff.c
+// list: pointer to the list.
+// start: the first byte of the range.
+// end: one past the last byte of the range.
+static void addDiffRange(diffRanges *list, unsigned long int start, unsigned long int end)
+{
+    if (start >= end)
+    {
+        return;
+    }
+    if (list->count > 0 && list->ranges[list->count - 1].end >= start)
+    {
+        if (end > list->ranges[list->count - 1].end)
+        {
+            list->ranges[list->count - 1].end = end;
+        }
+        return;
+    }
+
+    if (list->count == list->capacity)
+    {
+        list->capacity = list->capacity ? list->capacity * 2 : 64;
+        list->ranges = (diffRange *)realloc(list->ranges, sizeof(diffRange) * list->capacity);
+    }
+    list->ranges[list->count].start = start;
+    list->ranges[list->count].end = end;
+    list->count++;
+}
+
+// Finds the ranges in which two blocks differ. Only available in scope of diff.c
+// a: the first block.
+// b: the second block.
+// length: the length of both blocks.
+// base: the offset of the blocks, which the ranges are given relative to.
+// list: pointer to the list the ranges are added to.
+static void compareDiffBlocks(unsigned char *a, unsigned char *b, unsigned long int length, unsigned long int base, diffRanges *list)
+{
+    unsigned long int position = 0; // The first byte being compared.
+
+#ifdef DIFF_X86
+    for (; position + 16 <= length; position += 16)
+    {
+        __m128i left = _mm_loadu_si128((__m128i *)(a + position));
+        __m128i right = _mm_loadu_si128((__m128i *)(b + position));
+        unsigned int differing = ~_mm_movemask_epi8(_mm_cmpeq_epi8(left, right)) & 0xffff; // The bytes that differ.
+
+        // Add each run of differing bytes, which joins runs that carry on from the last 16 bytes.
+        while (differing)
+        {
+            int first = __builtin_ctz(differing); // The first byte of the run.
+            int last = first; // One past the last byte of the run.
+            while (last < 16 && (differing >> last) & 1)
+            {
+                last++;
+            }
+            addDiffRange(list, base + position + first, base + position + last);
+            differing &= last < 16 ? ~0u << last : 0;
+        }
+    }
+#endif
+
+    for (; position < length; position++)
+    {
+        if (a[position] != b[position])
+        {
+            addDiffRange(list, base + position, base + position + 1);
+        }
+    }
+}
+
+// Compares a segment of the contents with the other file, block by block. Only available in scope of diff.c
+// table: the contents.
+// other: the other file.
+// from: the first byte compared.
+// to: one past the last byte compared.
+// list: pointer to the list the ranges are added to.
+static void compareDiffSegment(pieceTable *table, fileMap *other, unsigned long int from, unsigned long int to, diffRanges *list)
+{
+    unsigned long int blockLength = to - from < DIFF_BLOCK ? to - from : DIFF_BLOCK; // Longest block compared.
+    unsigned char *scratch = (unsigned char *)malloc(blockLength); // Blocks of the contents that span pieces.
+    unsigned char *otherScratch = other->mode == filePositioned ? (unsigned char *)malloc(blockLength) : NULL; // Blocks of the other file.
+
+    for (unsigned long int offset = from; offset < to; offset += DIFF_BLOCK)
+    {
+        unsigned long int length = to - offset < DIFF_BLOCK ? to - offset : DIFF_BLOCK; // Length of the block.
+        unsigned char *a = viewPieceTable(table, offset, length, scratch);
+
+        // The window of a positioned file is shared, so each block is read into a buffer of its own instead.
+        unsigned char *b = other->data + offset;
+        if (otherScratch)
+        {
+            readFileMap(other, offset, otherScratch, length);
+            b = otherScratch;
+        }
+
+        compareDiffBlocks(a, b, length, offset, list);
+    }
+
+    free(scratch);
+    free(otherScratch);
+}
+
+// Compares one chunk of a diff job. Run by the thread pool. Only available in scope of diff.c
+// argument: pointer to the diff job.
+// index: the number of the chunk.
+static void compareDiffChunk(void *argument, unsigned long int index)
+{
+    diffJob *job = (diffJob *)argument;
+    unsigned long int start = job->from + index * DIFF_CHUNK; // The first byte of the chunk.
+    unsigned long int end = job->to - start < DIFF_CHUNK ? job->to : start + DIFF_CHUNK; // One past the last byte.
+    compareDiffSegment(job->table, job->other, start, end, &job->chunkRanges[index]);
+}
+
+// Compares a piece table with another file and builds an index of the ranges that differ.
+// pool: the thread pool the chunks are compared by.
+// table: pointer to the piece table.
+// other: the file it is compared with.
+//
+// Returns: the generated index.
+diffIndex *buildDiffIndex(threadPool *pool, pieceTable *table, fileMap *other)
+{
+    // Allocate memory for index.
+    diffIndex *obj = (diffIndex *)calloc(1, sizeof(diffIndex));
+    obj->compared = table->size < other->size ? table->size : other->size;
+    obj->size = table->size > other->size ? table->size : other->size;
+
+    unsigned long int chunkCount = (obj->compared + DIFF_CHUNK - 1) / DIFF_CHUNK; // The number of chunks.
+    diffJob job = { table, other, 0, obj->compared, NULL };
+    job.chunkRanges = (diffRanges *)calloc(chunkCount, sizeof(diffRanges));
+    runThreadPool(pool, compareDiffChunk, &job, chunkCount);
+
+    // Chunks are in order, so joining their ranges keeps them in order. Ranges that meet at the edge of a chunk join.
+    for (unsigned long int i = 0; i < chunkCount; i++)
+    {
+        for (unsigned long int j = 0; j < job.chunkRanges[i].count; j++)
+        {
+            addDiffRange(&obj->differences, job.chunkRanges[i].ranges[j].start, job.chunkRanges[i].ranges[j].end);
+        }
+        free(job.chunkRanges[i].ranges);
+    }
+    free(job.chunkRanges);
+
+    // The bytes only one side has.
+    addDiffRange(&obj->differences, obj->compared, obj->size);
+
+    return obj;
+}
+
+// Finds the first range that ends at or after an offset. Only available in scope of diff.c
+// index: pointer to the index.
+// offset: the offset.
+//
+// Returns: the number of the range, or the number of ranges if there is none.
+static unsigned long int findDiffRange(diffIndex *index, unsigned long int offset)
+{
+    unsigned long int low = 0;
+    unsigned long int high = index->differences.count;
+    while (low < high)
+    {
+        unsigned long int middle = (low + high) / 2;
+        if (index->differences.ranges[middle].end < offset)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+// Compares a segment of the contents again after it has been edited, and updates the index to match.
+// index: pointer to the index.
+// table: pointer to the piece table, which must be the same size as when the index was built.
+// other: the file it is compared with.
+// offset: the first byte edited.
+// length: the number of bytes edited.
+void updateDiffIndex(diffIndex *index, pieceTable *table, fileMap *other, unsigned long int offset, unsigned long int length)
+{
+    // Bytes past the end of either side always differ.
+    unsigned long int end = offset + length < index->compared ? offset + length : index->compared; // One past the last byte edited.
+    if (offset >= end)
+    {
+        return;
+    }
+
+    // The ranges that touch the segment are replaced: by what is left of them outside the segment, and by the ranges
+    // found inside it.
+    unsigned long int low = findDiffRange(index, offset); // The first range replaced.
+    unsigned long int high = low; // One past the last range replaced.
+    while (high < index->differences.count && index->differences.ranges[high].start <= end)
+    {
+        high++;
+    }
+
+    diffRanges replacement = { NULL, 0, 0 }; // The ranges that take their place.
+    if (low < high && index->differences.ranges[low].start < offset)
+    {
+        addDiffRange(&replacement, index->differences.ranges[low].start, offset);
+    }
+    compareDiffSegment(table, other, offset, end, &replacement);
+    if (low < high && index->differences.ranges[high - 1].end > end)
+    {
+        addDiffRange(&replacement, end, index->differences.ranges[high - 1].end);
+    }
+
+    // Splice the replacement in.
+    diffRanges *list = &index->differences;
+    unsigned long int count = list->count - (high - low) + replacement.count; // The number of ranges afterwards.
+    if (count > list->capacity)
+    {
+        while (count > list->capacity)
+        {
+            list->capacity = list->capacity ? list->capacity * 2 : 64;
+        }
+        list->ranges = (diffRange *)realloc(list->ranges, sizeof(diffRange) * list->capacity);
+    }
+    memmove(&list->ranges[low + replacement.count], &list->ranges[high], sizeof(diffRange) * (list->count - high));
+    if (replacement.count > 0)
+    {
+        memcpy(&list->ranges[low], replacement.ranges, sizeof(diffRange) * replacement.count);
+    }
+    list->count = count;
+    free(replacement.ranges);
+}
+
+// Checks whether a byte differs from the other file.
+// index: pointer to the index.
+// offset: the offset of the byte.
+//
+// Returns: 1 if the byte differs, otherwise 0.
+int differsDiffIndex(diffIndex *index, unsigned long int offset)
+{
+    unsigned long int found = findDiffRange(index, offset + 1); // The first range that could hold the byte.
+    return found < index->differences.count && index->differences.ranges[found].start <= offset && offset < index->differences.ranges[found].end;
+}
+
+// Finds the range that differs nearest to an offset in one direction.
+// index: pointer to the index.
+// offset: the offset.
+// direction: 1 for the first range that starts after offset, -1 for the last range that starts before it.
+// result: set to the range.
+// number: set to the number of the range, starting from 1.
+//
+// Returns: 1 if there is such a range, otherwise 0.
+int stepDiffIndex(diffIndex *index, unsigned long int offset, int direction, diffRange *result, unsigned long int *number)
+{
+    // Binary search for the first range that starts after offset.
+    unsigned long int low = 0;
+    unsigned long int high = index->differences.count;
+    while (low < high)
+    {
+        unsigned long int middle = (low + high) / 2;
+        if (index->differences.ranges[middle].start <= offset)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    // Step back past offset itself for the last range that starts before it.
+    if (direction < 0)
+    {
+        if (low > 0 && index->differences.ranges[low - 1].start == offset)
+        {
+            low--;
+        }
+        low--;
+    }
+
+    if (low >= index->differences.count) // Going back from the first range wraps low past count.
+    {
+        return 0;
+    }
+    *result = index->differences.ranges[low];
+    *number = low + 1;
+    return 1;
+}
+
+// Counts the bytes that differ.
+// index: pointer to the index.
+//
+// Returns: the number of bytes that differ.
+unsigned long int countDiffIndex(diffIndex *index)
+{
+    unsigned long int bytes = 0; // Bytes counted so far.
+    for (unsigned long int i = 0; i < index->differences.count; i++)
+    {
+        bytes += index->differences.ranges[i].end - index->differences.ranges[i].start;
+    }
+    return bytes;
+}
+
+// Frees a diff index.
+// index: pointer to the index.
+void freeDiffIndex(diffIndex *index)
+{
+    if (index == NULL)
+    {
+        return;
+    }
+
+    free(index->differences.ranges);
+    free(index);
+}
+
+#endif
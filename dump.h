@@ -0,0 +1,283 @@
+//
+// hexeditor.c library file
+// dump.c
+//
+// Provides a plain text dump of a segment of a file, in the layout of the lines of the editor, for piping into other
+// tools.
+//
+// Demonstration:
+//
+//   0x00000000   2F 2F 20 0A 2F 2F 20 68 65 78 65 64 69 74 6F 72     // .// hexeditor
+//   0x00000010   2E 63 0A                                            .c.
+//
+// The file is read in blocks of DUMP_BLOCK bytes, and each block is formatted into one buffer that is written with a
+// single write(). The buffer is filled with the spacing of every line once, so formatting a line only writes its
+// offset, hex digits and characters into place. With SSSE3, the digits and characters of a whole line are worked out
+// with a few vector instructions: each byte is split into nibbles, which are looked up as digits with a shuffle, and
+// further shuffles spread the digits out with a space after every pair. Without it, lookup tables are used.
+//
+
+// Avoid redefinition errors during compilation
+#ifndef FILE_DUMP_SEEN
+#define FILE_DUMP_SEEN
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DUMP_X86
+#endif
+
+#include "filemap.h"
+
+#define DUMP_BYTES_PER_LINE 16 // Bytes shown on each line of the dump.
+#define DUMP_BLOCK 1048576 // Bytes of the file formatted for each write(). Must be a multiple of DUMP_BYTES_PER_LINE.
+
+typedef struct
+{
+    int digits; // Hexadecimal digits of the offset of each line, always even.
+    int hexStart; // Column the hex digits start at.
+    int asciiStart; // Column the characters start at.
+    int length; // Length of a line, including the newline.
+} dumpLayout;
+
+static char dumpHexTable[256][2]; // The two hexadecimal digits of each byte value.
+static char dumpAsciiTable[256]; // The character shown for each byte value.
+
+#ifdef DUMP_X86
+static unsigned char dumpShuffleFirst[3][16]; // Where each column of the hex digits comes from in the digits of bytes 0 to 7.
+static unsigned char dumpShuffleSecond[3][16]; // Where each column of the hex digits comes from in the digits of bytes 8 to 15.
+static unsigned char dumpSpaces[3][16]; // The spaces between the hex digits.
+#endif
+
+// Fills in the lookup tables, the first time it is called. Only available in scope of dump.c
+static void buildDumpTables()
+{
+    if (dumpAsciiTable[0] != 0)
+    {
+        return;
+    }
+
+    const char *digits = "0123456789ABCDEF"; // Hexadecimal digits.
+    for (int i = 0; i < 256; i++)
+    {
+        dumpHexTable[i][0] = digits[i >> 4];
+        dumpHexTable[i][1] = digits[i & 15];
+        dumpAsciiTable[i] = i >= 32 && i <= 126 ? i : '.';
+    }
+
+#ifdef DUMP_X86
+    // Column p of the hex digits is digit p % 3 of byte p / 3, where digit 2 is the space. The digits of each byte are
+    // found in pairs, bytes 0 to 7 in one vector and 8 to 15 in another. A shuffle index of 0x80 gives a zero.
+    for (int p = 0; p < 48; p++)
+    {
+        int byte = p / 3; // The byte shown in the column.
+        int digit = p % 3; // Which of its digits.
+        dumpShuffleFirst[p / 16][p % 16] = digit < 2 && byte < 8 ? byte * 2 + digit : 0x80;
+        dumpShuffleSecond[p / 16][p % 16] = digit < 2 && byte >= 8 ? (byte - 8) * 2 + digit : 0x80;
+        dumpSpaces[p / 16][p % 16] = digit == 2 ? ' ' : 0;
+    }
+#endif
+}
+
+// Works out the layout of the lines of a dump. Only available in scope of dump.c
+// layout: the layout that is filled in.
+// end: the offset the dump ends at, which decides how many digits offsets need.
+static void sizeDumpLayout(dumpLayout *layout, unsigned long int end)
+{
+    layout->digits = 8;
+    while (layout->digits < (int)sizeof(end) * 2 && end >> (layout->digits * 4))
+    {
+        layout->digits += 2;
+    }
+
+    layout->hexStart = 2 + layout->digits + 3;
+    layout->asciiStart = layout->hexStart + DUMP_BYTES_PER_LINE * 3 + 4;
+    layout->length = layout->asciiStart + DUMP_BYTES_PER_LINE + 1;
+}
+
+// Fills a line with its spacing and newline. Only available in scope of dump.c
+// out: the start of the line.
+// layout: the layout of the line.
+static void blankDumpLine(char *out, dumpLayout *layout)
+{
+    memset(out, ' ', layout->length - 1);
+    out[0] = '0';
+    out[1] = 'x';
+    out[layout->length - 1] = '\n';
+}
+
+// Writes the offset of a line into place. Only available in scope of dump.c
+// out: the start of the line.
+// layout: the layout of the line.
+// offset: the offset of the first byte on the line.
+static void formatDumpOffset(char *out, dumpLayout *layout, unsigned long int offset)
+{
+    for (int i = 0; i < layout->digits; i += 2)
+    {
+        memcpy(out + 2 + i, dumpHexTable[(offset >> ((layout->digits - 2 - i) * 4)) & 0xFF], 2);
+    }
+}
+
+// Formats a line with lookup tables. Only available in scope of dump.c
+// out: the start of the line, which has been filled with its spacing.
+// layout: the layout of the line.
+// bytes: the bytes on the line.
+// count: the number of bytes on the line, which may be less than a full line.
+static void formatDumpLine(char *out, dumpLayout *layout, unsigned char *bytes, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        memcpy(out + layout->hexStart + i * 3, dumpHexTable[bytes[i]], 2);
+        out[layout->asciiStart + i] = dumpAsciiTable[bytes[i]];
+    }
+}
+
+#ifdef DUMP_X86
+// Formats full lines with SSSE3 instructions. Only available in scope of dump.c
+// out: the start of the first line, which has been filled with the spacing of every line.
+// layout: the layout of the lines.
+// bytes: the bytes on the lines.
+// lines: the number of lines.
+__attribute__((target("ssse3")))
+static void formatDumpLinesSsse3(char *out, dumpLayout *layout, unsigned char *bytes, unsigned long int lines)
+{
+    const __m128i digits = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F');
+    const __m128i nibble = _mm_set1_epi8(15);
+    __m128i shuffleFirst[3], shuffleSecond[3], spaces[3];
+    for (int i = 0; i < 3; i++)
+    {
+        shuffleFirst[i] = _mm_loadu_si128((__m128i *)dumpShuffleFirst[i]);
+        shuffleSecond[i] = _mm_loadu_si128((__m128i *)dumpShuffleSecond[i]);
+        spaces[i] = _mm_loadu_si128((__m128i *)dumpSpaces[i]);
+    }
+
+    for (unsigned long int line = 0; line < lines; line++, out += layout->length, bytes += DUMP_BYTES_PER_LINE)
+    {
+        __m128i data = _mm_loadu_si128((__m128i *)bytes);
+
+        // Look up the digit of each nibble, and pair the digits of each byte.
+        __m128i high = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(data, 4), nibble));
+        __m128i low = _mm_shuffle_epi8(digits, _mm_and_si128(data, nibble));
+        __m128i first = _mm_unpacklo_epi8(high, low); // The digits of bytes 0 to 7.
+        __m128i second = _mm_unpackhi_epi8(high, low); // The digits of bytes 8 to 15.
+
+        // Spread the pairs out, with a space after each.
+        for (int i = 0; i < 3; i++)
+        {
+            __m128i column = _mm_or_si128(_mm_shuffle_epi8(first, shuffleFirst[i]), _mm_shuffle_epi8(second, shuffleSecond[i]));
+            _mm_storeu_si128((__m128i *)(out + layout->hexStart + i * 16), _mm_or_si128(column, spaces[i]));
+        }
+
+        // Bytes from 32 to 126 are shown as they are, and any others as a dot. Bytes past 127 compare as negative.
+        __m128i printable = _mm_and_si128(_mm_cmpgt_epi8(data, _mm_set1_epi8(31)), _mm_cmplt_epi8(data, _mm_set1_epi8(127)));
+        __m128i ascii = _mm_or_si128(_mm_and_si128(printable, data), _mm_andnot_si128(printable, _mm_set1_epi8('.')));
+        _mm_storeu_si128((__m128i *)(out + layout->asciiStart), ascii);
+    }
+}
+#endif
+
+// Writes a dump of a segment of a file.
+// map: pointer to the map of the file.
+// start: the offset of the first byte dumped.
+// length: the number of bytes dumped. It is cut short at the end of the file.
+// fd: the file descriptor the dump is written to.
+//
+// Returns: the number of bytes of the dump written, or -1 if it could not be written.
+long int dumpFileMap(fileMap *map, unsigned long int start, unsigned long int length, int fd)
+{
+    if (start > map->size)
+    {
+        start = map->size;
+    }
+    if (length > map->size - start)
+    {
+        length = map->size - start;
+    }
+
+    buildDumpTables();
+
+#ifdef DUMP_X86
+    static int ssse3 = -1; // Whether the processor supports SSSE3, checked on first use.
+    if (ssse3 == -1)
+    {
+        __builtin_cpu_init();
+        ssse3 = __builtin_cpu_supports("ssse3") ? 1 : 0;
+    }
+#endif
+
+    dumpLayout layout;
+    sizeDumpLayout(&layout, start + length);
+
+    // The spacing of the lines never changes, so it is only filled in once.
+    unsigned long int blockLines = DUMP_BLOCK / DUMP_BYTES_PER_LINE; // Lines formatted for each write().
+    char *output = (char *)malloc(blockLines * layout.length); // The formatted lines of a block.
+    for (unsigned long int line = 0; line < blockLines; line++)
+    {
+        blankDumpLine(output + line * layout.length, &layout);
+    }
+
+    long int written = 0; // Bytes of the dump written so far.
+    for (unsigned long int done = 0; done < length; )
+    {
+        unsigned long int count = length - done < DUMP_BLOCK ? length - done : DUMP_BLOCK; // Bytes in the block.
+        unsigned char *bytes = viewFileMap(map, start + done, count);
+        unsigned long int fullLines = count / DUMP_BYTES_PER_LINE; // Lines with every byte present.
+        unsigned long int lines = (count + DUMP_BYTES_PER_LINE - 1) / DUMP_BYTES_PER_LINE; // Lines in the block.
+
+        for (unsigned long int line = 0; line < lines; line++)
+        {
+            formatDumpOffset(output + line * layout.length, &layout, start + done + line * DUMP_BYTES_PER_LINE);
+        }
+
+#ifdef DUMP_X86
+        if (ssse3)
+        {
+            formatDumpLinesSsse3(output, &layout, bytes, fullLines);
+        }
+        else
+#endif
+        {
+            for (unsigned long int line = 0; line < fullLines; line++)
+            {
+                formatDumpLine(output + line * layout.length, &layout, bytes + line * DUMP_BYTES_PER_LINE, DUMP_BYTES_PER_LINE);
+            }
+        }
+
+        // The last line of the dump may be short. Its spacing is filled in again, as it is only partly overwritten.
+        if (lines > fullLines)
+        {
+            char *out = output + fullLines * layout.length; // The start of the short line.
+            blankDumpLine(out, &layout);
+            formatDumpOffset(out, &layout, start + done + fullLines * DUMP_BYTES_PER_LINE);
+            formatDumpLine(out, &layout, bytes + fullLines * DUMP_BYTES_PER_LINE, count % DUMP_BYTES_PER_LINE);
+
+            // The characters follow the last byte rather than trailing spaces.
+            out[layout.asciiStart + count % DUMP_BYTES_PER_LINE] = '\n';
+        }
+
+        // Write the block, where a short last line ends after its characters.
+        unsigned long int total = lines > fullLines ? fullLines * layout.length + layout.asciiStart + count % DUMP_BYTES_PER_LINE + 1 : lines * layout.length;
+        for (unsigned long int sent = 0; sent < total; )
+        {
+            ssize_t part = write(fd, output + sent, total - sent);
+            if (part <= 0)
+            {
+                free(output);
+                return -1;
+            }
+            sent += part;
+        }
+
+        written += total;
+        done += count;
+    }
+
+    free(output);
+    return written;
+}
+
+#endif
@@ -0,0 +1,248 @@
+//
+// hexeditor.c library file
+// filemap.c
+//
+// Provides the read backend for the file being editted.
+//
+// Regular files are mapped into memory with mmap() so that reading a line or scanning a block is a pointer into the
+// mapping and costs only a page fault. Files that cannot be mapped (block devices, some special files) fall back to
+// pread() through a reusable window, and streams that cannot be seeked at all (pipes) are read into memory once, up to
+// FILEMAP_STREAM_LIMIT bytes. Character devices that can be seeked are read with pread() at the size they report, as
+// some of them (/dev/zero, /dev/urandom) never end.
+//
+
+// Avoid redefinition errors during compilation
+#ifndef FILE_FILEMAP_SEEN
+#define FILE_FILEMAP_SEEN
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define FILEMAP_WINDOW 65536 // Initial size of the window used to view files that could not be mapped.
+#define FILEMAP_STREAM_LIMIT 1073741824 // Most bytes of a stream that are read into memory.
+
+enum FileMapMode
+{
+    fileMapped, // The file is mapped into memory.
+    filePositioned, // The file is read with pread() into a window.
+    fileBuffered // The file was a stream and has been read into memory.
+};
+
+typedef struct
+{
+    int fd; // File descriptor of the open file.
+    int writable; // Whether the file was opened for writing.
+    enum FileMapMode mode; // How the file is being read.
+    unsigned long int size; // The size of the file in bytes.
+    unsigned char *data; // The mapping (fileMapped) or the contents (fileBuffered) of the file.
+    unsigned char *window; // Window the file is read into (filePositioned).
+    unsigned long int windowCapacity; // Allocated size of the window.
+} fileMap;
+
+// Reads a stream that cannot be seeked into memory. Only available in scope of filemap.c
+// map: pointer to the map being opened.
+//
+// Throws if memory could not be allocated, or the stream is longer than FILEMAP_STREAM_LIMIT bytes.
+static void bufferFileMap(fileMap *map)
+{
+    unsigned long int capacity = FILEMAP_WINDOW; // Allocated size of the buffer.
+    map->data = (unsigned char *)malloc(capacity);
+    map->size = 0;
+
+    while (1)
+    {
+        if (map->data == NULL)
+        {
+            fprintf(stderr, "Could not allocate memory for file.\n");
+            exit(1);
+        }
+
+        ssize_t count = read(map->fd, map->data + map->size, capacity - map->size); // Bytes read this pass.
+        if (count <= 0)
+        {
+            break;
+        }
+
+        map->size += count;
+        if (map->size > FILEMAP_STREAM_LIMIT)
+        {
+            fprintf(stderr, "Stream is longer than %d bytes, which is the most that can be read into memory.\n", FILEMAP_STREAM_LIMIT);
+            exit(1);
+        }
+        if (map->size == capacity)
+        {
+            capacity *= 2;
+            map->data = (unsigned char *)realloc(map->data, capacity);
+        }
+    }
+
+    map->mode = fileBuffered;
+}
+
+// Opens a file and chooses how it will be read.
+// fileName: the location of the file.
+//
+// Returns: the opened map, or NULL if the file could not be opened.
+fileMap *openFileMap(char *fileName)
+{
+    fileMap *map = (fileMap *)calloc(1, sizeof(fileMap));
+
+    // Prefer opening for writing, but still allow read only files to be viewed. Pipes are only opened for reading, as
+    // holding their write end open would mean their end is never read.
+    struct stat info;
+    int stream = stat(fileName, &info) == 0 && (S_ISFIFO(info.st_mode) || S_ISSOCK(info.st_mode)); // Whether the file is a pipe.
+    map->writable = !stream;
+    map->fd = stream ? -1 : open(fileName, O_RDWR);
+    if (map->fd == -1)
+    {
+        map->writable = 0;
+        map->fd = open(fileName, O_RDONLY);
+    }
+    if (map->fd == -1)
+    {
+        free(map);
+        return NULL;
+    }
+
+    // Find the size of the file. Block devices report 0 through stat(), so the end is found with lseek().
+    fstat(map->fd, &info);
+    off_t end = lseek(map->fd, 0, SEEK_END); // The offset of the end of the file.
+
+    if (end == -1 || S_ISFIFO(info.st_mode) || S_ISSOCK(info.st_mode))
+    {
+        // The file cannot be seeked, so its contents have to be read once.
+        map->writable = 0;
+        bufferFileMap(map);
+        return map;
+    }
+
+    map->size = end;
+    map->mode = fileMapped;
+
+    // Character devices may have no end, so they are only read as far as the size they report, and never mapped.
+    if (S_ISCHR(info.st_mode))
+    {
+        map->mode = filePositioned;
+        map->windowCapacity = FILEMAP_WINDOW;
+        map->window = (unsigned char *)malloc(map->windowCapacity);
+        return map;
+    }
+
+    // Empty files cannot be mapped, but there is nothing to read from them anyway.
+    if (map->size == 0)
+    {
+        return map;
+    }
+
+    void *data = mmap(NULL, map->size, PROT_READ, MAP_SHARED, map->fd, 0);
+    if (data == MAP_FAILED)
+    {
+        // Fall back to reading with pread() through a window.
+        map->mode = filePositioned;
+        map->windowCapacity = FILEMAP_WINDOW;
+        map->window = (unsigned char *)malloc(map->windowCapacity);
+        return map;
+    }
+
+    map->data = (unsigned char *)data;
+    return map;
+}
+
+// Copies a segment of the file into a buffer. Any part of the segment past the end of the file is filled with zeroes.
+// map: pointer to the map to read from.
+// offset: the start position of reading from the file.
+// buffer: the buffer being written to.
+// length: the number of bytes to read.
+//
+// Returns: the number of bytes that were read from the file.
+unsigned long int readFileMap(fileMap *map, unsigned long int offset, void *buffer, unsigned long int length)
+{
+    unsigned long int available = offset < map->size ? map->size - offset : 0; // Bytes that exist past offset.
+    unsigned long int count = length < available ? length : available; // Bytes that will be read.
+
+    if (count > 0)
+    {
+        if (map->mode == filePositioned)
+        {
+            unsigned long int done = 0; // Bytes read so far.
+            while (done < count)
+            {
+                ssize_t part = pread(map->fd, (char *)buffer + done, count - done, offset + done);
+                if (part <= 0)
+                {
+                    break;
+                }
+                done += part;
+            }
+            count = done;
+        }
+        else
+        {
+            memcpy(buffer, map->data + offset, count);
+        }
+    }
+
+    memset((char *)buffer + count, 0, length - count);
+    return count;
+}
+
+// Views a segment of the file without copying it when possible.
+// map: pointer to the map to view.
+// offset: the start position of the segment.
+// length: the length of the segment. Must not pass the end of the file.
+//
+// Returns: a pointer to the segment, which is valid until the next view of a map that is not fileMapped or
+// fileBuffered, or NULL if the segment passes the end of the file.
+unsigned char *viewFileMap(fileMap *map, unsigned long int offset, unsigned long int length)
+{
+    if (offset > map->size || length > map->size - offset)
+    {
+        return NULL;
+    }
+
+    if (map->mode != filePositioned)
+    {
+        return map->data + offset;
+    }
+
+    // Grow the window if the segment does not fit.
+    if (length > map->windowCapacity)
+    {
+        free(map->window);
+        map->windowCapacity = length;
+        map->window = (unsigned char *)malloc(map->windowCapacity);
+    }
+
+    readFileMap(map, offset, map->window, length);
+    return map->window;
+}
+
+// Closes a map and frees its memory.
+// map: pointer to the map to close.
+void closeFileMap(fileMap *map)
+{
+    if (map == NULL)
+    {
+        return;
+    }
+
+    if (map->mode == fileMapped && map->data != NULL)
+    {
+        munmap(map->data, map->size);
+    }
+    else if (map->mode == fileBuffered)
+    {
+        free(map->data);
+    }
+
+    free(map->window);
+    close(map->fd);
+    free(map);
+}
+
+#endif
@@ -0,0 +1,261 @@
+//
+// hexeditor.c library file
+// frame.c
+//
+// Provides a buffer that a whole frame of output is built in before it is written to the terminal.
+//
+// Demonstration:
+//
+//   resetFrame(frame)                     data: ""
+//   moveFrameCursor(frame, 3, 10)         data: "\033[10;3H"
+//   appendFrameHex(frame, 0xAB)           data: "\033[10;3HAB"
+//   flushFrame(frame)                     one write() of 10 bytes, data: ""
+//
+// Drawing straight to stdout costs a printf() call per byte plus its escape codes, and the terminal may show a frame
+// that has only been partly drawn. Building the frame first means the terminal receives it in a single write().
+// Bytes are formatted through lookup tables instead of printf("%02X").
+//
+
+// Avoid redefinition errors during compilation
+#ifndef FILE_FRAME_SEEN
+#define FILE_FRAME_SEEN
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "consoleutils.h"
+#include "textutils.h"
+
+#define FRAME_INITIAL_CAPACITY 16384 // Initial size of the frame buffer, which grows if a frame needs more.
+
+typedef struct
+{
+    char *data; // The output of the frame so far.
+    unsigned long int length; // The number of bytes of output.
+    unsigned long int capacity; // Allocated size of data.
+} frameBuffer;
+
+static char frameHexTable[256][2]; // The two hexadecimal digits of each byte value.
+static char frameAsciiTable[256]; // The character shown for each byte value in the ASCII column.
+
+// Generate a frame buffer.
+//
+// Returns: the generated frame buffer.
+frameBuffer *buildFrame()
+{
+    // Fill in the lookup tables.
+    const char *digits = "0123456789ABCDEF"; // Hexadecimal digits.
+    for (int i = 0; i < 256; i++)
+    {
+        frameHexTable[i][0] = digits[i >> 4];
+        frameHexTable[i][1] = digits[i & 15];
+        frameAsciiTable[i] = i >= 32 && i <= 126 ? i : '.';
+    }
+
+    // Allocate memory for frame buffer.
+    frameBuffer *obj = (frameBuffer *)malloc(sizeof(frameBuffer));
+    obj->data = (char *)malloc(FRAME_INITIAL_CAPACITY);
+    obj->length = 0;
+    obj->capacity = FRAME_INITIAL_CAPACITY;
+
+    return obj;
+}
+
+// Makes space for more output. Only available in scope of frame.c
+// frame: pointer to the frame buffer.
+// length: the number of bytes about to be added.
+//
+// Returns: where the bytes should be written to.
+static char *reserveFrame(frameBuffer *frame, unsigned long int length)
+{
+    if (frame->length + length > frame->capacity)
+    {
+        while (frame->length + length > frame->capacity)
+        {
+            frame->capacity *= 2;
+        }
+        frame->data = (char *)realloc(frame->data, frame->capacity);
+    }
+
+    char *end = frame->data + frame->length; // The first free byte.
+    frame->length += length;
+    return end;
+}
+
+// Empties the frame buffer. The memory is kept for the next frame.
+// frame: pointer to the frame buffer.
+void resetFrame(frameBuffer *frame)
+{
+    frame->length = 0;
+}
+
+// Adds bytes to the frame.
+// frame: pointer to the frame buffer.
+// bytes: the bytes to add.
+// length: the number of bytes.
+void appendFrame(frameBuffer *frame, const char *bytes, unsigned long int length)
+{
+    memcpy(reserveFrame(frame, length), bytes, length);
+}
+
+// Adds a string to the frame.
+// frame: pointer to the frame buffer.
+// text: the string to add.
+void appendFrameText(frameBuffer *frame, const char *text)
+{
+    appendFrame(frame, text, strlen(text));
+}
+
+// Adds a number in decimal to the frame. Only available in scope of frame.c
+// frame: pointer to the frame buffer.
+// number: the number, which must not be negative.
+static void appendFrameNumber(frameBuffer *frame, int number)
+{
+    char digits[12]; // The digits, written from the end.
+    int start = sizeof(digits);
+    do
+    {
+        digits[--start] = '0' + number % 10;
+        number /= 10;
+    } while (number > 0);
+
+    appendFrame(frame, digits + start, sizeof(digits) - start);
+}
+
+// Adds the escape code that moves the cursor to the frame.
+// frame: pointer to the frame buffer.
+// x: the x location of the cursor.
+// y: the y location of the cursor.
+void moveFrameCursor(frameBuffer *frame, int x, int y)
+{
+    appendFrame(frame, "\033[", 2);
+    appendFrameNumber(frame, y < 0 ? 0 : y);
+    appendFrame(frame, ";", 1);
+    appendFrameNumber(frame, x < 0 ? 0 : x);
+    appendFrame(frame, "H", 1);
+}
+
+// Adds a byte as two hexadecimal digits to the frame.
+// frame: pointer to the frame buffer.
+// byte: the byte.
+void appendFrameHex(frameBuffer *frame, unsigned char byte)
+{
+    appendFrame(frame, frameHexTable[byte], 2);
+}
+
+// Adds a byte as it is shown in the ASCII column to the frame, with a dot for bytes that cannot be displayed.
+// frame: pointer to the frame buffer.
+// byte: the byte.
+void appendFrameAscii(frameBuffer *frame, unsigned char byte)
+{
+    appendFrame(frame, &frameAsciiTable[byte], 1);
+}
+
+// Adds an offset as 0x followed by 8 hexadecimal digits to the frame.
+// frame: pointer to the frame buffer.
+// offset: the offset. Digits past the eighth are shown as well.
+void appendFrameOffset(frameBuffer *frame, unsigned long int offset)
+{
+    int digits = 8; // The number of digits of the offset that are shown.
+    while (digits < (int)sizeof(offset) * 2 && offset >> (digits * 4))
+    {
+        digits++;
+    }
+
+    char *end = reserveFrame(frame, digits + 2); // Where the offset is written.
+    end[0] = '0';
+    end[1] = 'x';
+    for (int i = 0; i < digits; i++)
+    {
+        end[2 + i] = frameHexTable[(offset >> ((digits - 1 - i) * 4)) & 15][1];
+    }
+}
+
+// Adds a line filled with one character to the frame.
+// frame: pointer to the frame buffer.
+// colour: the ANSI code for any specified colours
+// y: the y location of the line
+// character: the character that the line will be filled with
+void fillFrameLine(frameBuffer *frame, char *colour, int y, char character)
+{
+    appendFrameText(frame, colour);
+    moveFrameCursor(frame, 0, y);
+    memset(reserveFrame(frame, w.ws_col), character, w.ws_col);
+    appendFrameText(frame, SGR_RESET);
+}
+
+// Adds text centred on the screen to the frame.
+// frame: pointer to the frame buffer.
+// colour: the ANSI code for any specified colours
+// y: the y location of the line
+// text: the text that will be centred.
+void centreFrameText(frameBuffer *frame, char *colour, int y, char *text)
+{
+    appendFrameText(frame, colour);
+    moveFrameCursor(frame, (w.ws_col / 2) - (strlen(text) / 2), y);
+    appendFrameText(frame, text);
+    appendFrameText(frame, SGR_RESET);
+}
+
+// Adds two strings evenly distributed onto a line to the frame, as distributeLines() in textutils.h does.
+// frame: pointer to the frame buffer.
+// strA: string A
+// strB: string B
+// startPos: x starting position
+// y: the y location of the line
+// widthSegments: the number of segments in the line, with two strings occupying a segment.
+// segment: the number segment this set occupies.
+void distributeFrameLines(frameBuffer *frame, char *strA, char *strB, int startPos, int y, int widthSegments, int segment)
+{
+    int width = (w.ws_col / widthSegments); // Width of the segment
+
+    int pos1 = startPos + ((width * 0.25) - (strlen(strA) / 2)); // Position of string A
+    int pos2 = startPos + ((width * 0.75) - (strlen(strB) / 2)); // Position of string B
+
+    moveFrameCursor(frame, pos1 + (segment * width), y);
+    appendFrameText(frame, strA);
+    moveFrameCursor(frame, pos2 + (segment * width), y);
+    appendFrameText(frame, strB);
+}
+
+// Writes the frame to the terminal with a single write() and empties it.
+// frame: pointer to the frame buffer.
+//
+// Returns: 0 on success, -1 if the terminal could not be written to.
+int flushFrame(frameBuffer *frame)
+{
+    // Anything still buffered by stdio was drawn before this frame.
+    fflush(stdout);
+
+    unsigned long int done = 0; // Bytes written so far.
+    while (done < frame->length)
+    {
+        ssize_t count = write(STDOUT_FILENO, frame->data + done, frame->length - done);
+        if (count <= 0)
+        {
+            frame->length = 0;
+            return -1;
+        }
+        done += count;
+    }
+
+    frame->length = 0;
+    return 0;
+}
+
+// Frees a frame buffer.
+// frame: pointer to the frame buffer.
+void freeFrame(frameBuffer *frame)
+{
+    if (frame == NULL)
+    {
+        return;
+    }
+
+    free(frame->data);
+    free(frame);
+}
+
+#endif
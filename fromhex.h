@@ -0,0 +1,291 @@
+//
+// hexeditor.c library file
+// fromhex.c
+//
+// Provides logic for turning a hex listing back into the bytes it shows, such as a dump written with --dump that has
+// been edited.
+//
+// Each line is read as:
+//
+//   0x00000010   2E 63 0A 41                         .c.A
+//   ^ offset     ^ hex digits                        ^ gutter
+//
+//   Offset:    Optional. Either starts with 0x or ends with a colon, so 00000010: from xxd is read as well.
+//   Digits:    Pairs of hex digits, separated by single spaces or not at all (2E63 0A41).
+//   Gutter:    Anything after a run of two or more spaces or a tab is ignored, which covers the characters column.
+//
+// Blank lines and lines starting with # are skipped. Offsets are counted from the first one in the listing, so a dump of
+// a segment turns back into just that segment. A line whose offset is past the bytes so far is preceded by zeros, and a
+// line whose offset is before them is an error, as the output is only ever appended to.
+//
+// The listing is read in blocks and the bytes are written in blocks, so memory use does not depend on its size. Pairs
+// of digits are decoded with one lookup in a table of every pair of characters rather than a digit at a time.
+//
+
+// Avoid redefinition errors during compilation
+#ifndef FILE_FROMHEX_SEEN
+#define FILE_FROMHEX_SEEN
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "textutils.h"
+
+#define FROMHEX_BLOCK 1048576 // Bytes of the listing read at a time, which is also the longest line accepted.
+#define FROMHEX_OUTPUT 1048576 // Bytes of output collected before they are written.
+#define FROMHEX_INVALID 256 // Value in the pair table of a pair that is not two hex digits.
+
+typedef struct
+{
+    int out; // The file descriptor the bytes are written to.
+    unsigned char *output; // Bytes that have not been written yet.
+    unsigned long int outputLength; // The number of bytes that have not been written yet.
+    unsigned long int position; // The number of bytes produced so far.
+    unsigned long int base; // The first offset in the listing.
+    int hasBase; // Whether an offset has been seen.
+    int failed; // Set if the output could not be written to.
+} hexImport;
+
+static uint16_t fromHexPairTable[65536]; // The byte of each pair of characters, first character in the low bits.
+
+// Fills in the pair table, the first time it is called. Only available in scope of fromhex.c
+static void buildFromHexTable()
+{
+    if (fromHexPairTable[0] == FROMHEX_INVALID)
+    {
+        return;
+    }
+
+    for (int pair = 0; pair < 65536; pair++)
+    {
+        int high = convertHexChar(pair & 0xFF); // Value of the first character.
+        int low = convertHexChar(pair >> 8); // Value of the second character.
+        fromHexPairTable[pair] = high == -1 || low == -1 ? FROMHEX_INVALID : high * 16 + low;
+    }
+}
+
+// Writes the collected bytes. Only available in scope of fromhex.c
+// import: pointer to the import.
+static void flushHexImport(hexImport *import)
+{
+    unsigned long int done = 0; // Bytes written so far.
+    while (done < import->outputLength && !import->failed)
+    {
+        ssize_t count = write(import->out, import->output + done, import->outputLength - done);
+        if (count <= 0)
+        {
+            import->failed = 1;
+        }
+        else
+        {
+            done += count;
+        }
+    }
+    import->outputLength = 0;
+}
+
+// Adds zeros to the output, to fill a gap between offsets. Only available in scope of fromhex.c
+// import: pointer to the import.
+// count: the number of zeros.
+static void fillHexImport(hexImport *import, unsigned long int count)
+{
+    while (count > 0)
+    {
+        unsigned long int part = FROMHEX_OUTPUT - import->outputLength; // Zeros that fit in the output.
+        part = part < count ? part : count;
+        memset(import->output + import->outputLength, 0, part);
+        import->outputLength += part;
+        import->position += part;
+        count -= part;
+        if (import->outputLength == FROMHEX_OUTPUT)
+        {
+            flushHexImport(import);
+        }
+    }
+}
+
+// Decodes one line of a listing into the output. Only available in scope of fromhex.c
+// import: pointer to the import.
+// line: the line, which need not be terminated.
+// end: the end of the line, not including the newline.
+//
+// Returns: 0 on success, -1 if the line is not valid.
+static int parseHexLine(hexImport *import, char *line, char *end)
+{
+    // Skip leading whitespace, and ignore blank lines and comments.
+    while (line < end && (*line == ' ' || *line == '\t' || *line == '\r'))
+    {
+        line++;
+    }
+    if (line == end || *line == '#')
+    {
+        return 0;
+    }
+
+    // An offset starts with 0x or ends with a colon. Anything else is the first of the digits.
+    char *digits = line + (end - line > 2 && line[0] == '0' && (line[1] == 'x' || line[1] == 'X') ? 2 : 0); // First digit of the offset.
+    char *after = digits; // The character after the offset.
+    while (after < end && convertHexChar(*after) != -1)
+    {
+        after++;
+    }
+    if (digits > line || (after < end && *after == ':'))
+    {
+        if (after == digits || after - digits > 16)
+        {
+            return -1;
+        }
+
+        unsigned long int offset = 0; // The offset of the line.
+        for (char *p = digits; p < after; p++)
+        {
+            offset = offset * 16 + convertHexChar(*p);
+        }
+        if (!import->hasBase)
+        {
+            import->base = offset;
+            import->hasBase = 1;
+        }
+
+        // Offsets are counted from the first one. A gap is filled with zeros; going back is not possible.
+        if (offset < import->base || offset - import->base < import->position)
+        {
+            return -1;
+        }
+        fillHexImport(import, offset - import->base - import->position);
+
+        line = after + (after < end && *after == ':');
+        while (line < end && (*line == ' ' || *line == '\t'))
+        {
+            line++;
+        }
+    }
+
+    // Decode pairs of digits until the gutter or the end of the line.
+    unsigned char *output = import->output + import->outputLength; // Where the next byte goes.
+    while (line < end)
+    {
+        if (*line == ' ')
+        {
+            // A single space separates digits; more start the gutter.
+            if (line + 1 < end && (line[1] == ' ' || line[1] == '\t'))
+            {
+                break;
+            }
+            line++;
+            continue;
+        }
+        if (*line == '\t' || *line == '\r')
+        {
+            break;
+        }
+        if (line + 1 == end)
+        {
+            return -1;
+        }
+
+        unsigned int value = fromHexPairTable[(unsigned char)line[0] | (unsigned char)line[1] << 8];
+        if (value == FROMHEX_INVALID)
+        {
+            return -1;
+        }
+        *output++ = value;
+        line += 2;
+
+        // A line may hold more bytes than are left in the output.
+        if (output == import->output + FROMHEX_OUTPUT)
+        {
+            import->position += output - (import->output + import->outputLength);
+            import->outputLength = FROMHEX_OUTPUT;
+            flushHexImport(import);
+            output = import->output;
+        }
+    }
+    import->position += output - (import->output + import->outputLength);
+    import->outputLength = output - import->output;
+
+    return 0;
+}
+
+// Reads a hex listing and writes the bytes it shows.
+// in: the file descriptor the listing is read from.
+// out: the file descriptor the bytes are written to.
+// errorLine: set to the number of the first line that is not valid, or 0 if a file could not be read or written.
+//
+// Returns: the number of bytes written, or -1 on error. Bytes before the error have been written.
+long int importHexListing(int in, int out, unsigned long int *errorLine)
+{
+    buildFromHexTable();
+    *errorLine = 0;
+
+    hexImport import;
+    memset(&import, 0, sizeof(import));
+    import.out = out;
+    import.output = (unsigned char *)malloc(FROMHEX_OUTPUT);
+
+    char *text = (char *)malloc(FROMHEX_BLOCK * 2); // Lines read but not yet decoded.
+    unsigned long int filled = 0; // Bytes of text.
+    unsigned long int lineNumber = 1; // The number of the first line in text.
+    int finished = 0; // Set once the whole listing has been read.
+    int result = 0;
+
+    while (!finished && result == 0)
+    {
+        // Read another block after the part of a line left over from the last one.
+        ssize_t count = read(in, text + filled, FROMHEX_BLOCK);
+        if (count < 0)
+        {
+            result = -1;
+            break;
+        }
+        finished = count == 0;
+        filled += count;
+
+        // Decode every complete line, and the last line once there is nothing more to read.
+        char *line = text; // The line being decoded.
+        char *end = text + filled; // The end of the text.
+        while (line < end)
+        {
+            char *newline = (char *)memchr(line, '\n', end - line); // The end of the line.
+            if (newline == NULL && !finished)
+            {
+                break;
+            }
+            newline = newline ? newline : end;
+
+            if (parseHexLine(&import, line, newline) == -1)
+            {
+                *errorLine = lineNumber;
+                result = -1;
+                break;
+            }
+            lineNumber++;
+            line = newline + 1 < end ? newline + 1 : end;
+        }
+
+        // Keep what is left of a line that has not been read in full.
+        filled = end - line;
+        memmove(text, line, filled);
+        if (filled >= FROMHEX_BLOCK && result == 0)
+        {
+            *errorLine = lineNumber;
+            result = -1;
+        }
+    }
+
+    flushHexImport(&import);
+    free(text);
+    free(import.output);
+
+    if (import.failed)
+    {
+        *errorLine = 0;
+        return -1;
+    }
+    return result == 0 ? (long int)import.position : -1;
+}
+
+#endif
@@ -2,25 +2,60 @@
 // hexeditor.c
 // Main source file - use this file to compile project.
 //
+// Compile: gcc hexeditor.c -o hexeditor -lm -pthread
+//
 // Usage: ./hexeditor {File}
+//        ./hexeditor --apply {Patches} {File}      Applies a file of patches without opening the editor (read top of patch.h).
+//        ./hexeditor --dump {File} [{Start}:{Length}]  Writes a hex dump of the file, or the segment given in hexadecimal,
+//                                                      to stdout (read top of dump.h). Either number may be left out.
+//        ./hexeditor --diff {File} {Other}        Opens the file with the bytes of another file shown beside it, and the
+//                                                  bytes that differ highlighted (read top of diff.h).
+//        ./hexeditor --from-hex {Listing} {File}   Turns a hex listing, such as an edited dump, back into a file (read top
+//                                                  of fromhex.h). Use - for stdin or stdout.
+//        ./hexeditor --index {File}                Opens the file and builds an index of it in {File}.hxi in the background,
+//                                                  which searches use to skip blocks (read top of searchindex.h). Once it
+//                                                  exists, the index is used and kept up to date whenever the file is opened.
+//        ./hexeditor --strings {File} [{Minimum}]  Writes the printable strings of the file to stdout with their offsets,
+//                                                  ASCII or UTF-16LE, of at least {Minimum} characters (default 4, read
+//                                                  top of printables.h).
 //
 // A test file, test.txt, has been provided if you choose to use that. It is a copy of this file (possibly from some other version).
 //
-// IMPORTANT NOTE: APPLICATION CHANGES TERMINAL SETTINGS; TO RESTORE THEM, EXIT FROM THE APPLICATION NORMALLY
-//                 basically
-//                 DON'T USE SIGNAL INTERRUPT (CTRL + C) TO EXIT
+// IMPORTANT NOTE: APPLICATION CHANGES TERMINAL SETTINGS; THEY ARE RESTORED WHEN IT EXITS, INCLUDING WITH CTRL + C.
+//                 Edits that have not been written are kept in {File}.journal until they are written or the application
+//                 quits with X. If the application stops any other way, it offers to recover them when the file is opened again.
 //
-// Notes: Application best used with a large terminal size.
-//        In the program, navigate to different bytes using arrow keys
+// Notes: Application best used with a large terminal size. The editor shows as many lines as fit the terminal, with 16, 32
+//        or 64 bytes on each, and follows the terminal when it is resized.
+//        In the program, navigate to different bytes using arrow keys. Page Up and Page Down move a screen at a time, Home and
+//        End move to the start and end of the file, and G moves to an offset typed in hexadecimal.
 //
 //        Edit bytes by typing in a hexadecimal value. A byte that is being editted has a red background.
 //
 //        Using the search key (S), search for a given pattern in the file as a hexadecimal number with no spaces. For example:
 //        To search for ABCDE, type 6566676869 so that the output would show 0x6566676869
+//        Searching with no pattern finds the next match of the last pattern. Spaces in the pattern are ignored, and ? in place of
+//        a digit matches any digit, so 48 8B ?? ?? E8 finds a call after a mov, and 4? finds any byte from 0x40 to 0x4F.
+//        Start the pattern with / to search for a regular expression over the bytes instead, such as /v[0-9]+\.[0-9]+ for
+//        a version string or /https?://[!-~]+ for a URL (read top of regexsearch.h).
+//        Using the match all key (M), every match of a pattern is found in the background while the count is shown. Use n and N
+//        to move to the next and previous match.
+//        Using the overview key (O), a map of the whole file is shown beside the lines, coloured by the entropy of each part:
+//        blue for little, green for text, cyan and yellow for more, and red for compressed or encrypted data. Use the arrows
+//        to select a part and Enter to move there, and O again to hide the map.
+//        Using the strings key (T), the printable strings of the file are found in the background and listed in the place
+//        of the lines, ASCII and UTF-16LE, starting from the cursor. Use the arrows to select one and Enter to move to it,
+//        and T or Escape to go back to the lines.
+//        When comparing with another file, use J and K to move to the next and previous range of bytes that differ.
+//        Insert a zero byte before the cursor with Insert, to be typed over, and delete the byte under the cursor with Delete.
+//        I and Y insert or delete a number of bytes typed in hexadecimal. The bytes after them move, changing the size of
+//        the file.
+//        Undo the last edit with U and redo it with R. Edits to adjacent bytes are undone together.
 //        To save a file that has been editted, use W. This will commit the changes made to the file.
 //        To abort any changes made, use X.
 //
-// Readability Notes: The code uses the word "line" to refer to a set of 16 bytes in the file.
+// Readability Notes: The code uses the word "line" to refer to a set of bytesPerLine bytes in the file. A line holds 16, 32 or 64
+//                    bytes, whichever fits the width of the terminal, and as many lines are shown as fit its height.
 //
 // Design Choices:-
 //
@@ -28,18 +63,65 @@
 //        to saving all of the contents of the file into a string to avoid using excessive amounts of memory.
 //        By doing this, a limited amount of memory can be used by pushing and pulling needed / unneeded lines.
 //
+//        The file itself is read through a file map (read top of filemap.h for more info), so reading a line is a view
+//        into memory rather than a seek and a read. Lines that are shown are read through a block cache (read top of
+//        blockcache.h for more info), which reads the pages ahead of a scroll in the background.
+//
+//        Edits are stored in a piece table (read top of piecetable.h for more info) over the original file, instead of
+//        in a temporary copy of the file, so opening a file takes the same time no matter how large it is. Its pieces
+//        are kept in a balanced tree, so inserting or deleting bytes costs the same as overwriting them, and the offsets
+//        of the lines shown are only worked out when they are read.
+//        Writing the changes only rewrites the ranges that were changed, or streams the contents into a new file if the
+//        size has changed (read top of savefile.h for more info).
+//
+//        The overview counts the bytes of each 64 KiB block in the background on every thread (read top of overview.h for
+//        more info), and keeps only their entropy and mix, so it copes with very large files and only counts the blocks
+//        that edits change again.
+//
+//        The strings are read off masks of the printable and zero bytes, which are worked out 16 or 32 bytes at a time
+//        with vector compares (read top of printables.h for more info), on every thread.
+//
+//        Each frame of the screen is built in one buffer (read top of frame.h for more info) and written to the
+//        terminal with a single write(), rather than with a printf() call for every byte. Only the cells that changed
+//        since the previous frame are written (read top of screen.h for more info).
+//
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include <regex.h>
+#include <strings.h>
 #include <math.h>
+#include <time.h>
 
 #include "textutils.h"
 #include "deque.h"
 #include "consoleutils.h"
-
-#define BUFFER_HEIGHT 10
+#include "filemap.h"
+#include "piecetable.h"
+#include "savefile.h"
+#include "search.h"
+#include "searchindex.h"
+#include "frame.h"
+#include "screen.h"
+#include "undo.h"
+#include "journal.h"
+#include "patch.h"
+#include "dump.h"
+#include "fromhex.h"
+#include "diff.h"
+#include "overview.h"
+#include "printables.h"
+
+#define FRAME_INTERVAL 16 // Fewest milliseconds between frames while keys are arriving.
+#define BUFFER_HEIGHT 10 // Lines shown if the size of the terminal is unknown.
+#define VIEW_TOP 10 // Row of the screen the first line is shown on.
+#define VIEW_MARGIN 18 // Rows of the screen that are not lines (header, column numbers, status and toolbar).
+#define MAX_BYTES_PER_LINE 64 // Most bytes shown on a line.
+#define CACHE_PAGE_SIZE 16384 // Size of the pages of the file that are cached for the lines shown.
+#define CACHE_BUDGET 8388608 // Least memory the cached pages may use.
+#define CACHE_SCREENS 64 // Screens of lines the cache holds, if that is more than CACHE_BUDGET.
+#define OVERVIEW_WIDTH 5 // Characters of the overview beside the lines, including the space before it.
+#define SEARCH_INPUT_LENGTH 1024 // Longest search input, enough for SEARCH_MAX_PATTERN bytes separated by spaces.
 
 enum EditorState {
     browsing,
@@ -55,15 +137,100 @@ enum SelectState
 unsigned long int lineOffset; // The line offset in the file that the user has navigated to.
 unsigned long int size; // The size of the file in bytes.
 unsigned long int lineSize; // The number of lines in the file.
-int bufferHeight = BUFFER_HEIGHT; // The true size of the buffer (different to preprocessor variable if file is small).
-int written = 1; // Whether the changes have been written to the temporary file.
+int viewHeight = BUFFER_HEIGHT; // The number of lines that fit on the screen.
+int bufferHeight = BUFFER_HEIGHT; // The true size of the buffer (different to viewHeight if file is small).
+int bytesPerLine = 16; // The number of bytes on each line.
+int written = 1; // Whether the changes have been written to the piece table.
 deque *fileBuffer; // The buffer containing the contents of the file. Explanation of data type at top.
-FILE *file; // The temporary file that is being editted.
+fileMap *file; // The file that is being editted.
+pieceTable *document; // The contents of the file, including any changes. Explanation of data type at top.
+blockCache *cache; // The cache the lines shown are read through. Explanation of data type at top.
+undoLog *history; // The edits that can be undone and redone. Explanation of data type at top.
+editJournal *journal; // The journal edits are recorded in until they are written, or NULL. Explanation of data type at top.
+fileMap *comparison; // The file the bytes are compared with (--diff), or NULL.
+diffIndex *differences; // The ranges that differ from comparison, or NULL. Explanation of data type at top.
+overviewMap *overview; // The entropy of each block, counted once O is first pressed, or NULL. Explanation of data type at top.
+int overviewShown; // Whether the overview is shown beside the lines.
+int overviewRow = -1; // The row of the overview selected with the arrows, or -1 while the lines have focus.
+printableList *printables; // The printable strings, found in the background once T is first pressed, or NULL. Explanation of data type at top.
+int stringsShown; // Whether the strings are listed in the place of the lines.
+unsigned long int stringSelected; // The number of the string selected in the list.
+unsigned long int stringTop; // The number of the string at the top of the list.
+unsigned long int stringAnchor = -1; // The offset the selection follows as strings are found, until a key moves it, or -1.
+int stringsStale; // Whether the contents have been edited since the strings were found.
 
 int x; // X position of cursor
 int y; // Y position of cursor
 
-int foundFlag; // The flag set if the searchBuffer in searchAlgorithm() is found.
+int foundFlag; // The flag set if the pattern in searchAlgorithm() is found.
+searchPattern *lastPattern; // The pattern that was last searched for. An empty search finds its next match.
+unsigned long int lastMatch; // The location of the last match of lastPattern.
+threadPool *workers; // The threads large jobs such as searches are split across.
+searchIndex *gramIndex; // The index of the file that searches skip blocks with, or NULL. Explanation of data type at top.
+searchAll *matches; // The search for every match started with M, which runs in the background.
+frameBuffer *frame; // The buffer each frame of the screen is built in before it is written.
+screenModel *screen; // What the terminal is showing, so that only changes are written. Explanation of data type at top.
+
+char statusMessage[128]; // Message shown above the toolbar, such as the result of writing to the file.
+
+// Finds the time passed since a point in time.
+// since: the point in time, from CLOCK_MONOTONIC.
+//
+// Returns: the milliseconds passed.
+long int millisecondsSince(struct timespec *since)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * 1000 + (now.tv_nsec - since->tv_nsec) / 1000000;
+}
+
+// Finds the time left until a number of milliseconds have passed since a point in time.
+// since: the point in time, from CLOCK_MONOTONIC.
+// interval: the number of milliseconds.
+//
+// Returns: the milliseconds left, or 0 if the interval has passed.
+int millisecondsUntil(struct timespec *since, int interval)
+{
+    long int elapsed = millisecondsSince(since); // Milliseconds passed.
+    return elapsed < interval ? interval - elapsed : 0;
+}
+
+// Sizes the lines shown to the terminal: as many lines as fit its height, with as many bytes as fit its width.
+void sizeViewport()
+{
+    // Each line is 19 characters of offset and spacing plus 5 characters a byte, or 6 when the bytes of the other file
+    // are shown instead of the characters, and the overview takes a few more beside it.
+    int byteWidth = comparison ? 6 : 5; // Characters of each byte.
+    int overviewWidth = overviewShown ? OVERVIEW_WIDTH : 0; // Characters of the overview.
+    bytesPerLine = MAX_BYTES_PER_LINE;
+    while (bytesPerLine > 16 && 19 + byteWidth * bytesPerLine + overviewWidth > w.ws_col)
+    {
+        bytesPerLine /= 2;
+    }
+
+    viewHeight = w.ws_row > 0 ? w.ws_row - VIEW_MARGIN : BUFFER_HEIGHT;
+    if (viewHeight < 1)
+    {
+        viewHeight = 1;
+    }
+    if (overviewRow >= viewHeight)
+    {
+        overviewRow = viewHeight - 1;
+    }
+
+    lineSize = size / bytesPerLine;
+
+    // Changes the buffer height variable to ensure cursor doesn't overflow if file is small (if the line size of the file is less than viewHeight).
+    bufferHeight = lineSize < (unsigned long int)viewHeight ? (int)lineSize + 1 : viewHeight;
+}
+
+// Sizes the cache to the lines shown, so that it holds several screens and reads a screen ahead of a scroll.
+void sizeCache()
+{
+    unsigned long int screenBytes = (unsigned long int)viewHeight * bytesPerLine; // Bytes shown at once.
+    unsigned long int budget = screenBytes * CACHE_SCREENS > CACHE_BUDGET ? screenBytes * CACHE_SCREENS : CACHE_BUDGET;
+    resizeBlockCache(cache, budget, screenBytes);
+}
 
 // Loads a file to be editted.
 // fileName: the location of the file
@@ -71,7 +238,9 @@ int foundFlag; // The flag set if the searchBuffer in searchAlgorithm() is found
 // Throws if fileName does not exist.
 void loadFile(char *fileName)
 {
-    file = fopen(fileName, "r+");
+    freeBlockCache(cache);
+    closeFileMap(file);
+    file = openFileMap(fileName);
 
     // Throw if file does not exist.
     if(!file)
@@ -80,90 +249,258 @@ void loadFile(char *fileName)
         exit(1);
     }
 
+    // Store edits in a piece table over the file.
+    freePieceTable(document);
+    document = buildPieceTable(file);
+    cache = buildBlockCache(file, CACHE_PAGE_SIZE, CACHE_BUDGET);
+    document->cache = cache;
+
     // Finds the size of the file, and sets it to global variable size.
-    fseek(file, 0, SEEK_END);
-    size = ftell(file);
-    lineSize = ceill(size / 16);
-    fseek(file, 0, SEEK_SET);
-    
-    // Changes the buffer height variable to ensure cursor doesn't overflow if file is small (if the line size of the file is less than BUFFER_HEIGHT).
-    if (lineSize <= BUFFER_HEIGHT)
-    {
-    	bufferHeight = lineSize + 1;
-    }
+    size = document->size;
+    sizeViewport();
+    sizeCache();
 }
 
 // Read a certain segment of a file
 // offset: the start position of reading from the file
 // bufferLength: the length of the fileBuffer being written to.
 //
-// Returns: the buffer at offset.
+// Returns: a copy of the buffer at offset. The copy is only valid until the next read, and must not be freed.
 char *readFileContents(long int offset, int bufferLength)
 {
-    // Allocate enough memory for the buffer
-    char *tempBuffer = (char *)malloc(bufferLength);
+    static char *lineBuffer; // Copy of the segment, padded past the end of the file.
+    static int lineLength; // Allocated size of lineBuffer.
 
-    // Naviage to the offset in the file and read to tempBuffer
-    fseek(file, offset, SEEK_SET);
-    fread(tempBuffer, bufferLength, 1, file);
+    if (bufferLength > lineLength)
+    {
+        free(lineBuffer);
+        lineBuffer = (char *)malloc(bufferLength);
+        lineLength = bufferLength;
+    }
 
-    // Return to start of file and return the biffer.
-    fseek(file, 0, SEEK_SET);
-    return tempBuffer;
+    // Copy through the piece table, which reads unchanged parts of the file through the cache.
+    readPieceTable(document, offset, lineBuffer, bufferLength);
+    return lineBuffer;
 }
 
-// Convert a hex character to an integer.
-// hex: the hex character.
-//
-// Returns: the base 10 representation of the hexadecimal character.
-// Note: returns -1 if not a hexadecimal character.
-int convertHexChar(char hex) 
+// Reads the contents of a file to the buffer. The lines are read at once, so that a jump costs one read.
+// offset: the starting position reading from the file
+// lineCount: the length of the fileBuffer, or lines of the file that are read at one time.
+void readFileLines(long int offset, int lineCount)
+{
+    char *lines = readFileContents(offset, lineCount * bytesPerLine); // Every line that is read.
+
+    // Count up to lineCount.
+    for (int i = 0; i < lineCount; i++) // i refers to the line offset.
+    {
+        // Add the line to the buffer
+        insertDequeFront(fileBuffer, lines + i * bytesPerLine);
+    }
+}
+
+// Asks for the pages of the file next to an offset to be read in the background. The cache holds pages of the original
+// file, so the offset is found in it first, and nothing is read ahead of bytes that edits added.
+// offset: the offset in the contents the editor is moving towards.
+// direction: 1 to read the pages from offset onwards, -1 for the pages from offset backwards.
+void readAheadAt(unsigned long int offset, int direction)
 {
-    if (hex >= '0' && hex <= '9')
+    unsigned long int fileOffset; // The offset in the original file.
+    if (locatePieceTable(document, offset, &fileOffset))
     {
-        return hex - '0';
+        readAheadBlockCache(cache, fileOffset, direction);
     }
-    if (hex >= 'A' && hex <= 'F')
+}
+
+// Stops the background search for every match, keeping the matches it found so far.
+void cancelMatches()
+{
+    if (matches && matches->running)
     {
-        return hex - 'A' + 10;
+        cancelSearchAll(matches);
+        snprintf(statusMessage, sizeof(statusMessage), "MATCH ALL STOPPED BY EDIT");
     }
-    if (hex >= 'a' && hex <= 'f')
+}
+
+// Stops finding the printable strings in the background, keeping the strings it found so far. They are found again the
+// next time they are listed, as the edit may have changed them.
+void cancelStrings()
+{
+    if (printables == NULL)
     {
-        return hex - 'a' + 10;
+        return;
     }
 
-    return -1;
+    if (printables->running)
+    {
+        cancelPrintableList(printables);
+        snprintf(statusMessage, sizeof(statusMessage), "STRINGS STOPPED BY EDIT");
+    }
+    stringsStale = 1;
 }
 
-// Reads the contents of a file to the buffer
-// offset: the starting position reading from the file
-// lineCount: the length of the fileBuffer, or lines of the file that are read at one time.
-void readFileLines(long int offset, int lineCount)
+// Stops and frees the background search for every match.
+void stopMatches()
 {
-    // Count up to lineCount.
-    for (int i = 0; i < lineCount; i++) // i refers to the line offset.
+    if (matches == NULL)
     {
-        // Navigate to the offset of the file.
-        fseek(file, offset + (i * 16), SEEK_SET);
-
-        // Read the line in the file.
-        char *line = (char *)malloc(16);
-        fread(line, 16, 1, file);
+        return;
+    }
 
-        // Add it to the buffer
-        insertDequeFront(fileBuffer, line);
+    // Keep the pattern if it is still the last pattern searched for.
+    searchPattern *pattern = matches->pattern;
+    stopSearchAll(matches);
+    matches = NULL;
+    if (pattern != lastPattern)
+    {
+        freeSearchPattern(pattern);
     }
 }
 
-// Writes a character to a file
+// Writes a character to the piece table. The file itself is only changed once the changes are written.
 // offset: the offset of the character
 // ch: the character to write
 void writeCharToFile(long int offset, char ch)
 {
-    // Navigate to the position.
-    fseek(file, offset, SEEK_SET);
-    fputs(&ch, file);
-    fseek(file, 0, SEEK_SET);
+    // Background jobs read the piece table, so they must stop before it changes.
+    cancelMatches();
+    cancelStrings();
+    stopOverview(overview);
+
+    // Record the edit so that it can be undone, unless it changes nothing.
+    char old; // The byte before the edit.
+    readPieceTable(document, offset, &old, 1);
+    if (old == ch)
+    {
+        return;
+    }
+    recordUndoLog(history, offset, &old, &ch, 1);
+    writePieceTable(document, offset, &ch, 1);
+    appendJournal(journal, editOverwrite, offset, &ch, 1);
+    touchSearchIndex(gramIndex, offset, 1);
+    touchOverview(overview, offset, 1);
+    if (differences)
+    {
+        updateDiffIndex(differences, document, comparison, offset, 1);
+    }
+}
+
+// Replays an edit recovered from the journal. It can be undone like any other edit.
+// kind: the kind of edit.
+// offset: the offset of the first byte edited.
+// bytes: the bytes after the edit, or the bytes inserted.
+// length: the number of bytes edited.
+void recoverEdit(enum EditKind kind, unsigned long int offset, unsigned char *bytes, unsigned long int length)
+{
+    if (offset > document->size || (kind != editInsert && length > document->size - offset))
+    {
+        return;
+    }
+
+    if (kind == editOverwrite)
+    {
+        touchSearchIndex(gramIndex, offset, length);
+    }
+    else
+    {
+        shiftSearchIndex(gramIndex, offset);
+    }
+
+    if (kind == editInsert)
+    {
+        recordUndoLogResize(history, kind, offset, bytes, length);
+        insertPieceTable(document, offset, bytes, length);
+    }
+    else
+    {
+        unsigned char *old = (unsigned char *)malloc(length); // The bytes before the edit.
+        readPieceTable(document, offset, old, length);
+        if (kind == editDelete)
+        {
+            recordUndoLogResize(history, kind, offset, old, length);
+            deletePieceTable(document, offset, length);
+        }
+        else
+        {
+            recordUndoLog(history, offset, old, bytes, length);
+            writePieceTable(document, offset, bytes, length);
+        }
+        free(old);
+    }
+}
+
+// Offers to recover the edits left in the journal of a file, and opens the journal for new edits.
+// fileName: the location of the file.
+void recoverJournal(char *fileName)
+{
+    unsigned long int records; // Edits in the journal.
+    int matches; // Whether the file is the same as when the edits were made.
+    int keep = 0; // Whether the edits are recovered.
+
+    if (checkJournal(fileName, file, &records, &matches))
+    {
+        printf("%s.journal holds %lu edits that were not written to the file.%s\n", fileName, records,
+               matches ? "" : "\nThe file has changed since the edits were made, so they may no longer apply.");
+        printf("Recover them? (Y / N) ");
+        fflush(stdout);
+        toggleEOFRequirement();
+        int c = readKey();
+        keep = c == 89 || c == 121;
+        printf("\n");
+    }
+
+    journal = openJournal(fileName, file, keep);
+    if (keep)
+    {
+        struct timespec start; // When the replay started.
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        replayJournal(fileName, recoverEdit);
+        sealUndoLog(history);
+
+        // Recovered inserts and deletes change the size.
+        size = document->size;
+        sizeViewport();
+        snprintf(statusMessage, sizeof(statusMessage), "RECOVERED %lu EDITS IN %ld MS", records, millisecondsSince(&start));
+    }
+    else if (journal == NULL)
+    {
+        snprintf(statusMessage, sizeof(statusMessage), "Could not create %s.journal, edits are not journalled", fileName);
+    }
+}
+
+// Writes the byte under the cursor to the piece table if it has been changed since it was last written.
+void commitEdit()
+{
+    if (!written)
+    {
+        writeCharToFile((lineOffset + y) * bytesPerLine + x, readDequeByte(fileBuffer, y, x));
+        written = 1;
+    }
+}
+
+// Display the bytes of the other file on a line, in the place of the characters.
+// line: the line number of the row
+void writeComparisonLine(long int line)
+{
+    unsigned char bytes[MAX_BYTES_PER_LINE]; // The bytes of the other file on the line.
+    unsigned long int start = (line + lineOffset) * bytesPerLine; // The offset of the first byte on the line.
+    unsigned long int count = readFileMap(comparison, start, bytes, bytesPerLine); // Bytes the other file has.
+
+    for (int i = 0; i < (int)count; i++)
+    {
+        // Bytes that differ are highlighted, and the byte under the cursor is marked as in the characters.
+        int selected = x == i && y == line; // Whether the cursor is on the byte.
+        int differs = differsDiffIndex(differences, start + i); // Whether the byte differs.
+        if (selected || differs)
+        {
+            appendFrameText(frame, selected ? "\033[30;47m" : SGR_FOREGROUND_YELLOW);
+        }
+        appendFrameHex(frame, bytes[i]);
+        if (selected || differs)
+        {
+            appendFrameText(frame, SGR_RESET);
+        }
+        appendFrame(frame, " ", 1);
+    }
 }
 
 // Display a single line of the fileBuffer on the screen
@@ -171,71 +508,66 @@ void writeCharToFile(long int offset, char ch)
 void writeLine(long int line)
 {
     // Prints the line offset as an 8 character long hexadecimal string
-    printf("  0x%08lX   ", (line + lineOffset) * 16);
+    moveFrameCursor(frame, 0, VIEW_TOP + line);
+    appendFrame(frame, "  ", 2);
+    appendFrameOffset(frame, (line + lineOffset) * bytesPerLine);
+    appendFrame(frame, "   ", 3);
 
     // Display byte value
-    for (int i = 0; i < 16; i++)
+    for (int i = 0; i < bytesPerLine; i++)
     {
+        // Bytes that differ from the other file are highlighted.
+        int differs = differences && differsDiffIndex(differences, (line + lineOffset) * bytesPerLine + i);
+
         // Reverts background changes if the current byte is selected.
         if (x == i && y == line)
         {
-            if (editorState == editing)
-            {
-                // Display red background
-                printf(SGR_BACKGROUND_RED);
-            }
-            else
-            {
-                // Display black text with white background
-                printf("\033[30;47m");
-            }
+            // Display red background while editing, otherwise black text with white background
+            appendFrameText(frame, editorState == editing ? SGR_BACKGROUND_RED : "\033[30;47m");
+        }
+        else if (differs)
+        {
+            appendFrameText(frame, SGR_FOREGROUND_YELLOW);
         }
 
         // Display current byte as a 2 character long hexadecimal string.
-        printf("%02X", readDequeByte(fileBuffer, line, i) &0xff);
-        
+        appendFrameHex(frame, readDequeByte(fileBuffer, line, i));
+
         // Reverts any background changes if the byte is selected
-        if (x == i && y == line)
+        if ((x == i && y == line) || differs)
         {
-            printf(SGR_RESET);
+            appendFrameText(frame, SGR_RESET);
         }
-        printf(" ");
+        appendFrame(frame, " ", 1);
     }
 
-    printf("    ");
+    appendFrame(frame, "    ", 4);
 
-    // Display ASCII section
-    for (int i = 0; i < 16; i++)
+    // When comparing, the bytes of the other file are shown instead of the characters.
+    if (comparison)
     {
-        char c = readDequeByte(fileBuffer, line, i); // Current character
+        writeComparisonLine(line);
+        return;
+    }
 
+    // Display ASCII section, with a placeholder / dummy character for characters that cannot be displayed.
+    for (int i = 0; i < bytesPerLine; i++)
+    {
         // Changes background if the current byte is selected
         if (x == i && y == line)
         {
-            printf("\033[30;47m");
+            appendFrameText(frame, "\033[30;47m");
         }
 
-        // Check if character is within range of displayable characters
-        if (c >= 32 && c <= 126)
-        {
-            // If so, print character
-            printf("%c", c);
-        }
-        else
-        {
-            // Otherwise print placeholder / dummy character.
-            printf(".");
-        }
+        appendFrameAscii(frame, readDequeByte(fileBuffer, line, i));
 
         // Reverts background changes if the current byte is selected.
         if (x == i && y == line)
         {
-            printf(SGR_RESET);
+            appendFrameText(frame, SGR_RESET);
         }
-        printf(" ");
+        appendFrame(frame, " ", 1);
     }
-
-    printf("\n");
 }
 
 // Writes the fileBuffer
@@ -246,7 +578,7 @@ void writeBuffer(int bufferHeight)
     for (int i = 0; i < bufferHeight; i++)
     {
         // Skip if the line doesn't exist
-        if ((lineOffset + i) * 16 > size)
+        if ((lineOffset + i) * bytesPerLine > size)
         {
             break;
         }
@@ -255,312 +587,1531 @@ void writeBuffer(int bufferHeight)
     }
 }
 
-// Draws the user interface to the terminal
-void drawScreen()
+// Finds the segment of the contents a row of the overview stands for. Each row stands for an equal share of them.
+// row: the row, from 0 to viewHeight - 1.
+// from: set to the first byte of the segment.
+// to: set to one past the last byte of the segment.
+void findOverviewSegment(int row, unsigned long int *from, unsigned long int *to)
 {
-    clear();
-    
-    // Header
-    drawLine(SGR_BACKGROUND_WHITE, 0, ' ');
-    centreText("\033[0;30;47m", 0, "Hex Editor");
-
-    // Editor
-    setCursorPos(0, 8);
-    printf("               00 01 02 03 04 05 06 07 08 09 0A 0B 0C 0D 0E 0F");
-    setCursorPos(0, 10);
-    writeBuffer(BUFFER_HEIGHT);
-
-    // Bottom Toolbar
-    distributeLines(" ", " \033[30;47m S \033[0;0m Pattern Search", 0, w.ws_row - 5, 2, 0);
-    distributeLines(" \033[30;47m W \033[0;0m Write to File ", " \033[30;47m X \033[0;0m Quit ", 0, w.ws_row - 5, 2, 1);
-
-    // Disable cursor blink
-    printf("\e[?25l");
+    *from = size / viewHeight * row + size % viewHeight * row / viewHeight;
+    *to = size / viewHeight * (row + 1) + size % viewHeight * (row + 1) / viewHeight;
 }
 
-// Finds a buffer in file
-// searchBuffer: the string to search for
-// searchLength: the length of the search buffer
+// Finds the row of the overview that stands for an offset.
+// offset: the offset in the file.
 //
-// Returns: the offset of the buffer (if its there)
-long unsigned int searchAlgorithm(char *searchBuffer, int searchLength)
+// Returns: the row.
+int findOverviewRow(unsigned long int offset)
 {
-    // Iterate through each line of the file
-    for (int i = 0; i < size / 16; i++) // i refers to the line offset in the file
-    {
-        char *readBuffer = readFileContents(i * 16, 16); // The contents of the line
+    unsigned long int from; // The first byte of the row.
+    unsigned long int to; // One past the last byte of the row.
+    int row = size ? (int)((double)offset / size * viewHeight) : 0; // The row, which rounding may leave one out.
+    row = row < viewHeight ? row : viewHeight - 1;
 
-        // Iterate through each byte in the line
-        for (int j = 0; j < 16; j++) // j refers to the byte that is being inspected
-        {
-            // Check to see if first byte in search exists in line
-            if (readBuffer[j] == searchBuffer[0])
-            {
-                // The goal of this segment of code is to read the same amount of bytes as the length of the search buffer, then to
-                // verify that the string exists in the output.
+    findOverviewSegment(row, &from, &to);
+    if (offset < from && row > 0)
+    {
+        row--;
+    }
+    else if (offset >= to && row < viewHeight - 1)
+    {
+        row++;
+    }
+    return row;
+}
 
-                readBuffer = readFileContents(i * 16 + j, searchLength); // The contents of the file at the offset where the first byte was found.
+// Display the overview beside the lines. Each row is coloured by the mean entropy of its share of the contents: blue
+// for little, cyan for more, yellow for a lot and red for what looks compressed or encrypted, or green if it is mostly
+// text. Rows that have not been counted yet show --. The row of the lines shown is marked with >, and the row
+// selected with <.
+void writeOverview()
+{
+    int column = 19 + (comparison ? 6 : 5) * bytesPerLine + 1; // The first column after the lines (see sizeViewport()).
+    int shownRow = findOverviewRow(lineOffset * bytesPerLine); // The row of the lines shown.
 
-                // Check if searchBuffer exists in next [searchLength] bytes.
-                if (strstr(readBuffer, searchBuffer))
-                {
-                    free(readBuffer);
-                    foundFlag = 1;
-                    return i * 16 + j; // i * 16 + j is the location of the first byte in the file that was matched with searchBuffer
-                }
+    moveFrameCursor(frame, column + 1, VIEW_TOP - 2);
+    appendFrameText(frame, "MAP");
 
-                // If this does not match, return readBuffer to the original "contents of the line"
-                char *readBuffer = readFileContents(i * 16, 16);
-            }
+    for (int row = 0; row < viewHeight; row++)
+    {
+        unsigned long int from; // The first byte of the row.
+        unsigned long int to; // One past the last byte of the row.
+        overviewSummary summary; // The entropy of the row.
+        findOverviewSegment(row, &from, &to);
+        summariseOverview(overview, from, to, &summary);
+
+        moveFrameCursor(frame, column, VIEW_TOP + row);
+        appendFrame(frame, row == shownRow ? ">" : " ", 1);
+        if (summary.counted == 0)
+        {
+            appendFrame(frame, "--", 2);
         }
-
-        free(readBuffer);
+        else
+        {
+            appendFrameText(frame, summary.text >= 90 ? SGR_BACKGROUND_GREEN : summary.entropy < 2 ? SGR_BACKGROUND_BLUE :
+                                   summary.entropy < 6 ? SGR_BACKGROUND_CYAN : summary.entropy < 7.5 ? SGR_BACKGROUND_YELLOW :
+                                   SGR_BACKGROUND_RED);
+            appendFrame(frame, "  ", 2);
+            appendFrameText(frame, SGR_RESET);
+        }
+        appendFrame(frame, row == overviewRow ? "<" : " ", 1);
     }
-    
-    return 0;
 }
 
-// Replaces real file with temporary file (writes changes)
-// argv: Arguments supplied through main
-void writeTemporaryToRealFile(char **argv)
+// Display the strings in the place of the lines, a row each: the offset, A for ASCII or U for UTF-16LE, and as many of
+// the characters as fit. The string selected is highlighted.
+void writeStrings()
 {
-    char copyCommand[500];
-    snprintf(copyCommand, 499, "cp %s.tmp %s", argv[1], argv[1]); // Creates command for copying the command i.e.   cp {FILE}.tmp {FILE}
-    system(copyCommand); // Executes the command
-}
-
-int main(int argc, char **argv)
-{
-    // Initialise console utilities for screen resizing
-    initialiseConsoleutils();
+    int width = 19 + (comparison ? 6 : 5) * bytesPerLine - 20; // Characters of each string shown (see sizeViewport()).
+    char characters[19 + 6 * MAX_BYTES_PER_LINE]; // The characters of a string that are shown.
 
-    // Load file which will be editted.
-    loadFile(argv[1]);
-
-    // Create temporary file for reading / writing changes without committing them.
-    char copyCommand[500];
-    char tempFile[250];
-    snprintf(copyCommand, 499, "cp %s %s.tmp", argv[1], argv[1]); // Creates command for creating temporary file  i.e cp {FILE} {FILE}.tmp
-    snprintf(tempFile, 249, "%s.tmp", argv[1]); // Creates the string for name of the temporary file    i.e {FILE}.tmp
-    system(copyCommand); // Executes the command
-    loadFile(tempFile);
+    // Until a key moves the selection, it stays on the string at the cursor as the strings before it are found.
+    if (stringAnchor != (unsigned long int)-1)
+    {
+        stringSelected = findPrintableRun(printables, stringAnchor);
+        stringTop = stringSelected;
+    }
 
-    // Loads the first set of lines to the fileBuffer
-    fileBuffer = buildDeque(BUFFER_HEIGHT, 16);
-    readFileLines(0, BUFFER_HEIGHT);
+    moveFrameCursor(frame, 2, VIEW_TOP - 2);
+    appendFrameText(frame, "OFFSET       KIND  STRING");
 
-    while (1)
+    for (int row = 0; row < viewHeight; row++)
     {
-        // Checks if the editor has been set to browsing mode and the changes have not been written.
-        if (editorState == browsing && !written)
+        printableRun run; // The string on the row.
+        if (!getPrintableRun(printables, stringTop + row, &run))
         {
-            // Writes the changes and marks the written flag.
-            writeCharToFile(lineOffset + (y * 16) + x, readDequeByte(fileBuffer, y, x));
-            written = 1;
+            break;
         }
 
-        drawScreen();
-
-        // Handle user input.
-        toggleEOFRequirement();
-        int c = getchar();
-        if (c == 88 || c == 120) // X (Quit)
+        int selected = stringTop + row == stringSelected; // Whether the string is selected.
+        moveFrameCursor(frame, 0, VIEW_TOP + row);
+        appendFrame(frame, "  ", 2);
+        if (selected)
         {
-            clear();
-            break;
+            appendFrameText(frame, "\033[30;47m");
         }
-        else if (c == 87 || c == 119) // W (Write)
+        appendFrameOffset(frame, run.offset);
+        appendFrameText(frame, run.wide ? "   U    " : "   A    ");
+
+        // The contents are read rather than the file, so the string shows any edits since it was found.
+        unsigned long int count = readPrintableRun(document, &run, 0, characters, width); // Characters shown.
+        for (unsigned long int i = 0; i < count; i++)
         {
-            writeTemporaryToRealFile(argv);
-            continue;
+            appendFrameAscii(frame, characters[i]);
         }
-        else if (c == 83 || c == 115) // S (Search)
+        if (selected)
         {
-            // Create input panel
-            drawLine(SGR_RESET, w.ws_row - 5, ' ');
-            setCursorPos(w.ws_col / 2 - 17, w.ws_row - 5); // Sets cursor location to middle, assuming 34 characters are written during input
-            restoreConsole(0);
-            printf("0x");
+            appendFrameText(frame, SGR_RESET);
+        }
+    }
+}
 
-            // Sanitise input
-            char inputBufferRaw[33];
-            fgets(inputBufferRaw, 33, stdin);
-            char *inputBuffer;
-            for (int i = 0; i < strlen(inputBufferRaw); i++) // i refers to the character input by user
-            {
-                // Checks that the character is a valid hexadecimal character
-                if (!((inputBufferRaw[i] >= 'A' && inputBufferRaw[i] <= 'F') || (inputBufferRaw[i] >= 'a' && inputBufferRaw[i] <= 'f') || (inputBufferRaw[i] >= '0' && inputBufferRaw[i] <= '9')))
-                {
-                    // Appends it to the sanitised input.
-                    inputBuffer = malloc(i + 1);
-                    memcpy(inputBuffer, inputBufferRaw, i + 1);
-                }
-            }
-            restoreConsole(1);
-            int inputLength = strlen(inputBuffer) - 1; // The length of search input buffer.
+// Draws the user interface to the terminal. The whole screen is built in the frame buffer, and only the parts that
+// differ from the previous frame are written.
+void drawScreen()
+{
+    resetFrame(frame);
 
-            // Abort if the length of the sanitised user input is not divisible by 2 or is too long.
-            if (inputLength % 2 != 0 || inputLength > 16)
+    // Header
+    fillFrameLine(frame, SGR_BACKGROUND_WHITE, 0, ' ');
+    centreFrameText(frame, "\033[0;30;47m", 0, comparison ? "Hex Editor - Comparing" : "Hex Editor");
+
+    // Editor, with the column numbers above the lines, and above the bytes of the other file when comparing. The
+    // strings are listed in their place while they are shown.
+    if (stringsShown)
+    {
+        writeStrings();
+    }
+    else
+    {
+        moveFrameCursor(frame, 0, VIEW_TOP - 2);
+        appendFrameText(frame, "               ");
+        for (int column = 0; column < (comparison ? 2 : 1); column++)
+        {
+            for (int i = 0; i < bytesPerLine; i++)
             {
-                continue;
+                appendFrameHex(frame, i);
+                appendFrame(frame, " ", 1);
             }
+            appendFrame(frame, "    ", 4);
+        }
+        writeBuffer(viewHeight);
+    }
+    if (overviewShown)
+    {
+        writeOverview();
+    }
 
-            // Create the search buffer
-            char *searchBuffer = (char *)malloc(inputLength / 2); // The set of bytes that are being searched for in the file.
-            // Iterate through each set of 2 characters (a byte) in the search input
-            for (int i = 0; i < inputLength / 2; i++) // i refers to the location of the first character in the set of 2 that is being inspected
-            {
-                // Check if input contains non-hex character
-                int hex1 = convertHexChar(inputBuffer[i * 2]); // The first digit of the byte 
-                int hex2 = convertHexChar(inputBuffer[i * 2 + 1]); // The second digit of the byte
-                if (hex1 == -1 || hex2 == -1) // Checks if either digits are invalid
-                {
-                    continue;
-                }
+    // Status message, or the row of the overview selected, or the progress of a background job if there is no message.
+    if (statusMessage[0])
+    {
+        centreFrameText(frame, SGR_RESET, w.ws_row - 7, statusMessage);
+    }
+    else if (stringsShown)
+    {
+        char progress[128]; // The string selected, and the progress of finding them.
+        unsigned long int count; // The number of strings found so far.
+        unsigned long int scanned; // The number of bytes scanned so far.
+        printableRun run; // The string selected.
+        readPrintableList(printables, &count, &scanned);
+        int length = snprintf(progress, sizeof(progress), count ? "STRING %lu OF %lu" : "NO STRINGS",
+                              stringSelected + 1, count);
+        if (getPrintableRun(printables, stringSelected, &run))
+        {
+            length += snprintf(progress + length, sizeof(progress) - length, ": %u CHARACTERS", run.length);
+        }
+        if (printables->running)
+        {
+            snprintf(progress + length, sizeof(progress) - length, " (scanning, %lu%%)", size ? scanned * 100 / size : 100);
+        }
+        else if (printables->full)
+        {
+            snprintf(progress + length, sizeof(progress) - length, " (list full at 0x%08lX)", scanned);
+        }
+        centreFrameText(frame, SGR_RESET, w.ws_row - 7, progress);
+    }
+    else if (overviewRow != -1)
+    {
+        char description[128]; // The summary of the row.
+        unsigned long int from; // The first byte of the row.
+        unsigned long int to; // One past the last byte of the row.
+        overviewSummary summary; // The entropy of the row.
+        findOverviewSegment(overviewRow, &from, &to);
+        summariseOverview(overview, from, to, &summary);
+        snprintf(description, sizeof(description), "0x%08lX - 0x%08lX: ENTROPY %.2f (HIGHEST %.2f), %d%% ZERO, %d%% TEXT, %lu%% COUNTED",
+                 from, to, summary.entropy, summary.highest, summary.zeros, summary.text, summary.blocks ? summary.counted * 100 / summary.blocks : 100);
+        centreFrameText(frame, SGR_RESET, w.ws_row - 7, description);
+    }
+    else if (matches)
+    {
+        char progress[128]; // The progress of the background search.
+        unsigned long int count; // The number of matches found so far.
+        unsigned long int scanned; // The number of bytes searched so far.
+        readSearchAll(matches, &count, &scanned);
+        if (matches->full)
+        {
+            snprintf(progress, sizeof(progress), "MATCHES: %lu (list full)", count);
+        }
+        else if (matches->running)
+        {
+            snprintf(progress, sizeof(progress), "MATCHES: %lu (searching, %lu%%)", count, size ? scanned * 100 / size : 100);
+        }
+        else
+        {
+            snprintf(progress, sizeof(progress), "MATCHES: %lu (N / n to move between them)", count);
+        }
+        centreFrameText(frame, SGR_RESET, w.ws_row - 7, progress);
+    }
+    else if (gramIndex && gramIndex->running)
+    {
+        char progress[128]; // The progress of the index.
+        unsigned long int built = __atomic_load_n(&gramIndex->builtCount, __ATOMIC_RELAXED); // Blocks built so far.
+        snprintf(progress, sizeof(progress), "INDEXING FOR SEARCH: %lu%%", gramIndex->blockCount ? built * 100 / gramIndex->blockCount : 100);
+        centreFrameText(frame, SGR_RESET, w.ws_row - 7, progress);
+    }
+    else if (overview && overview->running)
+    {
+        char progress[128]; // The progress of the overview.
+        unsigned long int counted = __atomic_load_n(&overview->countedCount, __ATOMIC_RELAXED); // Blocks counted so far.
+        snprintf(progress, sizeof(progress), "COUNTING OVERVIEW: %lu%%", overview->blockCount ? counted * 100 / overview->blockCount : 100);
+        centreFrameText(frame, SGR_RESET, w.ws_row - 7, progress);
+    }
 
-                // Adds the byte to the search buffer.
-                searchBuffer[i] = (16 * hex1) + hex2;
-            }
+    // Bottom Toolbar
+    distributeFrameLines(frame, " \033[30;47m M \033[0;0m Match All ", " \033[30;47m S \033[0;0m Pattern Search", 0, w.ws_row - 5, 2, 0);
+    distributeFrameLines(frame, " \033[30;47m W \033[0;0m Write to File ", " \033[30;47m X \033[0;0m Quit ", 0, w.ws_row - 5, 2, 1);
+    distributeFrameLines(frame, " \033[30;47m G \033[0;0m Go to Offset ", " \033[30;47m U \033[0;0m Undo ", 0, w.ws_row - 3, 2, 0);
+    distributeFrameLines(frame, " \033[30;47m R \033[0;0m Redo ", comparison ? " \033[30;47m J / K \033[0;0m Next / Previous Difference " : " \033[30;47m O / T \033[0;0m Overview / Strings ", 0, w.ws_row - 3, 2, 1);
 
-            long unsigned int loc = searchAlgorithm(searchBuffer, inputLength / 2); // The location of the search buffer
+    // Disable cursor blink
+    appendFrameText(frame, "\e[?25l");
+    flushScreen(screen, frame);
+}
 
-            if (!foundFlag)
-            {
-                setCursorPos(w.ws_col / 2 - 32, w.ws_row - 5);
-                restoreConsole(0);
-                printf("LOCATION: NOT FOUND (press enter to continue)");
-                getchar();
-                restoreConsole(1);
-                continue;
-            }
+// Finds a pattern in file
+// pattern: the pattern to search for
+// from: the first offset the pattern can be found at
+//
+// Returns: the offset of the pattern (if its there)
+long unsigned int searchAlgorithm(searchPattern *pattern, unsigned long int from)
+{
+    unsigned long int location; // The location of the first match.
+
+    if (findFirstParallel(workers, document, pattern, gramIndex, from, &location))
+    {
+        foundFlag = 1;
+        return location;
+    }
 
-            // Reset found flag for future use.
-            foundFlag = 0;
-            // Outputs location and reallocates memory / terminal settings
-            setCursorPos(w.ws_col / 2 - 17, w.ws_row - 5);
-            restoreConsole(0);
-            printf("LOCATION: 0x%08lX (press enter to resume)", loc);
-            getchar();
-            restoreConsole(1);
+    return 0;
+}
 
-            free(searchBuffer);
-        }
-        else if (c == 27) // Escape character (in context of this program, navigational keys)
+// Parses a pattern written as hexadecimal digits. Spaces between digits are ignored, and a ? in place of a digit
+// matches any value of that digit. For example: DEAD??EF, 48 8B ?? ?? E8, 4? 0F
+// input: the text of the pattern.
+//
+// Returns: the pattern, or NULL if the input is empty, has an odd number of digits, is longer than SEARCH_MAX_PATTERN
+// bytes or has a character that is not a digit, ? or space.
+searchPattern *parseSearchPattern(char *input)
+{
+    unsigned char searchBuffer[SEARCH_MAX_PATTERN]; // The set of bytes that are being searched for in the file.
+    unsigned char searchMask[SEARCH_MAX_PATTERN]; // The bits of each byte that have to match.
+    int digits = 0; // The number of digits read so far.
+
+    for (char *c = input; *c; c++) // c refers to the character input by user
+    {
+        if (*c == ' ')
         {
-            // Reset editor back to browsing state.
-            if (editorState == editing)
-            {
-                written = 0;
-                editorState = browsing;
-            }
+            continue;
+        }
 
-            // Gets the character to see which directional key was pressed, because why would it need to be simple and it's own key instead of 3 others
-            getchar();
-            int d = getchar();
-            switch (d)
-            {
-                case 65: // UP
-                    // If the cursor is not already at the top, move it up one. Otherwise, check whether editor can move
-                    if (y != 0)
-                    {
-                        y--;
-                    }
-                    else
-                    {
-                        // If the editor is at top already, break from switch statement
-                        if (lineOffset == 0)
-                        {
-                            break;
-                        }
-
-                        // Move editor up and insert new line onto file buffer.
-                        lineOffset--;
-                        char *bufferInsUp = readFileContents((lineOffset - 1) * 16, 16);
-                        pushDequeBack(fileBuffer, bufferInsUp);
-                    }
-
-                    break;
-                case 66: // DOWN
-                    // If the cursor is not already at the bottom, move it down one. Otherwise, check whether editor can move
-                    if (y != bufferHeight - 1)
-                    {
-                        y++;
-                    }
-                    else
-                    {
-                        // If the editor is at bottom already, break from switch statement
-                        if ((lineOffset + BUFFER_HEIGHT) > lineSize)
-                        {
-                            break;
-                        }
-
-                        // Move editor down and insert new line onto file buffer.
-                        lineOffset++;
-                        char *bufferInsDown = readFileContents((BUFFER_HEIGHT + lineOffset) * 16, 16);
-                        pushDequeFront(fileBuffer, bufferInsDown);
-
-                    }
-                    break;
-
-                case 67: // RIGHT
-                    // If the cursor is not on the right of screen already, move right one. Otherwise keep the same.
-                    x = x < 15 ? x + 1 : 15;
-                    break;
-                case 68: // LEFT
-                    // If the cursor is not on the left of screen already, move left one. Otherwise keep the same.
-                    x = x > 0 ? x - 1 : 0;
-                    break;
-                default:
-                    break;
-            }
+        // Check if input contains a character that is neither a hex digit or a wildcard.
+        int hex = convertHexChar(*c); // The value of the digit
+        if (hex == -1 && *c != '?')
+        {
+            return NULL;
         }
-        else
+        if (digits == SEARCH_MAX_PATTERN * 2)
         {
-            // User is writing to a byte.
-            int val = convertHexChar(c); // User input
+            return NULL;
+        }
 
-            // nvm user isn't
-            if (val == -1)
+        // The first digit of a byte is the high nibble.
+        int byte = digits / 2; // The byte the digit belongs to.
+        int shift = digits % 2 == 0 ? 4 : 0; // The position of the digit in the byte.
+        if (shift == 4)
+        {
+            searchBuffer[byte] = 0;
+            searchMask[byte] = 0;
+        }
+        if (hex != -1)
+        {
+            searchBuffer[byte] |= hex << shift;
+            searchMask[byte] |= 0xf << shift;
+        }
+        digits++;
+    }
+
+    // Abort if the number of digits is zero or not divisible by 2.
+    if (digits == 0 || digits % 2 != 0)
+    {
+        return NULL;
+    }
+
+    return buildSearchPattern(searchBuffer, searchMask, digits / 2);
+}
+
+// Reads a line of input from the user on the toolbar.
+// inputBuffer: the buffer the input is read to, without the newline.
+// length: the size of inputBuffer. Anything that does not fit is discarded.
+void promptInput(char *inputBuffer, int length)
+{
+    // Create input panel
+    drawLine(SGR_RESET, w.ws_row - 5, ' ');
+    setCursorPos(w.ws_col / 2 - 17, w.ws_row - 5); // Sets cursor location to middle, assuming 34 characters are written during input
+    restoreConsole(0);
+    printf("0x");
+
+    // Read input, and discard anything that did not fit.
+    fflush(stdout);
+    readInputLine(inputBuffer, length);
+    restoreConsole(1);
+
+    // The prompt was drawn outside of the screen model.
+    invalidateScreen(screen);
+}
+
+// Reads a pattern from the user. A pattern that starts with / is a regular expression.
+// empty: set if the user entered nothing.
+//
+// Returns: the pattern, or NULL if the input was empty or not a valid pattern.
+searchPattern *promptSearchPattern(int *empty)
+{
+    char inputBuffer[SEARCH_INPUT_LENGTH];
+    promptInput(inputBuffer, SEARCH_INPUT_LENGTH);
+
+    *empty = inputBuffer[strspn(inputBuffer, " ")] == '\0';
+    if (inputBuffer[0] != '/')
+    {
+        return parseSearchPattern(inputBuffer);
+    }
+
+    char error[96]; // Why the expression is not valid.
+    searchPattern *pattern = buildRegexSearchPattern(inputBuffer + 1, error, sizeof(error));
+    if (pattern == NULL)
+    {
+        snprintf(statusMessage, sizeof(statusMessage), "INVALID EXPRESSION: %s", error);
+    }
+    return pattern;
+}
+
+// Moves the editor to show a line at the top, and moves the cursor to an offset.
+// top: the line shown at the top, unless that would leave the bottom of the buffer past the end of the file.
+// offset: the offset in the file the cursor moves to, which must be on screen once the editor has moved.
+void moveViewport(unsigned long int top, unsigned long int offset)
+{
+    lineOffset = top;
+    if (lineSize + 1 > (unsigned long int)viewHeight && lineOffset > lineSize + 1 - viewHeight)
+    {
+        lineOffset = lineSize + 1 - viewHeight;
+    }
+    if (lineSize + 1 <= (unsigned long int)viewHeight)
+    {
+        lineOffset = 0;
+    }
+    y = offset / bytesPerLine - lineOffset;
+    x = offset % bytesPerLine;
+
+    // Reload the buffer at the new position.
+    freeDequeLines(fileBuffer);
+    readFileLines(lineOffset * bytesPerLine, viewHeight);
+}
+
+// Moves the editor so that an offset is on screen, and moves the cursor to it.
+// offset: the offset in the file.
+void jumpToOffset(unsigned long int offset)
+{
+    // Show the line at the top.
+    moveViewport(offset / bytesPerLine, offset);
+}
+
+// Sizes the editor to the terminal again after it has been resized, keeping the cursor on the same byte.
+void resizeViewport()
+{
+    // Write the byte being editted first, as the buffer is read again.
+    if (editorState == editing)
+    {
+        written = 0;
+        editorState = browsing;
+    }
+    commitEdit();
+
+    unsigned long int topOffset = lineOffset * bytesPerLine; // The first byte shown.
+    unsigned long int cursorOffset = (lineOffset + y) * bytesPerLine + x; // The byte under the cursor.
+
+    sizeViewport();
+    sizeCache();
+    resizeDeque(fileBuffer, viewHeight, bytesPerLine);
+
+    // Keep the same first byte at the top, unless the cursor would then be off screen.
+    unsigned long int top = topOffset / bytesPerLine; // The line shown at the top.
+    unsigned long int cursorLine = cursorOffset / bytesPerLine; // The line of the cursor.
+    if (cursorLine >= top + bufferHeight)
+    {
+        top = cursorLine - bufferHeight + 1;
+    }
+    moveViewport(top, cursorOffset);
+}
+
+// Moves the cursor up or down a number of lines, scrolling the editor only as far as needed. A scroll of less than a
+// screen pushes the new lines onto the buffer, a longer one reloads it.
+// lines: the number of lines to move, negative to move up.
+void moveCursorLines(long int lines)
+{
+    long int target = (long int)(lineOffset + y) + lines; // The line the cursor moves to.
+    if (target < 0)
+    {
+        target = 0;
+    }
+    if (target > (long int)lineSize)
+    {
+        target = lineSize;
+    }
+
+    // Move only the cursor if the line is on screen.
+    if (target >= (long int)lineOffset && target < (long int)lineOffset + bufferHeight)
+    {
+        y = target - lineOffset;
+        return;
+    }
+
+    if (target < (long int)lineOffset)
+    {
+        // Scroll up so that the line is at the top.
+        if (lineOffset - target >= (unsigned long int)viewHeight)
+        {
+            moveViewport(target, target * bytesPerLine + x);
+        }
+        while (lineOffset > (unsigned long int)target)
+        {
+            lineOffset--;
+            pushDequeBack(fileBuffer, readFileContents(lineOffset * bytesPerLine, bytesPerLine));
+        }
+        y = 0;
+        readAheadAt(lineOffset * bytesPerLine, -1);
+    }
+    else
+    {
+        // Scroll down so that the line is at the bottom.
+        unsigned long int top = target - (bufferHeight - 1); // The line shown at the top afterwards.
+        if (top - lineOffset >= (unsigned long int)viewHeight)
+        {
+            moveViewport(top, target * bytesPerLine + x);
+        }
+        while (lineOffset < top)
+        {
+            lineOffset++;
+            pushDequeFront(fileBuffer, readFileContents((viewHeight + lineOffset - 1) * bytesPerLine, bytesPerLine));
+        }
+        y = bufferHeight - 1;
+        readAheadAt((viewHeight + lineOffset) * bytesPerLine, 1);
+    }
+}
+
+// Follows a change to the size of the contents. Every byte after the edit has moved, so the lines are counted again,
+// the lines shown are read again, and offsets found before the edit are dropped.
+// offset: the offset the cursor moves to.
+void followSize(unsigned long int offset)
+{
+    stopMatches();
+    size = document->size;
+    sizeViewport();
+    if (differences)
+    {
+        freeDiffIndex(differences);
+        differences = buildDiffIndex(workers, document, comparison);
+    }
+
+    // Keep the lines shown where they are, unless the cursor would then be off screen.
+    unsigned long int top = lineOffset; // The line shown at the top.
+    unsigned long int cursorLine = offset / bytesPerLine; // The line of the cursor.
+    if (cursorLine < top || cursorLine >= top + bufferHeight)
+    {
+        top = cursorLine;
+    }
+    moveViewport(top, offset);
+}
+
+// Inserts zero bytes before the cursor, or deletes bytes from the cursor on. The bytes after them move, so the size of
+// the file changes.
+// kind: editInsert or editDelete.
+// length: the number of bytes.
+void resizeAtCursor(enum EditKind kind, unsigned long int length)
+{
+    // Background jobs read the piece table, so they must stop before it changes.
+    cancelMatches();
+    cancelStrings();
+    stopOverview(overview);
+
+    // Bytes can be inserted at the end of the file, but the cursor can be further along the last line.
+    unsigned long int offset = (lineOffset + y) * bytesPerLine + x; // The byte under the cursor.
+    if (kind == editInsert && offset > size)
+    {
+        offset = size;
+    }
+    if (kind == editDelete)
+    {
+        if (offset >= size)
+        {
+            snprintf(statusMessage, sizeof(statusMessage), "NOTHING TO DELETE");
+            return;
+        }
+        length = length < size - offset ? length : size - offset;
+    }
+
+    unsigned char *bytes = (unsigned char *)calloc(length, 1); // The bytes inserted or deleted.
+    if (kind == editInsert)
+    {
+        recordUndoLogResize(history, kind, offset, bytes, length);
+        insertPieceTable(document, offset, bytes, length);
+    }
+    else
+    {
+        readPieceTable(document, offset, bytes, length);
+        recordUndoLogResize(history, kind, offset, bytes, length);
+        deletePieceTable(document, offset, length);
+    }
+    appendJournal(journal, kind, offset, bytes, length);
+    shiftSearchIndex(gramIndex, offset);
+    shiftOverview(overview, offset);
+    free(bytes);
+
+    followSize(offset);
+    snprintf(statusMessage, sizeof(statusMessage), "%s %lu BYTES AT 0x%08lX", kind == editInsert ? "INSERTED" : "DELETED", length, offset);
+}
+
+// Reads a number of bytes from the user, and inserts or deletes that many at the cursor.
+// kind: editInsert or editDelete.
+void promptResize(enum EditKind kind)
+{
+    char inputBuffer[SEARCH_INPUT_LENGTH];
+    promptInput(inputBuffer, SEARCH_INPUT_LENGTH);
+
+    // The count is hexadecimal, and may repeat the 0x of the prompt.
+    char *start = inputBuffer + strspn(inputBuffer, " "); // The first digit.
+    if (strncasecmp(start, "0x", 2) == 0)
+    {
+        start += 2;
+    }
+    char *end; // The character after the last digit.
+    unsigned long int length = strtoul(start, &end, 16);
+    if (end == start || end[strspn(end, " ")] != '\0' || length == 0)
+    {
+        snprintf(statusMessage, sizeof(statusMessage), "INVALID COUNT");
+        return;
+    }
+
+    resizeAtCursor(kind, length);
+}
+
+// Undoes the last edit or redoes the next one, and moves the cursor to it. The lines shown are patched in place if the
+// edit is on screen.
+// redo: 0 to undo, 1 to redo.
+void stepHistory(int redo)
+{
+    // Background jobs read the piece table, so they must stop before it changes.
+    cancelMatches();
+    cancelStrings();
+    stopOverview(overview);
+
+    undoRecord record; // The edit that was undone or redone.
+    if (!(redo ? redoPieceTable(history, document, &record) : undoPieceTable(history, document, &record)))
+    {
+        snprintf(statusMessage, sizeof(statusMessage), redo ? "NOTHING TO REDO" : "NOTHING TO UNDO");
+        return;
+    }
+
+    unsigned char *bytes = (redo ? history->newBytes : history->oldBytes) + record.start; // The bytes now in the file.
+    if (record.kind != editOverwrite)
+    {
+        // Undoing an insert deletes the bytes, and undoing a delete inserts them.
+        enum EditKind kind = redo ? record.kind : (record.kind == editInsert ? editDelete : editInsert); // The edit made now.
+        appendJournal(journal, kind, record.offset, bytes, record.length);
+        shiftSearchIndex(gramIndex, record.offset);
+        shiftOverview(overview, record.offset);
+        followSize(record.offset);
+        snprintf(statusMessage, sizeof(statusMessage), "%s %lu BYTES AT 0x%08lX", redo ? "REDID" : "UNDID", record.length, record.offset);
+        return;
+    }
+
+    appendJournal(journal, editOverwrite, record.offset, bytes, record.length);
+    touchSearchIndex(gramIndex, record.offset, record.length);
+    touchOverview(overview, record.offset, record.length);
+    if (differences)
+    {
+        updateDiffIndex(differences, document, comparison, record.offset, record.length);
+    }
+
+    unsigned long int first = lineOffset * bytesPerLine; // The first byte shown.
+    unsigned long int last = (lineOffset + bufferHeight) * bytesPerLine; // The byte after the last byte shown.
+    if (record.offset >= first && record.offset < last)
+    {
+        for (unsigned long int i = 0; i < record.length && record.offset + i < last; i++)
+        {
+            unsigned long int offset = record.offset + i - first; // Position of the byte on screen.
+            writeDequeByte(fileBuffer, offset / bytesPerLine, offset % bytesPerLine, bytes[i]);
+        }
+        y = (record.offset - first) / bytesPerLine;
+        x = (record.offset - first) % bytesPerLine;
+    }
+    else
+    {
+        jumpToOffset(record.offset);
+    }
+
+    snprintf(statusMessage, sizeof(statusMessage), "%s %lu BYTES AT 0x%08lX", redo ? "REDID" : "UNDID", record.length, record.offset);
+}
+
+// Moves the cursor to the next or previous range of bytes that differ from the other file.
+// direction: 1 for the next range, -1 for the previous one.
+void stepDifference(int direction)
+{
+    diffRange range; // The range moved to.
+    unsigned long int number; // The number of the range.
+    if (!stepDiffIndex(differences, (lineOffset + y) * bytesPerLine + x, direction, &range, &number))
+    {
+        snprintf(statusMessage, sizeof(statusMessage), "NO MORE DIFFERENCES");
+        return;
+    }
+
+    // Bytes past the end of the file can not be moved to.
+    jumpToOffset(range.start < size ? range.start : (size > 0 ? size - 1 : 0));
+    snprintf(statusMessage, sizeof(statusMessage), "DIFFERENCE %lu OF %lu: 0x%08lX, %lu BYTES", number, differences->differences.count, range.start, range.end - range.start);
+}
+
+// Reads an offset from the user and moves the cursor to it.
+void promptGoToOffset()
+{
+    char inputBuffer[SEARCH_INPUT_LENGTH];
+    promptInput(inputBuffer, SEARCH_INPUT_LENGTH);
+
+    // The offset is hexadecimal, and may repeat the 0x of the prompt.
+    char *start = inputBuffer + strspn(inputBuffer, " "); // The first digit.
+    if (strncasecmp(start, "0x", 2) == 0)
+    {
+        start += 2;
+    }
+    char *end; // The character after the last digit.
+    unsigned long int offset = strtoul(start, &end, 16);
+    if (end == start || end[strspn(end, " ")] != '\0')
+    {
+        snprintf(statusMessage, sizeof(statusMessage), "INVALID OFFSET");
+        return;
+    }
+    if (offset >= size && offset > 0)
+    {
+        snprintf(statusMessage, sizeof(statusMessage), "OFFSET PAST END OF FILE");
+        return;
+    }
+
+    jumpToOffset(offset);
+    snprintf(statusMessage, sizeof(statusMessage), "LOCATION: 0x%08lX", offset);
+}
+
+// Writes the changes in the piece table to the real file. The changed ranges are written in place, unless bytes have
+// been inserted or deleted, in which case the file is replaced.
+// fileName: the location of the real file.
+void writeChangesToFile(char *fileName)
+{
+    saveStats stats; // Statistics reported to the user.
+
+    // Background jobs read the piece table, so they must stop before it changes.
+    cancelMatches();
+    cancelStrings();
+    stopOverview(overview);
+
+    if (!document->shifted)
+    {
+        if (saveFileInPlace(document, &stats) == -1)
+        {
+            snprintf(statusMessage, sizeof(statusMessage), "Could not write to file");
+            return;
+        }
+    }
+    else
+    {
+        if (saveFileAtomic(document, fileName, &stats) == -1)
+        {
+            snprintf(statusMessage, sizeof(statusMessage), "Could not write to file");
+            return;
+        }
+
+        // The file has been replaced, so the new one has to be loaded. The index reads the old one until then.
+        stopSearchIndex(gramIndex);
+        loadFile(fileName);
+    }
+
+    // The edits are in the file now, so the journal no longer needs them, and the blocks they touched can be indexed.
+    resetJournal(journal, file);
+    refreshSearchIndex(gramIndex, file);
+
+    snprintf(statusMessage, sizeof(statusMessage), "Wrote %lu bytes in %lu ranges", stats.bytesWritten, stats.rangesWritten);
+}
+
+// Shows the overview and gives it focus, with the row of the lines shown selected. Its blocks are counted the first time
+// it is shown. If it already has focus, it is hidden instead.
+void toggleOverview()
+{
+    if (overviewRow != -1)
+    {
+        overviewShown = 0;
+        overviewRow = -1;
+        resizeViewport();
+        return;
+    }
+
+    if (overview == NULL)
+    {
+        overview = buildOverview(document, workers);
+    }
+    if (!overviewShown)
+    {
+        // The lines may have to narrow to make room for it.
+        overviewShown = 1;
+        resizeViewport();
+    }
+    overviewRow = findOverviewRow(lineOffset * bytesPerLine);
+}
+
+// Handles a key while the overview has focus. Up, Down, Page Up, Page Down, Home and End select a row, Enter moves the
+// lines to the start of it, and Escape gives the focus back to the lines.
+// c: the key, as returned by readKey().
+// count: the number of times the key was pressed in a row.
+//
+// Returns: 1 if the key was handled, 0 if it is handled as usual.
+int handleOverviewKey(int c, int count)
+{
+    unsigned long int from; // The first byte of the row selected.
+    unsigned long int to; // One past the last byte of the row selected.
+
+    switch (c)
+    {
+        case keyUp:
+            overviewRow = overviewRow > count ? overviewRow - count : 0;
+            return 1;
+        case keyDown:
+            overviewRow = overviewRow + count < viewHeight - 1 ? overviewRow + count : viewHeight - 1;
+            return 1;
+        case keyPageUp:
+        case keyHome:
+            overviewRow = 0;
+            return 1;
+        case keyPageDown:
+        case keyEnd:
+            overviewRow = viewHeight - 1;
+            return 1;
+        case '\r':
+        case '\n':
+            // Bytes past the end of the file can not be moved to.
+            findOverviewSegment(overviewRow, &from, &to);
+            overviewRow = -1;
+            jumpToOffset(from < size ? from : (size > 0 ? size - 1 : 0));
+            snprintf(statusMessage, sizeof(statusMessage), "LOCATION: 0x%08lX", lineOffset * bytesPerLine + x);
+            return 1;
+        case keyEscape:
+            overviewRow = -1;
+            return 1;
+        default:
+            // The other keys that move the cursor do nothing, rather than moving the lines behind the overview.
+            return c > keyEscape;
+    }
+}
+
+// Lists the strings in the place of the lines, with the string at the cursor, or the first after it, selected. They are
+// found in the background the first time they are listed, and again after an edit. If they are listed already, the
+// lines are shown again instead.
+void toggleStrings()
+{
+    if (stringsShown)
+    {
+        stringsShown = 0;
+        return;
+    }
+
+    if (printables == NULL || stringsStale)
+    {
+        stopPrintableList(printables);
+        printables = startPrintableList(workers, document, PRINTABLE_MINIMUM);
+        stringsStale = 0;
+    }
+    stringsShown = 1;
+    stringAnchor = (lineOffset + y) * bytesPerLine + x;
+}
+
+// Handles a key while the strings are listed. Up, Down, Page Up, Page Down, Home and End select a string, Enter moves
+// the cursor to it, and T or Escape shows the lines again. Other keys are ignored, as the lines they would change are
+// hidden, except X, which quits as usual.
+// c: the key, as returned by readKey().
+// count: the number of times the key was pressed in a row.
+//
+// Returns: 1 if the key was handled, 0 if it is handled as usual.
+int handleStringsKey(int c, int count)
+{
+    unsigned long int found; // The number of strings found so far.
+    unsigned long int scanned; // The number of bytes scanned so far.
+    unsigned long int pageLines = (unsigned long int)viewHeight * count; // The number of strings moved by a page.
+    printableRun run; // The string selected.
+    readPrintableList(printables, &found, &scanned);
+    unsigned long int last = found ? found - 1 : 0; // The number of the last string found so far.
+    if (c >= keyUp && c <= keyEnd)
+    {
+        stringAnchor = -1;
+    }
+
+    switch (c)
+    {
+        case keyUp:
+            stringSelected = stringSelected > (unsigned long int)count ? stringSelected - count : 0;
+            break;
+        case keyDown:
+            stringSelected = stringSelected + count < last ? stringSelected + count : last;
+            break;
+        case keyPageUp:
+            stringSelected = stringSelected > pageLines ? stringSelected - pageLines : 0;
+            break;
+        case keyPageDown:
+            stringSelected = stringSelected + pageLines < last ? stringSelected + pageLines : last;
+            break;
+        case keyHome:
+            stringSelected = 0;
+            break;
+        case keyEnd:
+            stringSelected = last;
+            break;
+        case '\r':
+        case '\n':
+            if (!getPrintableRun(printables, stringSelected, &run))
             {
-                if (editorState = editing)
+                return 1;
+            }
+
+            // Edits since the strings were found may have moved the end of the file before the string.
+            stringsShown = 0;
+            jumpToOffset(run.offset < size ? run.offset : (size > 0 ? size - 1 : 0));
+            snprintf(statusMessage, sizeof(statusMessage), "STRING %lu: 0x%08lX", stringSelected + 1, run.offset);
+            return 1;
+        case keyEscape:
+        case 84:
+        case 116:
+            stringsShown = 0;
+            return 1;
+        default:
+            return c != 88 && c != 120;
+    }
+
+    // Keep the string selected on screen.
+    if (stringSelected < stringTop)
+    {
+        stringTop = stringSelected;
+    }
+    else if (stringSelected >= stringTop + viewHeight)
+    {
+        stringTop = stringSelected - viewHeight + 1;
+    }
+    return 1;
+}
+
+// Handles a key pressed by the user.
+// c: the key, as returned by readKey().
+// count: the number of times the key was pressed in a row. Only used by navigational keys, Insert and Delete, others are
+//        handled once.
+// fileName: the location of the file being editted.
+//
+// Returns: 0 if the editor should quit, otherwise 1.
+int handleKey(int c, int count, char *fileName)
+{
+    // Checks if the editor has been set to browsing mode and the changes have not been written.
+    if (editorState == browsing)
+    {
+        // Writes the changes and marks the written flag.
+        commitEdit();
+    }
+
+    statusMessage[0] = '\0';
+
+    // While the strings are listed, or the overview has focus, the keys that move the cursor move along them instead.
+    if (stringsShown && handleStringsKey(c, count))
+    {
+        return 1;
+    }
+    if (overviewRow != -1 && handleOverviewKey(c, count))
+    {
+        return 1;
+    }
+
+    if (c == 88 || c == 120) // X (Quit)
+    {
+        // Changes that have not been written are discarded on purpose, so they are not offered for recovery.
+        closeJournal(journal, 1);
+        journal = NULL;
+        clear();
+        return 0;
+    }
+    else if (c == 87 || c == 119) // W (Write)
+    {
+        // Write the byte being editted first.
+        if (editorState == editing)
+        {
+            written = 0;
+            editorState = browsing;
+        }
+        commitEdit();
+
+        writeChangesToFile(fileName);
+        return 1;
+    }
+    else if (c == 83 || c == 115) // S (Search)
+    {
+        // An empty search finds the next match of the last pattern.
+        int empty; // Whether the input was empty.
+        searchPattern *pattern = promptSearchPattern(&empty);
+        if (pattern == NULL && (!empty || lastPattern == NULL))
+        {
+            return 1;
+        }
+
+        long unsigned int from = 0; // The first offset a match is looked for at.
+        if (pattern == NULL)
+        {
+            from = nextSearchStart(document, lastPattern, lastMatch);
+        }
+        else
+        {
+            // The last pattern may still be used by a background search.
+            if (matches == NULL || matches->pattern != lastPattern)
+            {
+                freeSearchPattern(lastPattern);
+            }
+            lastPattern = pattern;
+        }
+
+        long unsigned int loc = searchAlgorithm(lastPattern, from); // The location of the search buffer
+
+        if (!foundFlag)
+        {
+            snprintf(statusMessage, sizeof(statusMessage), "LOCATION: NOT FOUND");
+            return 1;
+        }
+
+        // Reset found flag for future use, and move the cursor to the match.
+        foundFlag = 0;
+        lastMatch = loc;
+        jumpToOffset(loc);
+        snprintf(statusMessage, sizeof(statusMessage), "LOCATION: 0x%08lX", loc);
+    }
+    else if (c == 77 || c == 109) // M (Match all)
+    {
+        int empty; // Whether the input was empty.
+        searchPattern *pattern = promptSearchPattern(&empty);
+        if (pattern == NULL)
+        {
+            return 1;
+        }
+
+        // Replace any previous search and start finding every match in the background.
+        stopMatches();
+        matches = startSearchAll(workers, document, pattern, gramIndex);
+    }
+    else if ((c == 78 || c == 110) && matches) // N (Previous match), n (Next match)
+    {
+        commitEdit();
+
+        unsigned long int loc; // The location of the match.
+        unsigned long int number; // The number of the match.
+        if (!stepSearchAll(matches, (lineOffset + y) * bytesPerLine + x, c == 110 ? 1 : -1, &loc, &number))
+        {
+            snprintf(statusMessage, sizeof(statusMessage), "NO MORE MATCHES");
+            return 1;
+        }
+
+        jumpToOffset(loc);
+        snprintf(statusMessage, sizeof(statusMessage), "MATCH %lu: 0x%08lX", number, loc);
+    }
+    else if ((c == 74 || c == 106 || c == 75 || c == 107) && differences) // J (Next difference), K (Previous difference)
+    {
+        commitEdit();
+        stepDifference(c == 74 || c == 106 ? 1 : -1);
+    }
+    else if (c == 85 || c == 117 || c == 82 || c == 114) // U (Undo), R (Redo)
+    {
+        // Write the byte being editted first, so that it is the edit undone.
+        if (editorState == editing)
+        {
+            written = 0;
+            editorState = browsing;
+        }
+        commitEdit();
+
+        stepHistory(c == 82 || c == 114);
+    }
+    else if (c == 79 || c == 111) // O (Overview)
+    {
+        toggleOverview();
+    }
+    else if (c == 84 || c == 116) // T (Strings)
+    {
+        commitEdit();
+        toggleStrings();
+    }
+    else if (c == 71 || c == 103) // G (Go to offset)
+    {
+        commitEdit();
+        promptGoToOffset();
+    }
+    else if (c == 73 || c == 105 || c == 89 || c == 121) // I (Insert bytes), Y (Delete bytes)
+    {
+        // Write the byte being editted first, as the bytes after the cursor move.
+        if (editorState == editing)
+        {
+            written = 0;
+            editorState = browsing;
+        }
+        commitEdit();
+
+        promptResize(c == 73 || c == 105 ? editInsert : editDelete);
+    }
+    else if (c >= keyEscape) // Escape and navigational keys
+    {
+        // Reset editor back to browsing state, writing the byte before the cursor moves away from it.
+        if (editorState == editing)
+        {
+            written = 0;
+            editorState = browsing;
+        }
+        commitEdit();
+
+        unsigned long int cursorLine = lineOffset + y; // The line of the cursor.
+        unsigned long int pageLines; // The number of lines moved by page up or page down.
+        switch (c)
+        {
+            case keyUp:
+                moveCursorLines(-count);
+                break;
+            case keyDown:
+                moveCursorLines(count);
+                break;
+
+            case keyRight:
+                // Move right, stopping at the right of the screen.
+                x = x + count < bytesPerLine - 1 ? x + count : bytesPerLine - 1;
+                break;
+            case keyLeft:
+                // Move left, stopping at the left of the screen.
+                x = x > count ? x - count : 0;
+                break;
+
+            case keyPageUp:
+                // Move the editor and the cursor up a screen for each press, stopping at the top of the file.
+                pageLines = (unsigned long int)viewHeight * count;
+                cursorLine = cursorLine > pageLines ? cursorLine - pageLines : 0;
+                moveViewport(lineOffset > pageLines ? lineOffset - pageLines : 0, cursorLine * bytesPerLine + x);
+                readAheadAt(lineOffset * bytesPerLine, -1);
+                break;
+            case keyPageDown:
+                // Move the editor and the cursor down a screen for each press, stopping at the bottom of the file.
+                pageLines = (unsigned long int)viewHeight * count;
+                cursorLine = cursorLine + pageLines < lineSize ? cursorLine + pageLines : lineSize;
+                moveViewport(lineOffset + pageLines, cursorLine * bytesPerLine + x);
+                readAheadAt((lineOffset + viewHeight) * bytesPerLine, 1);
+                break;
+            case keyHome:
+                // Move to the first byte of the file.
+                jumpToOffset(0);
+                break;
+            case keyEnd:
+                // Move to the last byte of the file.
+                jumpToOffset(size > 0 ? size - 1 : 0);
+                break;
+
+            case keyInsert:
+                // Insert a zero byte for each press before the cursor, to be typed over.
+                resizeAtCursor(editInsert, count);
+                break;
+            case keyDelete:
+                // Delete the byte under the cursor for each press.
+                resizeAtCursor(editDelete, count);
+                break;
+
+            default:
+                break;
+        }
+    }
+    else
+    {
+        // User is writing to a byte.
+        int val = convertHexChar(c); // User input
+
+        // nvm user isn't
+        if (val == -1)
+        {
+            if (editorState == editing)
+            {
+                // Flags the byte to be written since the editor is editing.
+                editorState = browsing;
+                written = 0;
+            }
+            return 1;
+        }
+
+        switch (editorState)
+        {
+            case browsing:
+                // If the editor is in a browsing state, write the first digit of the byte to the fileBuffer.
+                writeDequeByte(fileBuffer, y, x, val);
+                editorState = editing;
+                written = 0;
+                break;
+
+            case editing:
+                // If the editor is in a browsing state, write the byte to the fileBuffer, where the first digit is val and the second digit is the byte already present.
+                writeDequeByte(fileBuffer, y, x, readDequeByte(fileBuffer, y, x) * 16 + val);
+                editorState = browsing;
+                written = 0;
+                break;
+
+            default:
+                // I don't know a case where this would ever get hit, but just to be safe.
+                fprintf(stderr, "Invalid enum value in editor state.\n");
+                exit(1);
+                break;
+        }
+    }
+
+    return 1;
+}
+
+// Applies a file of patches to a file without opening the editor, and reports where the time went.
+// patchName: the location of the patch file.
+// fileName: the location of the file to patch.
+// Throws if either file cannot be read, a patch is invalid or past the end of the file, or the file cannot be written.
+void applyPatchFile(char *patchName, char *fileName)
+{
+    struct timespec start; // When the patches started being read.
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    unsigned long int errorLine; // The line of an invalid patch.
+    patchList *patches = loadPatchList(patchName, &errorLine);
+    if (!patches)
+    {
+        if (errorLine > 0)
+        {
+            fprintf(stderr, "Invalid patch on line %lu of %s\nPatches are written as {Offset}:{Bytes} in hexadecimal\n", errorLine, patchName);
+        }
+        else
+        {
+            fprintf(stderr, "Could not load patch file %s\n", patchName);
+        }
+        exit(1);
+    }
+    long int parseTime = millisecondsSince(&start); // Milliseconds spent reading the patches.
+
+    unsigned long int count = patches->count; // The number of patches before merging.
+    unsigned long int runs = mergePatchList(patches);
+    long int mergeTime = millisecondsSince(&start) - parseTime; // Milliseconds spent merging the patches.
+
+    fileMap *target = openFileMap(fileName);
+    if (!target || !target->writable)
+    {
+        fprintf(stderr, "Could not open %s for writing\n", fileName);
+        exit(1);
+    }
+    pieceTable *table = buildPieceTable(target);
+    if (applyPatchList(patches, table) == -1)
+    {
+        fprintf(stderr, "A patch is past the end of %s, which is %lu bytes long\nNothing was written\n", fileName, target->size);
+        exit(1);
+    }
+
+    saveStats stats;
+    if (saveFileInPlace(table, &stats) == -1)
+    {
+        fprintf(stderr, "Could not write to %s\n", fileName);
+        exit(1);
+    }
+    long int writeTime = millisecondsSince(&start) - parseTime - mergeTime; // Milliseconds spent writing the file.
+
+    printf("Applied %lu patches as %lu runs: %lu bytes written in %lu ranges with %lu calls\n",
+           count, runs, stats.bytesWritten, stats.rangesWritten, stats.writeCalls);
+    printf("Read %ld ms, merge %ld ms, write %ld ms, total %ld ms\n", parseTime, mergeTime, writeTime, millisecondsSince(&start));
+
+    freePatchList(patches);
+    freePieceTable(table);
+    closeFileMap(target);
+}
+
+// Writes a hex dump of a file, or a segment of it, to stdout without opening the editor.
+// fileName: the location of the file.
+// range: the segment as {Start}:{Length} in hexadecimal, where either may be left out, or NULL for the whole file.
+// Throws if the file cannot be read, the range is invalid or stdout cannot be written to.
+void dumpFile(char *fileName, char *range)
+{
+    unsigned long int start = 0; // The offset of the first byte dumped.
+    unsigned long int length = (unsigned long int)-1; // The number of bytes dumped, cut short at the end of the file.
+
+    if (range)
+    {
+        char *colon = strchr(range, ':'); // Separates the start from the length.
+        char *end; // The first character that was not part of a number.
+        if (!colon)
+        {
+            fprintf(stderr, "Invalid range %s\nUsage: ./hexeditor --dump {File} [{Start}:{Length}]\n", range);
+            exit(1);
+        }
+        if (colon > range)
+        {
+            start = strtoul(range, &end, 16);
+            if (end != colon)
+            {
+                fprintf(stderr, "Invalid start offset in %s\n", range);
+                exit(1);
+            }
+        }
+        if (colon[1] != '\0')
+        {
+            length = strtoul(colon + 1, &end, 16);
+            if (*end != '\0')
+            {
+                fprintf(stderr, "Invalid length in %s\n", range);
+                exit(1);
+            }
+        }
+    }
+
+    fileMap *source = openFileMap(fileName);
+    if (!source)
+    {
+        fprintf(stderr, "Could not load file %s\n", fileName);
+        exit(1);
+    }
+
+    if (dumpFileMap(source, start, length, STDOUT_FILENO) == -1)
+    {
+        fprintf(stderr, "Could not write the dump\n");
+        exit(1);
+    }
+
+    closeFileMap(source);
+}
+
+// Turns a hex listing back into a file without opening the editor.
+// listingName: the location of the listing, or - for stdin.
+// fileName: the location of the file that is created, or - for stdout.
+// Throws if either file cannot be opened or written, or the listing is not valid.
+void importHexFile(char *listingName, char *fileName)
+{
+    int in = strcmp(listingName, "-") == 0 ? STDIN_FILENO : open(listingName, O_RDONLY);
+    if (in == -1)
+    {
+        fprintf(stderr, "Could not load listing %s\n", listingName);
+        exit(1);
+    }
+    int out = strcmp(fileName, "-") == 0 ? STDOUT_FILENO : open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out == -1)
+    {
+        fprintf(stderr, "Could not create %s\n", fileName);
+        exit(1);
+    }
+
+    unsigned long int errorLine; // The line that is not valid.
+    if (importHexListing(in, out, &errorLine) == -1)
+    {
+        if (errorLine > 0)
+        {
+            fprintf(stderr, "Invalid hex on line %lu of %s\n", errorLine, listingName);
+        }
+        else
+        {
+            fprintf(stderr, "Could not read %s or write %s\n", listingName, fileName);
+        }
+        exit(1);
+    }
+
+    if (out != STDOUT_FILENO && close(out) == -1)
+    {
+        fprintf(stderr, "Could not write %s\n", fileName);
+        exit(1);
+    }
+}
+
+// Writes the printable strings of a file to stdout with their offsets, without opening the editor.
+// fileName: the location of the file.
+// minimum: the fewest characters a string has, in decimal, or NULL for PRINTABLE_MINIMUM.
+// Throws if the file cannot be read, the minimum is invalid or stdout cannot be written to.
+void printStrings(char *fileName, char *minimum)
+{
+    int least = PRINTABLE_MINIMUM; // The fewest characters a string has.
+    if (minimum)
+    {
+        char *end; // The first character that was not part of the number.
+        long int value = strtol(minimum, &end, 10);
+        if (end == minimum || *end != '\0' || value < 1 || value > 65536)
+        {
+            fprintf(stderr, "Invalid minimum %s\nUsage: ./hexeditor --strings {File} [{Minimum}]\n", minimum);
+            exit(1);
+        }
+        least = value;
+    }
+
+    fileMap *source = openFileMap(fileName);
+    if (!source)
+    {
+        fprintf(stderr, "Could not load file %s\n", fileName);
+        exit(1);
+    }
+
+    // The file is scanned through a piece table with no edits, on every thread.
+    pieceTable *table = buildPieceTable(source);
+    threadPool *pool = buildThreadPool(0);
+    if (writePrintables(pool, table, least, STDOUT_FILENO) == -1)
+    {
+        fprintf(stderr, "Could not write the strings\n");
+        exit(1);
+    }
+
+    freeThreadPool(pool);
+    freePieceTable(table);
+    closeFileMap(source);
+}
+
+int main(int argc, char **argv)
+{
+    // Apply a file of patches without opening the editor.
+    if (argc >= 2 && strcmp(argv[1], "--apply") == 0)
+    {
+        if (argc != 4)
+        {
+            fprintf(stderr, "Usage: ./hexeditor --apply {Patches} {File}\n");
+            exit(1);
+        }
+        applyPatchFile(argv[2], argv[3]);
+        return 0;
+    }
+
+    // Write a hex dump without opening the editor.
+    if (argc >= 2 && strcmp(argv[1], "--dump") == 0)
+    {
+        if (argc != 3 && argc != 4)
+        {
+            fprintf(stderr, "Usage: ./hexeditor --dump {File} [{Start}:{Length}]\n");
+            exit(1);
+        }
+        dumpFile(argv[2], argc == 4 ? argv[3] : NULL);
+        return 0;
+    }
+
+    // Turn a hex listing back into a file without opening the editor.
+    if (argc >= 2 && strcmp(argv[1], "--from-hex") == 0)
+    {
+        if (argc != 4)
+        {
+            fprintf(stderr, "Usage: ./hexeditor --from-hex {Listing} {File}\n");
+            exit(1);
+        }
+        importHexFile(argv[2], argv[3]);
+        return 0;
+    }
+
+    // Write the printable strings without opening the editor.
+    if (argc >= 2 && strcmp(argv[1], "--strings") == 0)
+    {
+        if (argc != 3 && argc != 4)
+        {
+            fprintf(stderr, "Usage: ./hexeditor --strings {File} [{Minimum}]\n");
+            exit(1);
+        }
+        printStrings(argv[2], argc == 4 ? argv[3] : NULL);
+        return 0;
+    }
+
+    // Compare the file with another file, showing the bytes of both.
+    char *fileName = argv[1]; // The location of the file being editted.
+    int createIndex = 0; // Whether the index of the file is created if there is none.
+    if (argc >= 2 && strcmp(argv[1], "--index") == 0)
+    {
+        if (argc != 3)
+        {
+            fprintf(stderr, "Usage: ./hexeditor --index {File}\n");
+            exit(1);
+        }
+        fileName = argv[2];
+        createIndex = 1;
+    }
+    else if (argc >= 2 && strcmp(argv[1], "--diff") == 0)
+    {
+        if (argc != 4)
+        {
+            fprintf(stderr, "Usage: ./hexeditor --diff {File} {Other}\n");
+            exit(1);
+        }
+        fileName = argv[2];
+        comparison = openFileMap(argv[3]);
+        if (!comparison)
+        {
+            fprintf(stderr, "Could not load file %s\n", argv[3]);
+            exit(1);
+        }
+    }
+
+    // Initialise console utilities for screen resizing
+    initialiseConsoleutils();
+
+    // Load file which will be editted. Changes are kept in the piece table until they are written.
+    loadFile(fileName);
+    workers = buildThreadPool(0);
+    history = buildUndoLog();
+
+    // Use the index of the file if there is one, finishing it in the background.
+    gramIndex = openSearchIndex(fileName, file, workers, createIndex);
+    if (createIndex && gramIndex == NULL)
+    {
+        snprintf(statusMessage, sizeof(statusMessage), "Could not create %s.hxi, searches are not indexed", fileName);
+    }
+    recoverJournal(fileName);
+
+    // Index the differences once any recovered edits are in place.
+    if (comparison)
+    {
+        struct timespec start; // When the comparison started.
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        differences = buildDiffIndex(workers, document, comparison);
+        snprintf(statusMessage, sizeof(statusMessage), "%lu DIFFERENCES, %lu BYTES, FOUND IN %ld MS", differences->differences.count,
+                 countDiffIndex(differences), millisecondsSince(&start));
+    }
+    frame = buildFrame();
+    screen = buildScreen();
+
+    // Loads the first set of lines to the fileBuffer
+    fileBuffer = buildDeque(viewHeight, bytesPerLine);
+    readFileLines(0, viewHeight);
+
+    int running = 1; // Whether the editor is still running.
+    toggleEOFRequirement();
+    while (running)
+    {
+        // Checks if the editor has been set to browsing mode and the changes have not been written.
+        if (editorState == browsing)
+        {
+            // Writes the changes and marks the written flag.
+            commitEdit();
+        }
+
+        // Resize the editor if the terminal has been resized.
+        if (updateWindowSize())
+        {
+            resizeViewport();
+        }
+
+        // Count the blocks of the overview that the last edits changed.
+        refreshOverview(overview, document);
+
+        drawScreen();
+        struct timespec frameTime; // When the frame was drawn.
+        clock_gettime(CLOCK_MONOTONIC, &frameTime);
+
+        // Make the edits so far safe before waiting, so that a burst of edits costs one sync.
+        syncJournal(journal);
+
+        // Wait for a key or a resize. The screen is redrawn every so often if a background search, the index, the
+        // overview or the strings are running, to keep their progress live.
+        int background = (matches && matches->running) || (gramIndex && gramIndex->running) ||
+                         (overview && overview->running) || (printables && printables->running); // Whether a background job is running.
+        if (!waitForEvents(background ? 100 : -1))
+        {
+            continue;
+        }
+
+        // Handle every key that is waiting, and any that arrive before the next frame is due, so that keys arriving
+        // faster than frames are drawn do not queue up. A run of the same navigational key is handled as one move, and a
+        // run of Insert or Delete as one edit.
+        do
+        {
+            int c = readKey(); // The key pressed.
+            int count = 1; // The number of times it was pressed in a row.
+            if ((c >= keyUp && c <= keyPageDown) || c == keyInsert || c == keyDelete)
+            {
+                while (peekKey() == c)
                 {
-                    // Flags the byte to be written since the editor is editing.
-                    editorState = browsing;
-                    written = 0;
+                    readKey();
+                    count++;
                 }
-                continue;
             }
 
-            switch (editorState)
+            // The input has closed.
+            if (c == EOF)
             {
-                case browsing:
-                    // If the editor is in a browsing state, write the first digit of the byte to the fileBuffer.
-                    writeDequeByte(fileBuffer, y, x, val);
-                    editorState = editing;
-                    written = 0;
-                    break;
-
-                case editing:
-                    // If the editor is in a browsing state, write the byte to the fileBuffer, where the first digit is val and the second digit is the byte already present.
-                    writeDequeByte(fileBuffer, y, x, readDequeByte(fileBuffer, y, x) * 16 + val);
-                    editorState = browsing;
-                    written = 0;
-                    break;
-
-                default:
-                    // I don't know a case where this would ever get hit, but just to be safe.
-                    fprintf(stderr, "Invalid enum value in editor state.\n");
-                    exit(1);
-                    break;
+                clear();
+                running = 0;
+                break;
             }
-        }
+            running = handleKey(c, count, fileName);
+        } while (running && waitForInput(millisecondsUntil(&frameTime, FRAME_INTERVAL)));
     }
 
-    // Removes temporary file and restores console.
-    char removeCommand[253];
-    fclose(file);
-    snprintf(removeCommand, 253, "rm %s", tempFile); // Creates command for removing temporary file i.e.  rm {tempFile}
-    system(removeCommand); // Executes the command
+    // Discards unwritten changes and closes the file.
+    stopMatches();
+    stopPrintableList(printables);
+    closeSearchIndex(gramIndex);
+    freeOverview(overview);
+    freeThreadPool(workers);
+    freeUndoLog(history);
+    closeJournal(journal, 0);
+    freeFrame(frame);
+    freeScreen(screen);
+    freePieceTable(document);
+    freeBlockCache(cache);
+    closeFileMap(file);
+    freeDiffIndex(differences);
+    closeFileMap(comparison);
 
     // Re-enable cursor blink and restores console.
     printf("\e[?25h");
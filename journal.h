@@ -0,0 +1,426 @@
+//
+// hexeditor.c library file
+// journal.c
+//
+// Provides a journal of the edits that have not been written to the file yet, so that they can be recovered after a
+// crash or a dropped connection.
+//
+// Demonstration:
+//
+//   FILE.journal:  | header | record | record | record | ...
+//
+//   Header:        magic "HXJRNL01", size and modification time of the file the edits were made to.
+//   Record:        offset (8 bytes), length (4 bytes), the new bytes, CRC-32 of everything before it (4 bytes).
+//
+// The top two bits of the length hold the kind of edit (see EditKind in piecetable.h): bytes overwritten, bytes
+// inserted, or bytes deleted, which has no bytes after the length.
+//
+// Records are only ever appended. They are collected in memory and written and synced together by syncJournal(), which
+// the editor calls once before it waits for input, so a burst of edits costs one fdatasync(). A crash can leave the
+// last record half written; its checksum does not match, so replaying stops there and every record before it is kept.
+//
+// Once the edits have been written to the file, the journal is emptied. It is removed when the editor quits normally.
+//
+
+// Avoid redefinition errors during compilation
+#ifndef FILE_JOURNAL_SEEN
+#define FILE_JOURNAL_SEEN
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "filemap.h"
+#include "piecetable.h"
+
+#define JOURNAL_MAGIC "HXJRNL01" // The first bytes of every journal.
+#define JOURNAL_INITIAL_PENDING 4096 // Bytes allocated for records that have not been written yet.
+#define JOURNAL_KIND_SHIFT 30 // Position of the kind of edit in the length of a record.
+#define JOURNAL_LENGTH_MASK 0x3FFFFFFF // The bits of the length of a record that hold the length.
+
+typedef struct
+{
+    char magic[8]; // JOURNAL_MAGIC.
+    uint64_t size; // Size of the file the edits were made to.
+    int64_t modifiedSeconds; // Modification time of the file, in seconds.
+    int64_t modifiedNanoseconds; // Nanoseconds of the modification time.
+} journalHeader;
+
+typedef struct
+{
+    int fd; // The journal file.
+    char name[PATH_MAX]; // The location of the journal file.
+    unsigned char *pending; // Records that have not been written yet.
+    unsigned long int pendingLength; // The number of bytes of pending records.
+    unsigned long int pendingCapacity; // Allocated size of pending.
+} editJournal;
+
+typedef void (*journalEdit)(enum EditKind kind, unsigned long int offset, unsigned char *bytes, unsigned long int length);
+
+static uint32_t journalCrcTable[256]; // The CRC-32 of every byte value, filled in on first use.
+
+// Calculates the CRC-32 of a block of bytes. Only available in scope of journal.c
+// crc: the CRC of the bytes before the block, or 0 to start.
+// bytes: the block.
+// length: the number of bytes in the block.
+//
+// Returns: the CRC of everything up to the end of the block.
+static uint32_t crcJournal(uint32_t crc, const void *bytes, unsigned long int length)
+{
+    if (journalCrcTable[1] == 0)
+    {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t value = i; // The CRC of the byte, built a bit at a time.
+            for (int bit = 0; bit < 8; bit++)
+            {
+                value = value & 1 ? 0xEDB88320 ^ (value >> 1) : value >> 1;
+            }
+            journalCrcTable[i] = value;
+        }
+    }
+
+    crc = ~crc;
+    for (unsigned long int i = 0; i < length; i++)
+    {
+        crc = journalCrcTable[(crc ^ ((const unsigned char *)bytes)[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// Fills in the header for the current state of a file. Only available in scope of journal.c
+// header: the header.
+// original: the file the edits are made to.
+static void describeJournalFile(journalHeader *header, fileMap *original)
+{
+    struct stat info;
+    memset(header, 0, sizeof(journalHeader));
+    memcpy(header->magic, JOURNAL_MAGIC, sizeof(header->magic));
+    header->size = original->size;
+    if (fstat(original->fd, &info) == 0)
+    {
+        header->modifiedSeconds = info.st_mtim.tv_sec;
+        header->modifiedNanoseconds = info.st_mtim.tv_nsec;
+    }
+}
+
+// Reads a whole journal file. Only available in scope of journal.c
+// name: the location of the journal file.
+// length: set to the size of the journal.
+//
+// Returns: the contents, which must be freed, or NULL if there is no journal with a valid header.
+static unsigned char *loadJournal(char *name, unsigned long int *length)
+{
+    int fd = open(name, O_RDONLY);
+    if (fd == -1)
+    {
+        return NULL;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) == -1 || (unsigned long int)info.st_size < sizeof(journalHeader))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    unsigned char *contents = (unsigned char *)malloc(info.st_size);
+    unsigned long int done = 0; // Bytes read so far.
+    while (done < (unsigned long int)info.st_size)
+    {
+        ssize_t count = read(fd, contents + done, info.st_size - done);
+        if (count <= 0)
+        {
+            break;
+        }
+        done += count;
+    }
+    close(fd);
+
+    if (done < sizeof(journalHeader) || memcmp(contents, JOURNAL_MAGIC, 8) != 0)
+    {
+        free(contents);
+        return NULL;
+    }
+
+    *length = done;
+    return contents;
+}
+
+// Walks the valid records of a journal. Only available in scope of journal.c
+// contents: the contents of the journal.
+// length: the size of the journal.
+// edit: called with each record, may be NULL.
+// end: set to the end of the last valid record.
+//
+// Returns: the number of valid records.
+static unsigned long int walkJournal(unsigned char *contents, unsigned long int length, journalEdit edit, unsigned long int *end)
+{
+    unsigned long int position = sizeof(journalHeader); // The start of the record being read.
+    unsigned long int records = 0; // Valid records found.
+
+    while (position + 16 <= length)
+    {
+        uint64_t offset; // Offset of the edit.
+        uint32_t count; // Length and kind of the edit.
+        uint32_t crc; // Stored checksum of the record.
+        memcpy(&offset, contents + position, 8);
+        memcpy(&count, contents + position + 8, 4);
+        enum EditKind kind = (enum EditKind)(count >> JOURNAL_KIND_SHIFT); // Kind of the edit.
+        count &= JOURNAL_LENGTH_MASK;
+        uint32_t stored = kind == editDelete ? 0 : count; // Bytes stored in the record.
+
+        // Stop at a record that was not written in full, or whose checksum does not match.
+        if (kind > editDelete || stored > length - position - 16)
+        {
+            break;
+        }
+        memcpy(&crc, contents + position + 12 + stored, 4);
+        if (crc != crcJournal(0, contents + position, 12 + stored))
+        {
+            break;
+        }
+
+        if (edit)
+        {
+            edit(kind, offset, contents + position + 12, count);
+        }
+        records++;
+        position += 16 + stored;
+    }
+
+    *end = position;
+    return records;
+}
+
+// Looks for a journal left behind for a file.
+// fileName: the location of the file.
+// original: the file the edits would be replayed onto.
+// records: set to the number of valid records in the journal.
+// matches: set if the file is the same size and age as when the edits were made.
+//
+// Returns: 1 if there is a journal with at least one record, otherwise 0.
+int checkJournal(char *fileName, fileMap *original, unsigned long int *records, int *matches)
+{
+    char name[PATH_MAX];
+    snprintf(name, PATH_MAX, "%s.journal", fileName);
+
+    unsigned long int length; // Size of the journal.
+    unsigned char *contents = loadJournal(name, &length);
+    if (contents == NULL)
+    {
+        return 0;
+    }
+
+    journalHeader current; // The header the journal would have for the file as it is now.
+    describeJournalFile(&current, original);
+    *matches = memcmp(contents, &current, sizeof(journalHeader)) == 0;
+
+    unsigned long int end; // End of the valid records.
+    *records = walkJournal(contents, length, NULL, &end);
+    free(contents);
+
+    return *records > 0;
+}
+
+// Opens the journal of a file, to record edits made to it.
+// fileName: the location of the file.
+// original: the file the edits are made to.
+// keep: set to keep the records of an existing journal, otherwise the journal is started empty.
+//
+// Returns: the journal, or NULL if it could not be created.
+editJournal *openJournal(char *fileName, fileMap *original, int keep)
+{
+    // Allocate memory for journal.
+    editJournal *obj = (editJournal *)calloc(1, sizeof(editJournal));
+    snprintf(obj->name, PATH_MAX, "%s.journal", fileName);
+
+    // Find the end of the valid records of the existing journal. Anything past it is cut off.
+    unsigned long int end = 0; // End of the valid records.
+    if (keep)
+    {
+        unsigned long int length; // Size of the journal.
+        unsigned char *contents = loadJournal(obj->name, &length);
+        if (contents)
+        {
+            walkJournal(contents, length, NULL, &end);
+            free(contents);
+        }
+    }
+
+    obj->fd = open(obj->name, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (obj->fd == -1)
+    {
+        free(obj);
+        return NULL;
+    }
+
+    if (end > 0)
+    {
+        ftruncate(obj->fd, end);
+        lseek(obj->fd, end, SEEK_SET);
+    }
+    else
+    {
+        journalHeader header;
+        describeJournalFile(&header, original);
+        ftruncate(obj->fd, 0);
+        if (pwrite(obj->fd, &header, sizeof(header), 0) != sizeof(header))
+        {
+            close(obj->fd);
+            unlink(obj->name);
+            free(obj);
+            return NULL;
+        }
+        lseek(obj->fd, sizeof(header), SEEK_SET);
+        fdatasync(obj->fd);
+    }
+
+    obj->pendingCapacity = JOURNAL_INITIAL_PENDING;
+    obj->pending = (unsigned char *)malloc(obj->pendingCapacity);
+
+    return obj;
+}
+
+// Replays the records of a journal, in the order they were made.
+// fileName: the location of the file.
+// edit: called with each record.
+//
+// Returns: the number of records replayed.
+unsigned long int replayJournal(char *fileName, journalEdit edit)
+{
+    char name[PATH_MAX];
+    snprintf(name, PATH_MAX, "%s.journal", fileName);
+
+    unsigned long int length; // Size of the journal.
+    unsigned char *contents = loadJournal(name, &length);
+    if (contents == NULL)
+    {
+        return 0;
+    }
+
+    unsigned long int end; // End of the valid records.
+    unsigned long int records = walkJournal(contents, length, edit, &end);
+    free(contents);
+
+    return records;
+}
+
+// Adds an edit to a journal. It is only written once syncJournal() is called.
+// journal: pointer to the journal, or NULL to do nothing.
+// kind: the kind of edit.
+// offset: the offset of the first byte edited.
+// bytes: the bytes after the edit, or the bytes inserted. Not used for deletes.
+// length: the number of bytes edited.
+void appendJournal(editJournal *journal, enum EditKind kind, unsigned long int offset, void *bytes, unsigned long int length)
+{
+    if (journal == NULL || length == 0)
+    {
+        return;
+    }
+
+    // Edits too long for one record are split across several.
+    while (length > JOURNAL_LENGTH_MASK)
+    {
+        appendJournal(journal, kind, offset, bytes, JOURNAL_LENGTH_MASK);
+        offset += kind == editDelete ? 0 : JOURNAL_LENGTH_MASK;
+        bytes = kind == editDelete ? bytes : (char *)bytes + JOURNAL_LENGTH_MASK;
+        length -= JOURNAL_LENGTH_MASK;
+    }
+
+    unsigned long int stored = kind == editDelete ? 0 : length; // Bytes stored in the record.
+    if (journal->pendingLength + stored + 16 > journal->pendingCapacity)
+    {
+        while (journal->pendingLength + stored + 16 > journal->pendingCapacity)
+        {
+            journal->pendingCapacity *= 2;
+        }
+        journal->pending = (unsigned char *)realloc(journal->pending, journal->pendingCapacity);
+    }
+
+    unsigned char *record = journal->pending + journal->pendingLength; // The new record.
+    uint64_t recordOffset = offset;
+    uint32_t recordLength = length | (uint32_t)kind << JOURNAL_KIND_SHIFT;
+    memcpy(record, &recordOffset, 8);
+    memcpy(record + 8, &recordLength, 4);
+    memcpy(record + 12, bytes, stored);
+    uint32_t crc = crcJournal(0, record, 12 + stored);
+    memcpy(record + 12 + stored, &crc, 4);
+    journal->pendingLength += 16 + stored;
+}
+
+// Writes the pending records of a journal and syncs it.
+// journal: pointer to the journal, or NULL to do nothing.
+//
+// Returns: 0 on success, -1 if the journal could not be written to.
+int syncJournal(editJournal *journal)
+{
+    if (journal == NULL || journal->pendingLength == 0)
+    {
+        return 0;
+    }
+
+    unsigned long int done = 0; // Bytes written so far.
+    while (done < journal->pendingLength)
+    {
+        ssize_t count = write(journal->fd, journal->pending + done, journal->pendingLength - done);
+        if (count <= 0)
+        {
+            return -1;
+        }
+        done += count;
+    }
+    journal->pendingLength = 0;
+
+    return fdatasync(journal->fd);
+}
+
+// Empties a journal, for when its edits have been written to the file.
+// journal: pointer to the journal, or NULL to do nothing.
+// original: the file as it is after the edits were written.
+void resetJournal(editJournal *journal, fileMap *original)
+{
+    if (journal == NULL)
+    {
+        return;
+    }
+
+    journalHeader header;
+    describeJournalFile(&header, original);
+    journal->pendingLength = 0;
+    ftruncate(journal->fd, 0);
+    pwrite(journal->fd, &header, sizeof(header), 0);
+    lseek(journal->fd, sizeof(header), SEEK_SET);
+    fdatasync(journal->fd);
+}
+
+// Closes a journal.
+// journal: pointer to the journal, or NULL to do nothing.
+// discard: set to remove the journal file, otherwise any pending records are written first.
+void closeJournal(editJournal *journal, int discard)
+{
+    if (journal == NULL)
+    {
+        return;
+    }
+
+    if (discard)
+    {
+        unlink(journal->name);
+    }
+    else
+    {
+        syncJournal(journal);
+    }
+
+    close(journal->fd);
+    free(journal->pending);
+    free(journal);
+}
+
+#endif
@@ -0,0 +1,361 @@
+//
+// hexeditor.c library file
+// overview.c
+//
+// Provides an overview of the contents: the entropy and the mix of bytes of each block, for finding compressed,
+// encrypted, text and empty regions at a glance.
+//
+// Demonstration:
+//
+//   Contents:   | block 0 (64 KiB) | block 1 | block 2 | ...
+//   Histogram:  | 00: 61234, 01: 12, ... FF: 3 | ...           The count of each byte value in the block.
+//   Kept:       | entropy 0.21, 93% zero, 4% text | entropy 7.99, 0% zero, 37% text | ...
+//
+// Each block is counted into a histogram of its 256 byte values, and its Shannon entropy is worked out from that, in
+// bits per byte: 0 for a block of one repeated byte, up to 8 for random bytes, which is what compressed and encrypted
+// data look like. Only the entropy and the shares of zero and text bytes are kept, so the overview of a 100 GB file
+// takes 12 MB rather than a histogram of 1 KB for every block.
+//
+// Counting a histogram one byte at a time stalls whenever two bytes in a row are the same, as each increment has to
+// wait for the last one to be stored. Instead, 8 bytes are loaded at once and spread over four tables of counts, which
+// are added together at the end, so runs of the same byte land in different tables.
+//
+// The blocks are counted in the background by the thread pool, a batch at a time, and the overview is usable as it
+// grows: blocks that have not been counted yet are left out. It describes the edited contents, so it must be stopped
+// before the piece table is written to. Blocks that are overwritten are counted again afterwards, and inserting or
+// deleting bytes moves every byte after the edit, so every block from there on is counted again.
+//
+
+// Avoid redefinition errors during compilation
+#ifndef FILE_OVERVIEW_SEEN
+#define FILE_OVERVIEW_SEEN
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "piecetable.h"
+#include "threadpool.h"
+
+#define OVERVIEW_BLOCK 65536 // Bytes of the contents each block describes.
+#define OVERVIEW_BATCH 256 // Blocks handed to the thread pool at a time by the background count.
+
+typedef struct
+{
+    float entropy; // The entropy of the block in bits per byte, from 0 to 8.
+    unsigned char zeros; // The share of bytes that are 00, out of 255.
+    unsigned char text; // The share of bytes that are printable ASCII, tab, line feed or carriage return, out of 255.
+    unsigned char counted; // Set once the other fields are in place.
+} overviewBlock;
+
+typedef struct
+{
+    pieceTable *table; // The contents being described. Must not be written to while the overview is running.
+    threadPool *pool; // The thread pool blocks are counted by.
+    overviewBlock *blocks; // The description of each block.
+    unsigned long int blockCount; // The number of blocks.
+    unsigned long int countedCount; // The number of blocks counted.
+    pthread_t thread; // The background thread, or 0 if it is not running.
+    volatile int cancelled; // Set to stop the background thread.
+    volatile int running; // Cleared once every block has been counted or the count has stopped.
+} overviewMap;
+
+typedef struct
+{
+    overviewMap *overview; // The overview.
+    unsigned long int *blocks; // The blocks of the batch.
+} overviewBatch;
+
+typedef struct
+{
+    double entropy; // The mean entropy of the blocks counted, in bits per byte.
+    double highest; // The highest entropy of any block counted.
+    int zeros; // The percentage of bytes that are 00.
+    int text; // The percentage of bytes that are text.
+    unsigned long int counted; // The number of blocks counted.
+    unsigned long int blocks; // The number of blocks in the segment.
+} overviewSummary;
+
+static double *overviewLogTable; // n * log2(n) for every count a block can have, so entropy needs no logarithms.
+
+// Counts the bytes of a segment, 8 at a time spread over four tables. Only available in scope of overview.c
+// bytes: the bytes.
+// length: the number of bytes.
+// histogram: set to the count of each byte value.
+static void countOverviewBytes(unsigned char *bytes, unsigned long int length, uint32_t *histogram)
+{
+    uint32_t counts[4][256]; // The counts of each table.
+    memset(counts, 0, sizeof(counts));
+
+    unsigned long int i = 0; // The next byte counted.
+    for (; i + 8 <= length; i += 8)
+    {
+        uint64_t word; // The next 8 bytes.
+        memcpy(&word, bytes + i, 8);
+        counts[0][word & 0xff]++;
+        counts[1][(word >> 8) & 0xff]++;
+        counts[2][(word >> 16) & 0xff]++;
+        counts[3][(word >> 24) & 0xff]++;
+        counts[0][(word >> 32) & 0xff]++;
+        counts[1][(word >> 40) & 0xff]++;
+        counts[2][(word >> 48) & 0xff]++;
+        counts[3][word >> 56]++;
+    }
+    for (; i < length; i++)
+    {
+        counts[0][bytes[i]]++;
+    }
+
+    for (int value = 0; value < 256; value++)
+    {
+        histogram[value] = counts[0][value] + counts[1][value] + counts[2][value] + counts[3][value];
+    }
+}
+
+// Counts one block of a batch. Run by the thread pool. Only available in scope of overview.c
+// argument: pointer to the batch.
+// number: the number of the block in the batch.
+static void countOverviewBlock(void *argument, unsigned long int number)
+{
+    overviewBatch *batch = (overviewBatch *)argument;
+    overviewMap *overview = batch->overview;
+    unsigned long int block = batch->blocks[number]; // The block being counted.
+    if (overview->cancelled)
+    {
+        return;
+    }
+
+    unsigned long int start = block * OVERVIEW_BLOCK; // The first byte of the block.
+    unsigned long int length = OVERVIEW_BLOCK; // The bytes counted.
+    if (length > overview->table->size - start)
+    {
+        length = overview->table->size - start;
+    }
+    unsigned char scratch[OVERVIEW_BLOCK];
+    uint32_t histogram[256]; // The count of each byte value.
+    countOverviewBytes(viewPieceTable(overview->table, start, length, scratch), length, histogram);
+
+    // H = -sum(p log2 p) = log2(n) - sum(c log2 c) / n, for counts c of n bytes.
+    double sum = 0; // The sum of c log2 c.
+    uint32_t text = histogram['\t'] + histogram['\n'] + histogram['\r']; // The number of text bytes.
+    for (int value = 0; value < 256; value++)
+    {
+        sum += overviewLogTable[histogram[value]];
+        text += value >= 32 && value <= 126 ? histogram[value] : 0;
+    }
+
+    overviewBlock *described = &overview->blocks[block];
+    described->entropy = log2(length) - sum / length;
+    described->zeros = histogram[0] * 255 / length;
+    described->text = text * 255 / length;
+
+    // The screen may show the block as soon as it is marked as counted, so the other fields have to be in place first.
+    __atomic_store_n(&described->counted, 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&overview->countedCount, 1, __ATOMIC_RELAXED);
+}
+
+// Counts every block that has not been counted yet, a batch at a time. Run by the background thread of an overview.
+// Only available in scope of overview.c
+// argument: pointer to the overview.
+//
+// Returns: NULL.
+static void *runOverview(void *argument)
+{
+    overviewMap *overview = (overviewMap *)argument;
+    unsigned long int blocks[OVERVIEW_BATCH]; // The blocks of a batch.
+    overviewBatch batch = { overview, blocks };
+
+    for (unsigned long int next = 0; next < overview->blockCount && !overview->cancelled; )
+    {
+        unsigned long int count = 0; // The number of blocks in the batch.
+        for (; next < overview->blockCount && count < OVERVIEW_BATCH; next++)
+        {
+            if (!overview->blocks[next].counted)
+            {
+                blocks[count++] = next;
+            }
+        }
+        if (count > 0)
+        {
+            runThreadPool(overview->pool, countOverviewBlock, &batch, count);
+        }
+    }
+
+    overview->running = 0;
+    return NULL;
+}
+
+// Stops the background count, if it is running, and waits for it. Blocks already counted are kept.
+// overview: pointer to the overview, or NULL to do nothing.
+void stopOverview(overviewMap *overview)
+{
+    if (overview == NULL || overview->thread == 0)
+    {
+        return;
+    }
+
+    overview->cancelled = 1;
+    pthread_join(overview->thread, NULL);
+    overview->thread = 0;
+    overview->running = 0;
+}
+
+// Follows the size of the contents and starts counting any blocks that have not been counted, unless the background
+// count is already running or there are none.
+// overview: pointer to the overview, or NULL to do nothing.
+// table: pointer to the piece table, which may have been replaced since the overview was built.
+void refreshOverview(overviewMap *overview, pieceTable *table)
+{
+    if (overview == NULL || overview->running)
+    {
+        return;
+    }
+    stopOverview(overview);
+    overview->table = table;
+
+    // Blocks past the end are dropped, and new blocks are not counted yet.
+    unsigned long int blockCount = (table->size + OVERVIEW_BLOCK - 1) / OVERVIEW_BLOCK; // The number of blocks now.
+    if (blockCount != overview->blockCount)
+    {
+        overview->blocks = (overviewBlock *)realloc(overview->blocks, sizeof(overviewBlock) * (blockCount ? blockCount : 1));
+        if (blockCount > overview->blockCount)
+        {
+            memset(overview->blocks + overview->blockCount, 0, sizeof(overviewBlock) * (blockCount - overview->blockCount));
+        }
+        overview->blockCount = blockCount;
+
+        overview->countedCount = 0;
+        for (unsigned long int i = 0; i < blockCount; i++)
+        {
+            overview->countedCount += overview->blocks[i].counted;
+        }
+    }
+
+    if (overview->countedCount < overview->blockCount)
+    {
+        overview->cancelled = 0;
+        overview->running = 1;
+        pthread_create(&overview->thread, NULL, runOverview, overview);
+    }
+}
+
+// Generate an overview of the contents, and start counting its blocks in the background.
+// table: pointer to the piece table. Must not be written to unless the overview is stopped.
+// pool: the thread pool blocks are counted by.
+//
+// Returns: the generated overview.
+overviewMap *buildOverview(pieceTable *table, threadPool *pool)
+{
+    // A block of n bytes needs the entries up to n.
+    if (overviewLogTable == NULL)
+    {
+        overviewLogTable = (double *)malloc(sizeof(double) * (OVERVIEW_BLOCK + 1));
+        overviewLogTable[0] = 0;
+        for (int i = 1; i <= OVERVIEW_BLOCK; i++)
+        {
+            overviewLogTable[i] = i * log2(i);
+        }
+    }
+
+    // Allocate memory for overview.
+    overviewMap *obj = (overviewMap *)calloc(1, sizeof(overviewMap));
+    obj->table = table;
+    obj->pool = pool;
+    refreshOverview(obj, table);
+    return obj;
+}
+
+// Records that a segment of the contents has been overwritten, so that its blocks are counted again. The overview must
+// be stopped.
+// overview: pointer to the overview, or NULL to do nothing.
+// offset: the offset of the first byte edited.
+// length: the number of bytes edited.
+void touchOverview(overviewMap *overview, unsigned long int offset, unsigned long int length)
+{
+    if (overview == NULL || length == 0)
+    {
+        return;
+    }
+
+    unsigned long int last = (offset + length - 1) / OVERVIEW_BLOCK; // The last block edited.
+    for (unsigned long int block = offset / OVERVIEW_BLOCK; block <= last && block < overview->blockCount; block++)
+    {
+        overview->countedCount -= overview->blocks[block].counted;
+        overview->blocks[block].counted = 0;
+    }
+}
+
+// Records that bytes have been inserted or deleted, so that every block from the edit on is counted again. The overview
+// must be stopped.
+// overview: pointer to the overview, or NULL to do nothing.
+// offset: the offset the bytes were inserted or deleted at.
+void shiftOverview(overviewMap *overview, unsigned long int offset)
+{
+    if (overview == NULL)
+    {
+        return;
+    }
+
+    for (unsigned long int block = offset / OVERVIEW_BLOCK; block < overview->blockCount; block++)
+    {
+        overview->countedCount -= overview->blocks[block].counted;
+        overview->blocks[block].counted = 0;
+    }
+}
+
+// Sums up the blocks that hold a segment of the contents, leaving out blocks that have not been counted yet.
+// overview: pointer to the overview.
+// from: the first byte of the segment.
+// to: one past the last byte of the segment.
+// summary: set to the summary of the segment.
+void summariseOverview(overviewMap *overview, unsigned long int from, unsigned long int to, overviewSummary *summary)
+{
+    memset(summary, 0, sizeof(overviewSummary));
+
+    // A segment shorter than a block still takes the block that holds it.
+    unsigned long int first = from / OVERVIEW_BLOCK; // The first block of the segment.
+    unsigned long int last = to > from ? (to - 1) / OVERVIEW_BLOCK : first; // The last block of the segment.
+    unsigned long int zeros = 0; // The sum of the shares of zero bytes.
+    unsigned long int text = 0; // The sum of the shares of text bytes.
+    for (unsigned long int block = first; block <= last && block < overview->blockCount; block++)
+    {
+        overviewBlock *described = &overview->blocks[block];
+        summary->blocks++;
+        if (!__atomic_load_n(&described->counted, __ATOMIC_ACQUIRE))
+        {
+            continue;
+        }
+
+        summary->counted++;
+        summary->entropy += described->entropy;
+        summary->highest = described->entropy > summary->highest ? described->entropy : summary->highest;
+        zeros += described->zeros;
+        text += described->text;
+    }
+
+    if (summary->counted > 0)
+    {
+        summary->entropy /= summary->counted;
+        summary->zeros = zeros * 100 / (summary->counted * 255);
+        summary->text = text * 100 / (summary->counted * 255);
+    }
+}
+
+// Stops and frees an overview.
+// overview: pointer to the overview, or NULL to do nothing.
+void freeOverview(overviewMap *overview)
+{
+    if (overview == NULL)
+    {
+        return;
+    }
+
+    stopOverview(overview);
+    free(overview->blocks);
+    free(overview);
+}
+
+#endif
@@ -0,0 +1,349 @@
+//
+// hexeditor.c library file
+// patch.c
+//
+// Provides logic for reading a list of byte patches and applying them to a piece table in one pass.
+//
+// Patch files hold one patch a line, an offset and the new bytes, both in hexadecimal:
+//
+//   # Comments and blank lines are ignored.
+//   0x1000: 90 90 90
+//   1004:EB FE
+//
+// Demonstration of merging:
+//
+//   Patches:   [0x1004 EB FE] [0x1000 90 90 90] [0x1001 00]
+//   Sorted:    [0x1000 90 90 90] [0x1001 00] [0x1004 EB FE]      Sorted by offset, keeping the order of the file.
+//   Merged:    [0x1000 90 00 90] [0x1004 EB FE]                  Overlapping and touching patches become one run,
+//                                                                and later patches win where they overlap.
+//
+// The runs are written to the piece table in ascending order, each costing time in the logarithm of the number of
+// pieces, and the table is then saved the same way as the editor saves (read top of savefile.h for more info).
+//
+
+// Avoid redefinition errors during compilation
+#ifndef FILE_PATCH_SEEN
+#define FILE_PATCH_SEEN
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "textutils.h"
+#include "piecetable.h"
+
+#define PATCH_INITIAL_EDITS 1024 // Patches allocated when the list is built.
+#define PATCH_INITIAL_BYTES 4096 // Bytes allocated for the new bytes of the patches.
+
+typedef struct
+{
+    unsigned long int offset; // The offset of the first byte patched.
+    unsigned long int length; // The number of bytes patched.
+    unsigned long int start; // The position of the new bytes in the byte arena.
+    unsigned long int order; // The line of the patch in the file, so that later patches win.
+} patchEdit;
+
+typedef struct
+{
+    patchEdit *edits; // The patches.
+    unsigned long int count; // The number of patches.
+    unsigned long int capacity; // Allocated number of patches.
+    unsigned char *bytes; // The new bytes of every patch.
+    unsigned long int bytesLength; // The number of new bytes.
+    unsigned long int bytesCapacity; // Allocated size of bytes.
+} patchList;
+
+// Generate an empty patch list.
+//
+// Returns: the generated list.
+patchList *buildPatchList()
+{
+    // Allocate memory for list.
+    patchList *obj = (patchList *)calloc(1, sizeof(patchList));
+
+    // Initialise list variables.
+    obj->capacity = PATCH_INITIAL_EDITS;
+    obj->edits = (patchEdit *)malloc(sizeof(patchEdit) * obj->capacity);
+    obj->bytesCapacity = PATCH_INITIAL_BYTES;
+    obj->bytes = (unsigned char *)malloc(obj->bytesCapacity);
+
+    return obj;
+}
+
+// Frees a patch list.
+// list: pointer to the list.
+void freePatchList(patchList *list)
+{
+    if (list == NULL)
+    {
+        return;
+    }
+
+    free(list->edits);
+    free(list->bytes);
+    free(list);
+}
+
+// Makes space for more new bytes. Only available in scope of patch.c
+// list: pointer to the list.
+// length: the number of bytes about to be added.
+static void reservePatchBytes(patchList *list, unsigned long int length)
+{
+    if (list->bytesLength + length > list->bytesCapacity)
+    {
+        while (list->bytesLength + length > list->bytesCapacity)
+        {
+            list->bytesCapacity *= 2;
+        }
+        list->bytes = (unsigned char *)realloc(list->bytes, list->bytesCapacity);
+    }
+}
+
+// Parses one line of a patch file and adds the patch to the list. Only available in scope of patch.c
+// list: pointer to the list.
+// line: the line, which need not be terminated.
+// length: the length of the line.
+//
+// Returns: 0 on success, -1 if the line is not a valid patch.
+static int parsePatchLine(patchList *list, char *line, unsigned long int length)
+{
+    char *end = line + length; // The end of the line.
+
+    // Skip leading whitespace, and ignore blank lines and comments.
+    while (line < end && (*line == ' ' || *line == '\t' || *line == '\r'))
+    {
+        line++;
+    }
+    if (line == end || *line == '#')
+    {
+        return 0;
+    }
+
+    // Read the offset, which may start with 0x.
+    if (end - line > 2 && line[0] == '0' && (line[1] == 'x' || line[1] == 'X'))
+    {
+        line += 2;
+    }
+    unsigned long int offset = 0; // The offset of the patch.
+    int digits = 0; // Digits of the offset.
+    for (; line < end && convertHexChar(*line) != -1; line++, digits++)
+    {
+        offset = offset * 16 + convertHexChar(*line);
+    }
+    if (digits == 0 || digits > 16 || line == end || *line != ':')
+    {
+        return -1;
+    }
+    line++;
+
+    // Read the new bytes, ignoring whitespace between digits, until the end of the line or a comment.
+    reservePatchBytes(list, (end - line) / 2 + 1);
+    unsigned long int start = list->bytesLength; // The position of the new bytes.
+    int high = -1; // The first digit of a byte, or -1 if none has been read.
+    for (; line < end && *line != '#'; line++)
+    {
+        int value = convertHexChar(*line);
+        if (value == -1)
+        {
+            if (*line != ' ' && *line != '\t' && *line != '\r')
+            {
+                return -1;
+            }
+            continue;
+        }
+
+        if (high == -1)
+        {
+            high = value;
+        }
+        else
+        {
+            list->bytes[list->bytesLength++] = high * 16 + value;
+            high = -1;
+        }
+    }
+    if (high != -1 || list->bytesLength == start)
+    {
+        list->bytesLength = start;
+        return -1;
+    }
+
+    // Add the patch.
+    if (list->count == list->capacity)
+    {
+        list->capacity *= 2;
+        list->edits = (patchEdit *)realloc(list->edits, sizeof(patchEdit) * list->capacity);
+    }
+    patchEdit *edit = &list->edits[list->count]; // The new patch.
+    edit->offset = offset;
+    edit->length = list->bytesLength - start;
+    edit->start = start;
+    edit->order = list->count;
+    list->count++;
+
+    return 0;
+}
+
+// Reads a patch file.
+// fileName: the location of the patch file.
+// errorLine: set to the number of the first line that is not a valid patch, or 0 if the file could not be read.
+//
+// Returns: the list of patches in the order of the file, or NULL on error.
+patchList *loadPatchList(char *fileName, unsigned long int *errorLine)
+{
+    *errorLine = 0;
+
+    int fd = open(fileName, O_RDONLY);
+    if (fd == -1)
+    {
+        return NULL;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == -1)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    char *text = (char *)malloc(info.st_size + 1); // The contents of the file.
+    unsigned long int length = 0; // Bytes read so far.
+    while (length < (unsigned long int)info.st_size)
+    {
+        ssize_t count = read(fd, text + length, info.st_size - length);
+        if (count <= 0)
+        {
+            break;
+        }
+        length += count;
+    }
+    close(fd);
+
+    // Parse each line.
+    patchList *list = buildPatchList();
+    unsigned long int lineNumber = 1; // The number of the line being parsed.
+    for (char *line = text; line < text + length; lineNumber++)
+    {
+        char *newline = (char *)memchr(line, '\n', text + length - line); // The end of the line.
+        if (newline == NULL)
+        {
+            newline = text + length;
+        }
+
+        if (parsePatchLine(list, line, newline - line) == -1)
+        {
+            *errorLine = lineNumber;
+            free(text);
+            freePatchList(list);
+            return NULL;
+        }
+        line = newline + 1;
+    }
+    free(text);
+
+    return list;
+}
+
+// Orders patches by offset, then by their order in the file. Only available in scope of patch.c
+static int comparePatchOffsets(const void *a, const void *b)
+{
+    const patchEdit *first = (const patchEdit *)a;
+    const patchEdit *second = (const patchEdit *)b;
+    if (first->offset != second->offset)
+    {
+        return first->offset < second->offset ? -1 : 1;
+    }
+    return first->order < second->order ? -1 : first->order > second->order;
+}
+
+// Orders patches by their order in the file. Only available in scope of patch.c
+static int comparePatchOrders(const void *a, const void *b)
+{
+    const patchEdit *first = (const patchEdit *)a;
+    const patchEdit *second = (const patchEdit *)b;
+    return first->order < second->order ? -1 : first->order > second->order;
+}
+
+// Sorts the patches by offset and merges overlapping and touching patches into runs. Where patches overlap, the one
+// later in the file wins.
+// list: pointer to the list. Afterwards it holds the runs, in ascending order.
+//
+// Returns: the number of runs.
+unsigned long int mergePatchList(patchList *list)
+{
+    qsort(list->edits, list->count, sizeof(patchEdit), comparePatchOffsets);
+
+    unsigned char *merged = (unsigned char *)malloc(list->bytesLength > 0 ? list->bytesLength : 1); // New bytes of the runs, which are never longer than the patches.
+    unsigned long int mergedLength = 0; // The number of bytes of the runs.
+    unsigned long int runs = 0; // The number of runs.
+
+    for (unsigned long int i = 0; i < list->count; )
+    {
+        // Find every patch that overlaps or touches the run.
+        unsigned long int start = list->edits[i].offset; // Offset of the run.
+        unsigned long int end = start + list->edits[i].length; // End of the run.
+        unsigned long int next = i + 1; // The first patch after the run.
+        while (next < list->count && list->edits[next].offset <= end)
+        {
+            if (list->edits[next].offset + list->edits[next].length > end)
+            {
+                end = list->edits[next].offset + list->edits[next].length;
+            }
+            next++;
+        }
+
+        // Copy the patches into the run in the order of the file, so that later patches overwrite earlier ones.
+        if (next - i > 1)
+        {
+            qsort(&list->edits[i], next - i, sizeof(patchEdit), comparePatchOrders);
+        }
+        for (unsigned long int j = i; j < next; j++)
+        {
+            memcpy(merged + mergedLength + (list->edits[j].offset - start), list->bytes + list->edits[j].start, list->edits[j].length);
+        }
+
+        // The run replaces the patches. It is never stored past them, as runs are never longer than their patches.
+        patchEdit *run = &list->edits[runs++];
+        run->offset = start;
+        run->length = end - start;
+        run->start = mergedLength;
+        run->order = runs - 1;
+        mergedLength += end - start;
+        i = next;
+    }
+
+    free(list->bytes);
+    list->bytes = merged;
+    list->bytesLength = mergedLength;
+    list->bytesCapacity = list->bytesLength > 0 ? list->bytesLength : 1;
+    list->count = runs;
+
+    return runs;
+}
+
+// Writes the patches of a list to a piece table. Nothing is written if any patch is past the end of the table.
+// list: pointer to the list, which should be merged first so that the writes are in ascending order.
+// table: pointer to the piece table.
+//
+// Returns: 0 on success, -1 if a patch is past the end of the table.
+int applyPatchList(patchList *list, pieceTable *table)
+{
+    for (unsigned long int i = 0; i < list->count; i++)
+    {
+        if (list->edits[i].offset > table->size || list->edits[i].length > table->size - list->edits[i].offset)
+        {
+            return -1;
+        }
+    }
+
+    for (unsigned long int i = 0; i < list->count; i++)
+    {
+        writePieceTable(table, list->edits[i].offset, list->bytes + list->edits[i].start, list->edits[i].length);
+    }
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,755 @@
+//
+// hexeditor.c library file
+// piecetable.c
+//
+// Provides logic for the piece table that edits are stored in.
+//
+// Demonstration:
+//
+//   Original (read only):  +---------------------------------------------------+
+//                          | 00 11 22 33 44 55 66 77 88 99 AA BB CC DD EE FF   |
+//                          +---------------------------------------------------+
+//   Added (append only):   +--------------+
+//                          | 12 34 | 56   |
+//                          +--------------+
+//   Pieces:                [original 0-3] [added 0-1] [original 6-7] [added 2] [original 8-15]
+//   Contents:              00 11 22 33 12 34 66 77 56 88 99 AA BB CC DD EE FF
+//
+// The file is never copied. The contents of the file are described by a sequence of pieces, each of which refers to a
+// segment of either the original file or the added buffer. Writing bytes appends them to the added buffer and
+// splits the pieces around them, so opening a file costs the same no matter how large it is. Bytes can be overwritten
+// (44 55 became 12 34 above) or inserted (56 above) or deleted, so the contents can be longer or shorter than the
+// original file.
+//
+// The pieces are kept in a tree in the order of the contents:
+//
+//   [added 0-1] total 17
+//   +-- before: [original 0-3] total 4
+//   +-- after:  [added 2] total 11
+//               +-- before: [original 6-7] total 2
+//               +-- after:  [original 8-15] total 8
+//
+// Each piece holds the total length of itself and the pieces below it, rather than its offset, so the piece at an
+// offset is found by walking down from the top, and inserting or deleting bytes does not have to move every piece
+// after them. The tree is a treap: each piece also has a random priority, and no piece is below one of lower
+// priority, which keeps the tree balanced. Edits split the tree at the edges of the segment and join it back together,
+// so an edit costs time in the logarithm of the number of pieces rather than in the size of the file.
+//
+// Copies of the original file can be read through a block cache (read top of blockcache.h for more info), which is
+// how the editor reads the lines it shows. Views are taken straight from the file map instead, so that large scans
+// such as searches do not push the lines being shown out of the cache.
+//
+// Every write is also recorded as a dirty range. Ranges that overlap or touch are merged as they are recorded, so
+// saving only has to visit the segments that have changed (see savefile.h). Inserting or deleting bytes moves the
+// bytes of the original file after them away from where they are in the file, so the table is marked as shifted
+// instead, and has to be saved as a whole.
+//
+
+// Avoid redefinition errors during compilation
+#ifndef FILE_PIECETABLE_SEEN
+#define FILE_PIECETABLE_SEEN
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#include "filemap.h"
+#include "blockcache.h"
+
+#define PIECETABLE_INITIAL_PIECES 16 // Number of pieces allocated when a piece table is built.
+#define PIECETABLE_INITIAL_ADDED 4096 // Size of the added buffer allocated when a piece table is built.
+#define PIECETABLE_INITIAL_DIRTY 16 // Number of dirty ranges allocated when a piece table is built.
+
+enum PieceSource
+{
+    pieceOriginal, // The piece refers to the original file.
+    pieceAdded // The piece refers to the added buffer.
+};
+
+enum EditKind
+{
+    editOverwrite, // Bytes were replaced by as many other bytes.
+    editInsert, // Bytes were inserted, moving the bytes after them back.
+    editDelete // Bytes were removed, moving the bytes after them forward.
+};
+
+typedef struct
+{
+    enum PieceSource source; // The buffer the piece refers to.
+    unsigned long int start; // The position of the piece in its buffer.
+    unsigned long int length; // The length of the piece.
+    unsigned long int total; // The length of the piece and every piece below it in the tree.
+    unsigned int priority; // Random priority. No piece is below a piece of lower priority.
+    int left; // The pieces before it in the tree, or -1. Links the unused pieces together.
+    int right; // The pieces after it in the tree, or -1.
+} piece;
+
+typedef struct
+{
+    unsigned long int start; // The first byte of the range.
+    unsigned long int end; // One past the last byte of the range.
+} dirtyRange;
+
+typedef struct
+{
+    fileMap *original; // The original file.
+    blockCache *cache; // The cache copies of the original file are read through, or NULL.
+    unsigned char *added; // Buffer holding every byte that has been written.
+    unsigned long int addedLength; // Bytes used in the added buffer.
+    unsigned long int addedCapacity; // Allocated size of the added buffer.
+    piece *pieces; // The pieces, which refer to each other by their index.
+    int root; // The piece at the top of the tree, or -1 if the contents are empty.
+    int freePiece; // The first unused piece, or -1.
+    int pieceCount; // Number of pieces handed out, including unused ones.
+    int pieceCapacity; // Allocated number of pieces.
+    unsigned int seed; // State of the generator of priorities.
+    unsigned long int size; // The size of the contents in bytes.
+    int shifted; // Set once bytes have been inserted or deleted, so that bytes of the file are no longer at their offset.
+    dirtyRange *dirty; // Segments that differ from the original file, ordered and never touching each other.
+    int dirtyCount; // Number of dirty ranges in use.
+    int dirtyCapacity; // Allocated number of dirty ranges.
+} pieceTable;
+
+// Checks piece table object is valid. Only available in scope of piecetable.c
+// table: pointer to the piece table.
+//
+// Throws if table is null.
+static void checkPieceTableIsValid(pieceTable *table)
+{
+    // Throw if table is null.
+    if (table == NULL)
+    {
+        fprintf(stderr, "Piece table is null.\n");
+        exit(1);
+    }
+}
+
+// Hands out a piece, reusing an unused one if there is one. Only available in scope of piecetable.c
+// table: pointer to the piece table.
+// source: the buffer the piece refers to.
+// start: the position of the piece in its buffer.
+// length: the length of the piece.
+//
+// Returns: the index of the piece. The pieces may have moved in memory.
+static int allocatePiece(pieceTable *table, enum PieceSource source, unsigned long int start, unsigned long int length)
+{
+    int index = table->freePiece; // The piece handed out.
+    if (index != -1)
+    {
+        table->freePiece = table->pieces[index].left;
+    }
+    else
+    {
+        if (table->pieceCount == table->pieceCapacity)
+        {
+            table->pieceCapacity *= 2;
+            table->pieces = (piece *)realloc(table->pieces, sizeof(piece) * table->pieceCapacity);
+        }
+        index = table->pieceCount++;
+    }
+
+    // Xorshift, which is plenty random enough to balance the tree.
+    table->seed ^= table->seed << 13;
+    table->seed ^= table->seed >> 17;
+    table->seed ^= table->seed << 5;
+
+    piece *p = &table->pieces[index];
+    p->source = source;
+    p->start = start;
+    p->length = length;
+    p->total = length;
+    p->priority = table->seed;
+    p->left = -1;
+    p->right = -1;
+
+    return index;
+}
+
+// Returns every piece of a tree to the unused pieces. Only available in scope of piecetable.c
+// table: pointer to the piece table.
+// index: the top of the tree, or -1.
+static void releasePieces(pieceTable *table, int index)
+{
+    if (index == -1)
+    {
+        return;
+    }
+
+    releasePieces(table, table->pieces[index].left);
+    releasePieces(table, table->pieces[index].right);
+    table->pieces[index].left = table->freePiece;
+    table->freePiece = index;
+}
+
+// Gets the length of a tree. Only available in scope of piecetable.c
+// table: pointer to the piece table.
+// index: the top of the tree, or -1.
+//
+// Returns: the number of bytes the pieces of the tree refer to.
+static unsigned long int totalPieces(pieceTable *table, int index)
+{
+    return index == -1 ? 0 : table->pieces[index].total;
+}
+
+// Works out the total of a piece again after the pieces below it have changed. Only available in scope of piecetable.c
+// table: pointer to the piece table.
+// index: the piece.
+static void updatePiece(pieceTable *table, int index)
+{
+    piece *p = &table->pieces[index];
+    p->total = p->length + totalPieces(table, p->left) + totalPieces(table, p->right);
+}
+
+// Joins two trees, with every piece of the first before every piece of the second. Only available in scope of piecetable.c
+// table: pointer to the piece table.
+// first: the top of the first tree, or -1.
+// second: the top of the second tree, or -1.
+//
+// Returns: the top of the joined tree.
+static int joinPieces(pieceTable *table, int first, int second)
+{
+    if (first == -1 || second == -1)
+    {
+        return first == -1 ? second : first;
+    }
+
+    // The piece of higher priority stays on top.
+    if (table->pieces[first].priority >= table->pieces[second].priority)
+    {
+        int right = joinPieces(table, table->pieces[first].right, second);
+        table->pieces[first].right = right;
+        updatePiece(table, first);
+        return first;
+    }
+
+    int left = joinPieces(table, first, table->pieces[second].left);
+    table->pieces[second].left = left;
+    updatePiece(table, second);
+    return second;
+}
+
+// Splits a tree in two at an offset, splitting the piece the offset falls inside of. Only available in scope of piecetable.c
+// table: pointer to the piece table.
+// index: the top of the tree, or -1.
+// offset: the number of bytes that go into the first tree.
+// first: set to the top of the tree of the bytes before offset.
+// second: set to the top of the tree of the bytes from offset on.
+static void splitPieces(pieceTable *table, int index, unsigned long int offset, int *first, int *second)
+{
+    if (index == -1)
+    {
+        *first = -1;
+        *second = -1;
+        return;
+    }
+
+    unsigned long int before = totalPieces(table, table->pieces[index].left); // Bytes of the pieces before this one.
+    unsigned long int length = table->pieces[index].length; // Bytes of this piece.
+    int left; // The first tree of a split below this piece.
+    int right; // The second tree of a split below this piece.
+
+    if (offset <= before)
+    {
+        splitPieces(table, table->pieces[index].left, offset, &left, &right);
+        table->pieces[index].left = right;
+        updatePiece(table, index);
+        *first = left;
+        *second = index;
+    }
+    else if (offset >= before + length)
+    {
+        splitPieces(table, table->pieces[index].right, offset - before - length, &left, &right);
+        table->pieces[index].right = left;
+        updatePiece(table, index);
+        *first = index;
+        *second = right;
+    }
+    else
+    {
+        // The offset falls inside this piece, so it keeps the bytes before the offset and a new piece gets the rest.
+        unsigned long int skip = offset - before; // Bytes kept by this piece.
+        int rest = allocatePiece(table, table->pieces[index].source, table->pieces[index].start + skip, length - skip);
+        right = table->pieces[index].right;
+        table->pieces[index].length = skip;
+        table->pieces[index].right = -1;
+        updatePiece(table, index);
+        *first = index;
+        *second = joinPieces(table, rest, right);
+    }
+}
+
+// Replaces every piece with one piece covering the original file.
+// table: pointer to the piece table.
+void resetPieceTable(pieceTable *table)
+{
+    checkPieceTableIsValid(table);
+
+    table->size = table->original->size;
+    table->addedLength = 0;
+    table->root = -1;
+    table->freePiece = -1;
+    table->pieceCount = 0;
+    table->dirtyCount = 0;
+    table->shifted = 0;
+
+    if (table->size > 0)
+    {
+        table->root = allocatePiece(table, pieceOriginal, 0, table->size);
+    }
+}
+
+// Generate a piece table.
+// original: the file being editted.
+//
+// Returns: the generated piece table.
+pieceTable *buildPieceTable(fileMap *original)
+{
+    // Allocate memory for piece table.
+    pieceTable *obj = (pieceTable *)malloc(sizeof(pieceTable));
+
+    // Initialise piece table variables.
+    obj->original = original;
+    obj->cache = NULL;
+    obj->addedCapacity = PIECETABLE_INITIAL_ADDED;
+    obj->added = (unsigned char *)malloc(obj->addedCapacity);
+    obj->pieceCapacity = PIECETABLE_INITIAL_PIECES;
+    obj->pieces = (piece *)malloc(sizeof(piece) * obj->pieceCapacity);
+    obj->seed = 2463534242u;
+    obj->dirtyCapacity = PIECETABLE_INITIAL_DIRTY;
+    obj->dirty = (dirtyRange *)malloc(sizeof(dirtyRange) * obj->dirtyCapacity);
+    resetPieceTable(obj);
+
+    return obj;
+}
+
+// Finds the piece containing an offset. Only available in scope of piecetable.c
+// table: pointer to the piece table.
+// offset: the position in the contents of the file.
+// pieceOffset: set to the position of the piece in the contents.
+//
+// Returns: the index of the piece, or -1 if offset is past the end of the contents.
+static int findPiece(pieceTable *table, unsigned long int offset, unsigned long int *pieceOffset)
+{
+    int index = table->root; // The piece being looked at.
+    unsigned long int base = 0; // The position of the tree below it.
+
+    // Walk down, keeping track of the bytes of the pieces passed on the left.
+    while (index != -1)
+    {
+        piece *p = &table->pieces[index];
+        unsigned long int before = totalPieces(table, p->left); // Bytes of the pieces before this one.
+        if (offset < base + before)
+        {
+            index = p->left;
+        }
+        else if (offset < base + before + p->length)
+        {
+            *pieceOffset = base + before;
+            return index;
+        }
+        else
+        {
+            base += before + p->length;
+            index = p->right;
+        }
+    }
+
+    return -1;
+}
+
+// Gets the bytes a piece refers to. Only available in scope of piecetable.c
+// table: pointer to the piece table.
+// p: the piece.
+// skip: bytes to skip from the start of the piece.
+// length: bytes that will be viewed.
+// scratch: buffer of at least length bytes that files read with pread() are read into.
+//
+// Returns: pointer to the bytes, which is valid until the next write to the table.
+static unsigned char *viewPiece(pieceTable *table, piece *p, unsigned long int skip, unsigned long int length, unsigned char *scratch)
+{
+    if (p->source == pieceAdded)
+    {
+        return table->added + p->start + skip;
+    }
+
+    // The window of the file map is shared, so reading into scratch keeps views from different threads apart.
+    if (table->original->mode == filePositioned)
+    {
+        readFileMap(table->original, p->start + skip, scratch, length);
+        return scratch;
+    }
+
+    return viewFileMap(table->original, p->start + skip, length);
+}
+
+// Copies a segment of the contents into a buffer. Any part of the segment past the end is filled with zeroes.
+// table: pointer to the piece table.
+// offset: the start position of reading.
+// buffer: the buffer being written to.
+// length: the number of bytes to read.
+//
+// Returns: the number of bytes that were read.
+unsigned long int readPieceTable(pieceTable *table, unsigned long int offset, void *buffer, unsigned long int length)
+{
+    checkPieceTableIsValid(table);
+
+    unsigned long int done = 0; // Bytes read so far.
+    unsigned long int pieceOffset; // The position of the piece being read.
+    int index; // The piece being read.
+
+    // Copy from each piece overlapping the segment.
+    while (done < length && (index = findPiece(table, offset + done, &pieceOffset)) != -1)
+    {
+        piece *p = &table->pieces[index];
+        unsigned long int skip = offset + done - pieceOffset; // Bytes of the piece before the segment.
+        unsigned long int count = p->length - skip; // Bytes copied from this piece.
+        if (count > length - done)
+        {
+            count = length - done;
+        }
+
+        if (p->source == pieceAdded)
+        {
+            memcpy((char *)buffer + done, table->added + p->start + skip, count);
+        }
+        else if (table->cache)
+        {
+            readBlockCache(table->cache, p->start + skip, (char *)buffer + done, count);
+        }
+        else
+        {
+            readFileMap(table->original, p->start + skip, (char *)buffer + done, count);
+        }
+
+        done += count;
+    }
+
+    memset((char *)buffer + done, 0, length - done);
+    return done;
+}
+
+// Views a segment of the contents, without copying it if it lies within one piece. Views may be taken from several
+// threads at once, as long as each has its own scratch buffer and nothing writes to the table meanwhile.
+// table: pointer to the piece table.
+// offset: the start position of the segment.
+// length: the length of the segment.
+// scratch: buffer of at least length bytes the segment is copied into if it spans several pieces.
+//
+// Returns: pointer to the segment, which is valid until scratch is reused or the table is written to.
+unsigned char *viewPieceTable(pieceTable *table, unsigned long int offset, unsigned long int length, unsigned char *scratch)
+{
+    checkPieceTableIsValid(table);
+
+    unsigned long int pieceOffset; // The position of the piece.
+    int index = findPiece(table, offset, &pieceOffset); // The piece containing the start of the segment.
+    if (index != -1)
+    {
+        piece *p = &table->pieces[index];
+        unsigned long int skip = offset - pieceOffset; // Bytes of the piece before the segment.
+        if (p->length - skip >= length)
+        {
+            return viewPiece(table, p, skip, length, scratch);
+        }
+    }
+
+    readPieceTable(table, offset, scratch, length);
+    return scratch;
+}
+
+// Finds where a byte of the contents is in the original file.
+// table: pointer to the piece table.
+// offset: the position of the byte in the contents.
+// fileOffset: set to the position of the byte in the original file.
+//
+// Returns: 1 if the byte comes from the original file, 0 if it was added by an edit or offset is past the end.
+int locatePieceTable(pieceTable *table, unsigned long int offset, unsigned long int *fileOffset)
+{
+    unsigned long int pieceOffset; // The position of the piece.
+    int index = findPiece(table, offset, &pieceOffset); // The piece containing the byte.
+    if (index == -1 || table->pieces[index].source != pieceOriginal)
+    {
+        return 0;
+    }
+
+    *fileOffset = table->pieces[index].start + offset - pieceOffset;
+    return 1;
+}
+
+// Collects the bytes of a segment as a list of vectors, so that it can be written with pwritev() without copying it.
+// table: pointer to the piece table.
+// offset: the start position of the segment. The segment must not pass the end of the contents.
+// length: the length of the segment.
+// vectors: pointer to the list of vectors, which is grown if it is too small.
+// capacity: pointer to the allocated number of vectors.
+//
+// Returns: the number of vectors used, or -1 if part of the segment can only be read by copying it.
+int gatherPieceTable(pieceTable *table, unsigned long int offset, unsigned long int length, struct iovec **vectors, int *capacity)
+{
+    checkPieceTableIsValid(table);
+
+    int count = 0; // Vectors used so far.
+    unsigned long int done = 0; // Bytes gathered so far.
+    unsigned long int pieceOffset; // The position of the piece being gathered.
+    int index; // The piece being gathered.
+
+    while (done < length && (index = findPiece(table, offset + done, &pieceOffset)) != -1)
+    {
+        piece *p = &table->pieces[index];
+
+        // Views of files read through pread() only last until the next view.
+        if (p->source == pieceOriginal && table->original->mode == filePositioned)
+        {
+            return -1;
+        }
+
+        unsigned long int skip = offset + done - pieceOffset; // Bytes of the piece before the segment.
+        unsigned long int part = p->length - skip; // Bytes gathered from this piece.
+        if (part > length - done)
+        {
+            part = length - done;
+        }
+
+        if (count == *capacity)
+        {
+            *capacity = *capacity ? *capacity * 2 : PIECETABLE_INITIAL_PIECES;
+            *vectors = (struct iovec *)realloc(*vectors, sizeof(struct iovec) * *capacity);
+        }
+        (*vectors)[count].iov_base = viewPiece(table, p, skip, part, NULL);
+        (*vectors)[count].iov_len = part;
+
+        count++;
+        done += part;
+    }
+
+    return count;
+}
+
+// Records a segment as dirty, merging it with any ranges it overlaps or touches. Only available in scope of piecetable.c
+// table: pointer to the piece table.
+// start: the first byte of the segment.
+// end: one past the last byte of the segment.
+static void markPieceTableDirty(pieceTable *table, unsigned long int start, unsigned long int end)
+{
+    // Binary search for the first range that ends at or after start, which is the first range that could be merged.
+    int low = 0;
+    int high = table->dirtyCount;
+    while (low < high)
+    {
+        int middle = (low + high) / 2;
+        if (table->dirty[middle].end < start)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    // Find every range that starts at or before end, which all merge into one.
+    int last = low; // One past the last range being merged.
+    while (last < table->dirtyCount && table->dirty[last].start <= end)
+    {
+        if (table->dirty[last].start < start)
+        {
+            start = table->dirty[last].start;
+        }
+        if (table->dirty[last].end > end)
+        {
+            end = table->dirty[last].end;
+        }
+        last++;
+    }
+
+    // Nothing to merge with, so make space for a new range.
+    if (last == low)
+    {
+        if (table->dirtyCount == table->dirtyCapacity)
+        {
+            table->dirtyCapacity *= 2;
+            table->dirty = (dirtyRange *)realloc(table->dirty, sizeof(dirtyRange) * table->dirtyCapacity);
+        }
+        memmove(&table->dirty[low + 1], &table->dirty[low], sizeof(dirtyRange) * (table->dirtyCount - low));
+        table->dirtyCount++;
+        last++;
+    }
+
+    // Replace the merged ranges with one range.
+    table->dirty[low].start = start;
+    table->dirty[low].end = end;
+    memmove(&table->dirty[low + 1], &table->dirty[last], sizeof(dirtyRange) * (table->dirtyCount - last));
+    table->dirtyCount -= last - low - 1;
+}
+
+// Appends bytes to the added buffer. Only available in scope of piecetable.c
+// table: pointer to the piece table.
+// bytes: the bytes being appended, or NULL to append zeroes.
+// length: the number of bytes being appended.
+//
+// Returns: the position of the bytes in the added buffer.
+static unsigned long int appendPieceTable(pieceTable *table, void *bytes, unsigned long int length)
+{
+    if (table->addedLength + length > table->addedCapacity)
+    {
+        while (table->addedLength + length > table->addedCapacity)
+        {
+            table->addedCapacity *= 2;
+        }
+        table->added = (unsigned char *)realloc(table->added, table->addedCapacity);
+    }
+
+    unsigned long int start = table->addedLength; // Position of the bytes in the added buffer.
+    if (bytes)
+    {
+        memcpy(table->added + start, bytes, length);
+    }
+    else
+    {
+        memset(table->added + start, 0, length);
+    }
+    table->addedLength += length;
+
+    return start;
+}
+
+// Puts a piece referring to newly added bytes at the end of a tree. Only available in scope of piecetable.c
+// table: pointer to the piece table.
+// index: the top of the tree, or -1.
+// start: the position of the bytes in the added buffer.
+// length: the number of bytes.
+//
+// Returns: the top of the tree.
+static int appendPieces(pieceTable *table, int index, unsigned long int start, unsigned long int length)
+{
+    // Extend the last piece instead of adding one if it was the last thing written, which is the case when typing over
+    // or inserting consecutive bytes. Every piece above it covers it, so their totals grow too.
+    int last = index; // The last piece of the tree.
+    while (last != -1 && table->pieces[last].right != -1)
+    {
+        last = table->pieces[last].right;
+    }
+    if (last != -1 && table->pieces[last].source == pieceAdded && table->pieces[last].start + table->pieces[last].length == start)
+    {
+        table->pieces[last].length += length;
+        for (int p = index; p != -1; p = table->pieces[p].right)
+        {
+            table->pieces[p].total += length;
+        }
+        return index;
+    }
+
+    return joinPieces(table, index, allocatePiece(table, pieceAdded, start, length));
+}
+
+// Overwrites a segment of the contents. The bytes are appended to the added buffer.
+// table: pointer to the piece table.
+// offset: the start position of writing.
+// bytes: the bytes being written.
+// length: the number of bytes being written.
+//
+// Returns: 0 on success, -1 if the segment passes the end of the contents.
+int writePieceTable(pieceTable *table, unsigned long int offset, void *bytes, unsigned long int length)
+{
+    checkPieceTableIsValid(table);
+
+    if (offset > table->size || length > table->size - offset)
+    {
+        return -1;
+    }
+    if (length == 0)
+    {
+        return 0;
+    }
+
+    unsigned long int start = appendPieceTable(table, bytes, length); // Position of the bytes in the added buffer.
+    markPieceTableDirty(table, offset, offset + length);
+
+    // Cut out the pieces covered by the segment and put one piece referring to the added buffer in their place.
+    int before, covered, after; // The trees before, covered by, and after the segment.
+    splitPieces(table, table->root, offset, &before, &after);
+    splitPieces(table, after, length, &covered, &after);
+    releasePieces(table, covered);
+    table->root = joinPieces(table, appendPieces(table, before, start, length), after);
+
+    return 0;
+}
+
+// Inserts bytes into the contents, moving the bytes after them back. The bytes are appended to the added buffer.
+// table: pointer to the piece table.
+// offset: the position the bytes are inserted at, which may be the end of the contents.
+// bytes: the bytes being inserted, or NULL to insert zeroes.
+// length: the number of bytes being inserted.
+//
+// Returns: 0 on success, -1 if offset is past the end of the contents.
+int insertPieceTable(pieceTable *table, unsigned long int offset, void *bytes, unsigned long int length)
+{
+    checkPieceTableIsValid(table);
+
+    if (offset > table->size)
+    {
+        return -1;
+    }
+    if (length == 0)
+    {
+        return 0;
+    }
+
+    unsigned long int start = appendPieceTable(table, bytes, length); // Position of the bytes in the added buffer.
+    table->size += length;
+    table->shifted = 1;
+
+    int before, after; // The trees before and after the offset.
+    splitPieces(table, table->root, offset, &before, &after);
+    table->root = joinPieces(table, appendPieces(table, before, start, length), after);
+
+    return 0;
+}
+
+// Deletes a segment of the contents, moving the bytes after it forward.
+// table: pointer to the piece table.
+// offset: the start position of the segment.
+// length: the length of the segment.
+//
+// Returns: 0 on success, -1 if the segment passes the end of the contents.
+int deletePieceTable(pieceTable *table, unsigned long int offset, unsigned long int length)
+{
+    checkPieceTableIsValid(table);
+
+    if (offset > table->size || length > table->size - offset)
+    {
+        return -1;
+    }
+    if (length == 0)
+    {
+        return 0;
+    }
+
+    table->size -= length;
+    table->shifted = 1;
+
+    int before, covered, after; // The trees before, covered by, and after the segment.
+    splitPieces(table, table->root, offset, &before, &after);
+    splitPieces(table, after, length, &covered, &after);
+    releasePieces(table, covered);
+    table->root = joinPieces(table, before, after);
+
+    return 0;
+}
+
+// Free a piece table. The original file is not closed.
+// table: pointer to the piece table.
+void freePieceTable(pieceTable *table)
+{
+    if (table == NULL)
+    {
+        return;
+    }
+
+    free(table->added);
+    free(table->pieces);
+    free(table->dirty);
+    free(table);
+}
+
+#endif
@@ -0,0 +1,720 @@
+//
+// hexeditor.c library file
+// printables.c
+//
+// Provides the finder of printable strings: runs of at least a minimum number of printable characters, like strings(1)
+// finds, with their offsets. Printable characters are the bytes from 32 to 126 and tab. Runs are found both as ASCII,
+// one byte a character, and as UTF-16LE, where each character is a printable byte followed by a zero byte.
+//
+// Demonstration:
+//
+//   0x00000000   2F 2F 20 68 65 78 00 00 68 00 69 00 21 00 00 00     // hex..h.i.!...
+//
+//   0x00000000 A // hex
+//   0x00000008 U hi!
+//
+// The contents are scanned in blocks of PRINTABLE_BLOCK bytes. The bytes of a block are first turned into two masks
+// with vector range compares, 64 bytes to a word: the bytes that are printable and the bytes that are zero (16 bytes
+// at a time with SSE2, 32 with AVX2, and one at a time without them). The UTF-16LE characters are then the printable
+// bits whose next bit is zero, and the runs are read off the masks with bit operations: a word is checked for the
+// positions that start PRINTABLE_FILTER characters in a row (or the minimum, if it is lower) at once, so the words of
+// binary data that only hold short runs are passed over without looking at each run. UTF-16LE runs are looked for at
+// even and odd positions separately, as every other bit of the same mask.
+//
+// Large scans are split into chunks that are scanned in parallel by a thread pool (read top of threadpool.h for more
+// info). A chunk reports the runs that start inside it, and reads on past its end to finish the last of them, so runs
+// crossing chunks are found whole, once. Finding the runs for the editor runs in the background like finding every
+// match of a search (read top of search.h for more info).
+//
+
+// Avoid redefinition errors during compilation
+#ifndef FILE_PRINTABLES_SEEN
+#define FILE_PRINTABLES_SEEN
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PRINTABLE_X86
+#endif
+
+#include "piecetable.h"
+#include "threadpool.h"
+
+#define PRINTABLE_BLOCK 65536 // Size of the blocks the contents are scanned in. Must be a multiple of 64.
+#define PRINTABLE_CHUNK 16777216 // Size of the chunks the contents are split into for scanning in parallel.
+#define PRINTABLE_MINIMUM 4 // Characters a run needs if no other minimum is given.
+#define PRINTABLE_FILTER 8 // Most characters in a row a word is checked for before its runs are looked at.
+#define PRINTABLE_LIST_LIMIT 4194304 // Most runs kept for the editor.
+#define PRINTABLE_OUTPUT 1048576 // Size of the buffer runs are written from.
+
+typedef struct
+{
+    unsigned long int offset; // The position of the first character.
+    unsigned int length; // The number of characters.
+    unsigned int wide; // 1 if the run is UTF-16LE, 0 if it is ASCII.
+} printableRun;
+
+typedef struct
+{
+    printableRun *runs; // The runs, in order.
+    unsigned long int count; // The number of runs.
+    unsigned long int capacity; // Allocated number of runs.
+} printableRuns;
+
+typedef struct
+{
+    pieceTable *table; // The contents being scanned.
+    int minimum; // Characters a run needs.
+    unsigned long int from; // The first position a run can start at.
+    unsigned long int to; // One past the last position a run can start at.
+    printableRuns *chunkRuns; // The runs found by each chunk.
+    volatile int *cancelled; // Stops the scan when set. May be NULL.
+} printableJob;
+
+typedef struct
+{
+    unsigned long int lanes; // The bits of a word that the characters of the stream can be at.
+    int stride; // Bytes of each character.
+    int open; // Whether a run is open.
+    unsigned long int start; // The position of the first character of the open run.
+} printableStream;
+
+typedef struct
+{
+    threadPool *pool; // The thread pool the chunks are scanned by.
+    pieceTable *table; // The contents being scanned. Must not be written to while the scan is running.
+    int minimum; // Characters a run needs.
+    printableRuns runs; // The runs found so far, in order.
+    pthread_mutex_t lock; // Protects runs and scanned.
+    pthread_t thread; // The background thread.
+    unsigned long int scanned; // The number of positions scanned so far.
+    int full; // Whether the scan stopped because PRINTABLE_LIST_LIMIT runs were found.
+    volatile int cancelled; // Set to stop the scan.
+    volatile int running; // Cleared once the scan has finished or stopped.
+} printableList;
+
+// Adds a run to the end of a list.
+// runs: pointer to the list.
+// run: the run.
+void addPrintableRun(printableRuns *runs, printableRun *run)
+{
+    if (runs->count == runs->capacity)
+    {
+        runs->capacity = runs->capacity ? runs->capacity * 2 : 64;
+        runs->runs = (printableRun *)realloc(runs->runs, sizeof(printableRun) * runs->capacity);
+    }
+    runs->runs[runs->count++] = *run;
+}
+
+// Frees the runs of a list, leaving it empty.
+// runs: pointer to the list.
+void clearPrintableRuns(printableRuns *runs)
+{
+    free(runs->runs);
+    runs->runs = NULL;
+    runs->count = 0;
+    runs->capacity = 0;
+}
+
+// Works out the masks of a word of bytes one byte at a time. Only available in scope of printables.c
+// bytes: the bytes of the word.
+// length: the number of bytes, up to 64. The bits past it are left clear.
+// printable: set to the mask of the bytes that are printable.
+// zeros: set to the mask of the bytes that are zero.
+static void maskPrintableWord(unsigned char *bytes, unsigned long int length, unsigned long int *printable, unsigned long int *zeros)
+{
+    *printable = 0;
+    *zeros = 0;
+    for (unsigned long int i = 0; i < length; i++)
+    {
+        *printable |= (unsigned long int)((bytes[i] >= 32 && bytes[i] <= 126) || bytes[i] == '\t') << i;
+        *zeros |= (unsigned long int)(bytes[i] == 0) << i;
+    }
+}
+
+#ifdef PRINTABLE_X86
+// Works out the masks of whole words of bytes 16 bytes at a time. Only available in scope of printables.c
+// bytes: the bytes.
+// words: the number of words of 64 bytes.
+// printable: set to the masks of the bytes that are printable, a word each.
+// zeros: set to the masks of the bytes that are zero, a word each.
+static void maskPrintablesSse2(unsigned char *bytes, unsigned long int words, unsigned long int *printable, unsigned long int *zeros)
+{
+    const __m128i low = _mm_set1_epi8(31);
+    const __m128i high = _mm_set1_epi8(127);
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i zero = _mm_setzero_si128();
+
+    for (unsigned long int word = 0; word < words; word++, bytes += 64)
+    {
+        unsigned long int printableMask = 0; // The printable bytes of the word so far.
+        unsigned long int zeroMask = 0; // The zero bytes of the word so far.
+        for (int i = 0; i < 4; i++)
+        {
+            // Bytes past 127 compare as negative, so they fall below 31.
+            __m128i data = _mm_loadu_si128((__m128i *)(bytes + i * 16));
+            __m128i range = _mm_and_si128(_mm_cmpgt_epi8(data, low), _mm_cmplt_epi8(data, high));
+            printableMask |= (unsigned long int)(unsigned int)_mm_movemask_epi8(_mm_or_si128(range, _mm_cmpeq_epi8(data, tab))) << (i * 16);
+            zeroMask |= (unsigned long int)(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(data, zero)) << (i * 16);
+        }
+        printable[word] = printableMask;
+        zeros[word] = zeroMask;
+    }
+}
+
+// Works out the masks of whole words of bytes 32 bytes at a time. Only available in scope of printables.c
+// bytes: the bytes.
+// words: the number of words of 64 bytes.
+// printable: set to the masks of the bytes that are printable, a word each.
+// zeros: set to the masks of the bytes that are zero, a word each.
+__attribute__((target("avx2")))
+static void maskPrintablesAvx2(unsigned char *bytes, unsigned long int words, unsigned long int *printable, unsigned long int *zeros)
+{
+    const __m256i low = _mm256_set1_epi8(31);
+    const __m256i high = _mm256_set1_epi8(127);
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i zero = _mm256_setzero_si256();
+
+    for (unsigned long int word = 0; word < words; word++, bytes += 64)
+    {
+        __m256i first = _mm256_loadu_si256((__m256i *)bytes);
+        __m256i second = _mm256_loadu_si256((__m256i *)(bytes + 32));
+
+        // Bytes past 127 compare as negative, so they fall below 31.
+        __m256i firstRange = _mm256_and_si256(_mm256_cmpgt_epi8(first, low), _mm256_cmpgt_epi8(high, first));
+        __m256i secondRange = _mm256_and_si256(_mm256_cmpgt_epi8(second, low), _mm256_cmpgt_epi8(high, second));
+        unsigned int firstPrintable = _mm256_movemask_epi8(_mm256_or_si256(firstRange, _mm256_cmpeq_epi8(first, tab)));
+        unsigned int secondPrintable = _mm256_movemask_epi8(_mm256_or_si256(secondRange, _mm256_cmpeq_epi8(second, tab)));
+        printable[word] = firstPrintable | (unsigned long int)secondPrintable << 32;
+
+        unsigned int firstZeros = _mm256_movemask_epi8(_mm256_cmpeq_epi8(first, zero));
+        unsigned int secondZeros = _mm256_movemask_epi8(_mm256_cmpeq_epi8(second, zero));
+        zeros[word] = firstZeros | (unsigned long int)secondZeros << 32;
+    }
+}
+#endif
+
+// Works out the masks of a block of bytes, 64 bytes to a word. Only available in scope of printables.c
+// bytes: the bytes of the block.
+// length: the number of bytes. The bits of the last word past it are left clear.
+// printable: set to the masks of the bytes that are printable, a word each.
+// zeros: set to the masks of the bytes that are zero, a word each.
+static void maskPrintables(unsigned char *bytes, unsigned long int length, unsigned long int *printable, unsigned long int *zeros)
+{
+    unsigned long int words = length / 64; // The number of full words.
+
+#ifdef PRINTABLE_X86
+    static int avx2 = -1; // Whether the processor supports AVX2, checked on first use.
+    if (avx2 == -1)
+    {
+        __builtin_cpu_init();
+        avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+
+    if (avx2)
+    {
+        maskPrintablesAvx2(bytes, words, printable, zeros);
+    }
+    else
+    {
+        maskPrintablesSse2(bytes, words, printable, zeros);
+    }
+#else
+    for (unsigned long int word = 0; word < words; word++)
+    {
+        maskPrintableWord(bytes + word * 64, 64, &printable[word], &zeros[word]);
+    }
+#endif
+
+    if (length % 64)
+    {
+        maskPrintableWord(bytes + words * 64, length % 64, &printable[words], &zeros[words]);
+    }
+}
+
+// Ends the open run of a stream, and keeps it if it is long enough and started in the chunk. Only available in scope
+// of printables.c
+// stream: pointer to the stream.
+// end: one past the last byte of the run.
+// start: the first position of the chunk.
+// minimum: characters a run needs.
+// runs: pointer to the list the run is added to.
+static void closePrintableRun(printableStream *stream, unsigned long int end, unsigned long int start, int minimum, printableRuns *runs)
+{
+    unsigned long int length = (end - stream->start) / stream->stride; // The number of characters.
+    stream->open = 0;
+    if (stream->start >= start && length >= (unsigned long int)minimum)
+    {
+        printableRun run = { stream->start, length < 0xffffffffUL ? length : 0xffffffffUL, stream->stride == 2 };
+        addPrintableRun(runs, &run);
+    }
+}
+
+// Reads the runs of a stream off one word of its mask. Only available in scope of printables.c
+// stream: pointer to the stream, which keeps a run open from one word to the next.
+// mask: the positions of the word that hold a character of the stream.
+// offset: the position of the first byte of the word.
+// start: the first position of the chunk.
+// end: one past the last position of the chunk. No run is opened past it.
+// minimum: characters a run needs.
+// runs: pointer to the list the runs are added to.
+static void scanPrintableWord(printableStream *stream, unsigned long int mask, unsigned long int offset, unsigned long int start,
+                              unsigned long int end, int minimum, printableRuns *runs)
+{
+    mask &= stream->lanes;
+
+    // Narrow the mask to the positions that start enough characters in a row to be worth opening a run at. Positions
+    // near the end of the word count the characters past it as present, as they may be. The first of these positions
+    // after a gap always starts a run: if the character before it were present, so would its own bit be.
+    int filter = minimum < PRINTABLE_FILTER ? minimum : PRINTABLE_FILTER; // Characters in a row looked for.
+    unsigned long int candidates = mask; // The positions that may start a run long enough.
+    for (int i = 1; i < filter; i++)
+    {
+        int shift = i * stream->stride; // Bits to the character i along.
+        candidates &= (mask >> shift) | ~(~0UL >> shift);
+    }
+
+    int position = 0; // The first bit of the word not yet looked at.
+    while (position < 64)
+    {
+        if (stream->open)
+        {
+            // The run ends at the first gap in the stream, or carries on into the next word.
+            unsigned long int gaps = ~mask & stream->lanes & (~0UL << position);
+            if (gaps == 0)
+            {
+                return;
+            }
+            int gap = __builtin_ctzl(gaps); // The bit of the first gap.
+            closePrintableRun(stream, offset + gap, start, minimum, runs);
+            position = gap + 1;
+            if (position >= 64)
+            {
+                return;
+            }
+        }
+
+        unsigned long int starts = candidates & (~0UL << position); // The positions left that may start a run.
+        if (starts == 0)
+        {
+            return;
+        }
+        int first = __builtin_ctzl(starts); // The bit the run starts at.
+        if (offset + first >= end)
+        {
+            return;
+        }
+        stream->open = 1;
+        stream->start = offset + first;
+        position = first;
+    }
+}
+
+// Scans one chunk of a job. Run by the thread pool. Only available in scope of printables.c
+// argument: pointer to the job.
+// index: the number of the chunk.
+static void scanPrintableChunk(void *argument, unsigned long int index)
+{
+    printableJob *job = (printableJob *)argument;
+    pieceTable *table = job->table;
+    printableRuns *runs = &job->chunkRuns[index]; // The runs of the chunk.
+    unsigned long int start = job->from + index * PRINTABLE_CHUNK; // The first position of the chunk.
+    unsigned long int end = job->to - start < PRINTABLE_CHUNK ? job->to : start + PRINTABLE_CHUNK; // One past the last position.
+
+    // Streams of ASCII characters, and of UTF-16LE characters at even and odd positions of a word.
+    printableStream streams[3] = { { ~0UL, 1, 0, 0 }, { 0x5555555555555555UL, 2, 0, 0 }, { 0xAAAAAAAAAAAAAAAAUL, 2, 0, 0 } };
+
+    unsigned char *scratch = (unsigned char *)malloc(PRINTABLE_BLOCK + 1); // Buffer for blocks that span pieces.
+    unsigned long int printable[PRINTABLE_BLOCK / 64 + 1]; // The printable bytes of the block.
+    unsigned long int zeros[PRINTABLE_BLOCK / 64 + 1]; // The zero bytes of the block, and the byte after it.
+
+    // Start two bytes early, so that a run going on from before the chunk is seen to, and left to the chunk before.
+    unsigned long int offset = start >= 2 ? start - 2 : 0; // The first position of the block.
+    while (offset < table->size)
+    {
+        int open = streams[0].open || streams[1].open || streams[2].open; // Whether a run is still open.
+        if ((offset >= end && !open) || (job->cancelled && *job->cancelled))
+        {
+            break;
+        }
+
+        // The byte after the block is read with it, as the last UTF-16LE character of the block needs it.
+        unsigned long int length = table->size - offset < PRINTABLE_BLOCK ? table->size - offset : PRINTABLE_BLOCK; // Bytes in the block.
+        unsigned long int viewLength = offset + length < table->size ? length + 1 : length; // Bytes viewed.
+        unsigned char *bytes = viewPieceTable(table, offset, viewLength, scratch);
+        unsigned long int words = (length + 63) / 64; // Words of the block.
+        zeros[words] = 0;
+        maskPrintables(bytes, viewLength, printable, zeros);
+
+        for (unsigned long int word = 0; word < words; word++)
+        {
+            unsigned long int position = offset + word * 64; // The position of the first byte of the word.
+            if (position >= end && !streams[0].open && !streams[1].open && !streams[2].open)
+            {
+                break;
+            }
+
+            // A UTF-16LE character is a printable byte followed by a zero byte.
+            unsigned long int wide = printable[word] & ((zeros[word] >> 1) | (zeros[word + 1] << 63));
+            scanPrintableWord(&streams[0], printable[word], position, start, end, job->minimum, runs);
+            if (wide || streams[1].open || streams[2].open)
+            {
+                scanPrintableWord(&streams[1], wide, position, start, end, job->minimum, runs);
+                scanPrintableWord(&streams[2], wide, position, start, end, job->minimum, runs);
+            }
+        }
+
+        offset += length;
+    }
+
+    // Runs still open go on to the end of the contents.
+    if (offset >= table->size)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            if (streams[i].open)
+            {
+                closePrintableRun(&streams[i], table->size, start, job->minimum, runs);
+            }
+        }
+    }
+
+    free(scratch);
+}
+
+// Orders runs by their position. Only available in scope of printables.c
+// a: pointer to the first run.
+// b: pointer to the second run.
+//
+// Returns: less than, equal to or more than 0 as the first run starts before, with or after the second.
+static int comparePrintableRuns(const void *a, const void *b)
+{
+    unsigned long int first = ((printableRun *)a)->offset;
+    unsigned long int second = ((printableRun *)b)->offset;
+    return first < second ? -1 : first > second;
+}
+
+// Finds every run that starts within a segment of the contents, scanning chunks of it in parallel.
+// pool: the thread pool the chunks are scanned by.
+// table: pointer to the piece table.
+// minimum: characters a run needs.
+// from: the first position a run can start at. A run going on from before it is left out.
+// to: one past the last position a run can start at. The last runs are read past it to their end.
+// runs: pointer to the list the runs are added to, in order.
+// cancelled: stops the scan when set, leaving only some of the runs added. May be NULL.
+//
+// Returns: the number of runs added.
+unsigned long int findPrintablesParallel(threadPool *pool, pieceTable *table, int minimum, unsigned long int from, unsigned long int to,
+                                         printableRuns *runs, volatile int *cancelled)
+{
+    if (to > table->size)
+    {
+        to = table->size;
+    }
+    if (from >= to)
+    {
+        return 0;
+    }
+
+    unsigned long int chunkCount = (to - from + PRINTABLE_CHUNK - 1) / PRINTABLE_CHUNK; // The number of chunks.
+    printableJob job = { table, minimum, from, to, NULL, cancelled };
+    job.chunkRuns = (printableRuns *)calloc(chunkCount, sizeof(printableRuns));
+    runThreadPool(pool, scanPrintableChunk, &job, chunkCount);
+
+    // The streams of a chunk end their runs out of order, but chunks are in order, so sorting each one is enough.
+    unsigned long int added = 0; // The number of runs added.
+    for (unsigned long int i = 0; i < chunkCount; i++)
+    {
+        printableRuns *chunk = &job.chunkRuns[i]; // The runs of the chunk.
+        qsort(chunk->runs, chunk->count, sizeof(printableRun), comparePrintableRuns);
+        for (unsigned long int j = 0; j < chunk->count; j++)
+        {
+            addPrintableRun(runs, &chunk->runs[j]);
+        }
+        added += chunk->count;
+        clearPrintableRuns(chunk);
+    }
+    free(job.chunkRuns);
+
+    return added;
+}
+
+// Reads the characters of a run, leaving out the zero bytes of UTF-16LE characters.
+// table: pointer to the piece table.
+// run: the run.
+// skip: the number of characters of the run skipped.
+// characters: the buffer the characters are read to.
+// length: the most characters read.
+//
+// Returns: the number of characters read.
+unsigned long int readPrintableRun(pieceTable *table, printableRun *run, unsigned long int skip, char *characters, unsigned long int length)
+{
+    if (skip >= run->length)
+    {
+        return 0;
+    }
+    if (length > run->length - skip)
+    {
+        length = run->length - skip;
+    }
+
+    if (!run->wide)
+    {
+        readPieceTable(table, run->offset + skip, characters, length);
+        return length;
+    }
+
+    // The characters are read a block at a time, and the low byte of each is kept.
+    char wide[1024]; // The bytes of the characters being read.
+    for (unsigned long int done = 0; done < length; )
+    {
+        unsigned long int count = length - done < sizeof(wide) / 2 ? length - done : sizeof(wide) / 2; // Characters read.
+        readPieceTable(table, run->offset + (skip + done) * 2, wide, count * 2);
+        for (unsigned long int i = 0; i < count; i++)
+        {
+            characters[done + i] = wide[i * 2];
+        }
+        done += count;
+    }
+    return length;
+}
+
+// Writes the bytes of a buffer, however many write() takes at a time. Only available in scope of printables.c
+// fd: the file descriptor.
+// bytes: the bytes.
+// length: the number of bytes.
+//
+// Returns: 0 on success, -1 if they could not be written.
+static int writePrintableBytes(int fd, char *bytes, unsigned long int length)
+{
+    for (unsigned long int sent = 0; sent < length; )
+    {
+        ssize_t part = write(fd, bytes + sent, length - sent);
+        if (part <= 0)
+        {
+            return -1;
+        }
+        sent += part;
+    }
+    return 0;
+}
+
+// Writes every run in the contents, a line each: the offset of its first character in hexadecimal, A for ASCII or U for
+// UTF-16LE, and its characters.
+// pool: the thread pool the chunks are scanned by.
+// table: pointer to the piece table.
+// minimum: characters a run needs.
+// fd: the file descriptor the runs are written to.
+//
+// Returns: the number of runs written, or -1 if they could not be written.
+long int writePrintables(threadPool *pool, pieceTable *table, int minimum, int fd)
+{
+    unsigned long int step = (unsigned long int)pool->threadCount * 2 * PRINTABLE_CHUNK; // Positions scanned each pass.
+    printableRuns found = { NULL, 0, 0 }; // The runs of one pass.
+    char *output = (char *)malloc(PRINTABLE_OUTPUT); // The lines waiting to be written.
+    unsigned long int used = 0; // Bytes of output in use.
+    long int written = 0; // Runs written so far.
+
+    int failed = 0; // Whether the output could not be written.
+
+    for (unsigned long int offset = 0; offset < table->size && !failed; offset += step)
+    {
+        unsigned long int end = table->size - offset < step ? table->size : offset + step;
+        findPrintablesParallel(pool, table, minimum, offset, end, &found, NULL);
+
+        for (unsigned long int i = 0; i < found.count && !failed; i++)
+        {
+            printableRun *run = &found.runs[i];
+
+            // Write the lines so far once the start of another might not fit after them.
+            if (used + 64 > PRINTABLE_OUTPUT)
+            {
+                failed = writePrintableBytes(fd, output, used) == -1;
+                used = 0;
+            }
+            used += snprintf(output + used, 64, "0x%08lX %c ", run->offset, run->wide ? 'U' : 'A');
+
+            // Long runs are copied a part at a time, writing the output whenever it fills. Room is kept for the newline.
+            for (unsigned long int done = 0; done < run->length && !failed; )
+            {
+                unsigned long int count = readPrintableRun(table, run, done, output + used, PRINTABLE_OUTPUT - 1 - used); // Characters copied.
+                done += count;
+                used += count;
+                if (done < run->length)
+                {
+                    failed = writePrintableBytes(fd, output, used) == -1;
+                    used = 0;
+                }
+            }
+            output[used++] = '\n';
+            written++;
+        }
+
+        found.count = 0;
+    }
+
+    if (!failed && used)
+    {
+        failed = writePrintableBytes(fd, output, used) == -1;
+    }
+
+    free(output);
+    clearPrintableRuns(&found);
+    return failed ? -1 : written;
+}
+
+// Scans the contents a few chunks at a time, adding the runs to the shared list. Run by the background thread of a
+// list. Only available in scope of printables.c
+// argument: pointer to the list.
+//
+// Returns: NULL.
+static void *runPrintableList(void *argument)
+{
+    printableList *list = (printableList *)argument;
+    unsigned long int step = (unsigned long int)list->pool->threadCount * 2 * PRINTABLE_CHUNK; // Positions scanned each pass.
+    printableRuns found = { NULL, 0, 0 }; // The runs of one pass.
+
+    for (unsigned long int offset = 0; offset < list->table->size && !list->cancelled && !list->full; offset += step)
+    {
+        unsigned long int end = list->table->size - offset < step ? list->table->size : offset + step;
+        findPrintablesParallel(list->pool, list->table, list->minimum, offset, end, &found, &list->cancelled);
+
+        // The list stops growing at its limit, as a large file of binary data holds a great many short runs.
+        pthread_mutex_lock(&list->lock);
+        for (unsigned long int i = 0; i < found.count && !list->full; i++)
+        {
+            addPrintableRun(&list->runs, &found.runs[i]);
+            list->full = list->runs.count == PRINTABLE_LIST_LIMIT;
+        }
+        list->scanned = list->full ? list->runs.runs[list->runs.count - 1].offset : end;
+        pthread_mutex_unlock(&list->lock);
+
+        found.count = 0;
+    }
+
+    clearPrintableRuns(&found);
+    list->running = 0;
+    return NULL;
+}
+
+// Starts finding every run in the background.
+// pool: the thread pool the chunks are scanned by.
+// table: pointer to the piece table. Must not be written to until the scan is stopped.
+// minimum: characters a run needs.
+//
+// Returns: the list, which must be passed to stopPrintableList().
+printableList *startPrintableList(threadPool *pool, pieceTable *table, int minimum)
+{
+    printableList *obj = (printableList *)calloc(1, sizeof(printableList));
+    obj->pool = pool;
+    obj->table = table;
+    obj->minimum = minimum;
+    obj->running = 1;
+    pthread_mutex_init(&obj->lock, NULL);
+    pthread_create(&obj->thread, NULL, runPrintableList, obj);
+
+    return obj;
+}
+
+// Stops a scan if it is still running, and waits for its thread to finish. The runs found so far are kept.
+// list: pointer to the list.
+void cancelPrintableList(printableList *list)
+{
+    if (list == NULL || list->thread == 0)
+    {
+        return;
+    }
+
+    list->cancelled = 1;
+    pthread_join(list->thread, NULL);
+    list->thread = 0;
+}
+
+// Stops a scan and frees its list.
+// list: pointer to the list.
+void stopPrintableList(printableList *list)
+{
+    if (list == NULL)
+    {
+        return;
+    }
+
+    cancelPrintableList(list);
+    pthread_mutex_destroy(&list->lock);
+    clearPrintableRuns(&list->runs);
+    free(list);
+}
+
+// Gets the progress of a scan.
+// list: pointer to the list.
+// count: set to the number of runs found so far.
+// scanned: set to the number of positions scanned so far.
+void readPrintableList(printableList *list, unsigned long int *count, unsigned long int *scanned)
+{
+    pthread_mutex_lock(&list->lock);
+    *count = list->runs.count;
+    *scanned = list->scanned;
+    pthread_mutex_unlock(&list->lock);
+}
+
+// Gets a run of a list.
+// list: pointer to the list.
+// number: the number of the run, starting from 0.
+// run: set to the run.
+//
+// Returns: 1 if the list has the run yet, otherwise 0.
+int getPrintableRun(printableList *list, unsigned long int number, printableRun *run)
+{
+    pthread_mutex_lock(&list->lock);
+    int found = number < list->runs.count; // Whether the run has been found.
+    if (found)
+    {
+        *run = list->runs.runs[number];
+    }
+    pthread_mutex_unlock(&list->lock);
+    return found;
+}
+
+// Finds the run of a list covering a position, or the first run after it, using the runs found so far.
+// list: pointer to the list.
+// offset: the position.
+//
+// Returns: the number of the run, starting from 0, or the number of runs found so far if there is none.
+unsigned long int findPrintableRun(printableList *list, unsigned long int offset)
+{
+    pthread_mutex_lock(&list->lock);
+
+    // Binary search for the first run starting after offset, then step back to the run before it if that covers offset.
+    unsigned long int low = 0;
+    unsigned long int high = list->runs.count;
+    while (low < high)
+    {
+        unsigned long int middle = (low + high) / 2;
+        if (list->runs.runs[middle].offset <= offset)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    if (low > 0)
+    {
+        printableRun *before = &list->runs.runs[low - 1]; // The last run starting at or before offset.
+        if (before->offset + ((unsigned long int)before->length << before->wide) > offset)
+        {
+            low--;
+        }
+    }
+
+    pthread_mutex_unlock(&list->lock);
+    return low;
+}
+
+#endif
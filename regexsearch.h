@@ -0,0 +1,1143 @@
+//
+// hexeditor.c library file
+// regexsearch.c
+//
+// Provides regular expressions that are matched against raw bytes in linear time.
+//
+// Demonstration:
+//
+//   Expression:  v[0-9]+\.[0-9]+
+//   Contents:    00 00 76 31 2E 32 30 00 00         Matches the 5 bytes v1.20, from the 76 to the 30.
+//
+// Syntax, where . and sets match any byte, including 00 and bytes above 7F:
+//
+//   abc              The bytes 61 62 63.                  .            Any byte.
+//   [a-z_] [^0-9]    A byte in, or not in, a set.         \xHH         The byte HH, also inside a set.
+//   \d \w \s         Digits, word bytes, spaces.          \D \W \S     Any other byte.
+//   \n \r \t \0      Control bytes.                       \. \[ \\     The character itself.
+//   x* x+ x?         Repeats of x.                        x{m} x{m,} x{m,n}   Between m and n repeats of x.
+//   a|b  (ab)        Either side, and grouping.
+//
+// An expression is parsed into a tree and compiled into a nondeterministic automaton (Thompson's construction: a
+// state for each set of bytes, joined by splits), once forwards and once backwards. Neither is run by backtracking.
+// Each search turns them into deterministic automata lazily, working out a state and its transition on a byte only
+// when the contents first lead there, and caching it, so that once the states a pattern reaches have been seen, each
+// byte costs one table lookup. The cache has a fixed number of states, and is emptied and refilled if a pattern needs
+// more. Until a match could have started, the scan skips straight to the next byte a match can start with, with
+// memchr() if there is only one.
+//
+// Matches are leftmost-longest, and every match has a length, as expressions that can match no bytes (a*, ()) are
+// rejected. The forward automaton keeps the states it is in grouped by the position they started at, oldest first,
+// and drops every group behind the oldest one that reaches a match, so its scan ends at the end of the leftmost-longest
+// match. The backward automaton then runs back from that end to find where the match starts.
+//
+// Matches are looked for in blocks that overlap by REGEX_MAX_MATCH - 1 bytes (read top of search.h for more info), so
+// a match up to that long is always found in full. A longer match may be cut short where the block ends.
+//
+
+// Avoid redefinition errors during compilation
+#ifndef FILE_REGEXSEARCH_SEEN
+#define FILE_REGEXSEARCH_SEEN
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+
+#define REGEX_MAX_MATCH 4096 // Length up to which a match is always found in full.
+#define REGEX_MAX_STATES 16384 // Most states the automata of an expression may have.
+#define REGEX_MAX_REPEAT 1024 // Largest count of a repeat.
+#define REGEX_CACHE_STATES 1024 // Deterministic states cached by each automaton before the cache is emptied.
+#define REGEX_UNKNOWN -1 // A transition that has not been worked out yet.
+#define REGEX_SEPARATOR -1 // Ends a group in the contents of a deterministic state.
+
+// Flags of a deterministic state.
+#define REGEX_MATCHED 1 // A match has been reached, so no more start positions are followed.
+#define REGEX_ACCEPTING 2 // A match ends at the byte that led to the state.
+#define REGEX_DEAD 4 // No match can be reached from the state.
+
+enum RegexNodeType {regexBytes, regexConcat, regexAlternate, regexRepeat, regexEmpty};
+
+typedef struct regexNode
+{
+    enum RegexNodeType type; // The kind of node.
+    struct regexNode *left; // The first part of a concatenation or alternation, or the node repeated.
+    struct regexNode *right; // The second part of a concatenation or alternation.
+    int min; // The least number of repeats.
+    int max; // The most number of repeats, or -1 for no limit.
+    uint32_t set[8]; // The bytes matched, one bit each. Only used by regexBytes.
+    struct regexNode *next; // The next node allocated, so that every node can be freed.
+} regexNode;
+
+typedef struct
+{
+    char *position; // The next character of the expression.
+    regexNode *nodes; // Every node allocated, last first.
+    char *error; // Set to a description of the first error.
+    int errorLength; // The size of error.
+    int failed; // Set once an error has been found.
+} regexParser;
+
+enum RegexStateType {regexStateBytes, regexStateSplit, regexStateMatch};
+
+typedef struct
+{
+    enum RegexStateType type; // The kind of state.
+    int out; // The state after a byte in the set, or the first state of a split.
+    int out1; // The second state of a split.
+    uint32_t set[8]; // The bytes that lead to out. Only used by regexStateBytes.
+} regexState;
+
+typedef struct
+{
+    regexState *states; // The states of both automata, which share the match state.
+    int stateCount; // The number of states.
+    int stateCapacity; // Allocated number of states.
+    int forward; // The first state of the forward automaton.
+    int backward; // The first state of the backward automaton, which matches the bytes of a match in reverse.
+    uint32_t first[8]; // The bytes a match can start with.
+    int firstCount; // The number of bytes a match can start with.
+    int firstByte; // The byte a match starts with, if there is only one.
+} regexProgram;
+
+typedef struct
+{
+    regexProgram *program; // The automaton states are made from.
+    int start; // The first state of the automaton.
+    int grouped; // Whether a group of states is started at every position (forward), rather than only the first.
+    int *transitions; // The next state for each cached state and byte, or REGEX_UNKNOWN.
+    int *flags; // The flags of each cached state.
+    int *contentStart; // The position of the contents of each cached state.
+    int *contentLength; // The length of the contents of each cached state.
+    int *contents; // The automaton states of each cached state, as groups ended by REGEX_SEPARATOR.
+    int contentsUsed; // The number of ints used in contents.
+    int contentsCapacity; // Allocated number of ints in contents.
+    int count; // The number of cached states.
+    int flushes; // The number of times the cache has been emptied.
+    int startState; // The cached state a scan starts in, or -1 if it has not been added since the cache was emptied.
+    int *table; // Hash table of the cached states, -1 where empty.
+    int *marks; // The step each automaton state was last added in, so that it is only added once.
+    int mark; // The current step.
+    int *stack; // Scratch for following splits.
+    int *current; // Scratch for the contents of the state being stepped from.
+    int *build; // Scratch for the contents of the state being stepped to.
+} regexDfa;
+
+typedef struct
+{
+    regexDfa forward; // Finds the end of the leftmost-longest match.
+    regexDfa backward; // Finds the start of a match from its end.
+} regexMatcher;
+
+// Adds a byte to a set. Only available in scope of regexsearch.c
+// set: the set.
+// byte: the byte.
+static void addRegexByte(uint32_t *set, int byte)
+{
+    set[byte >> 5] |= 1u << (byte & 31);
+}
+
+// Adds a range of bytes to a set. Only available in scope of regexsearch.c
+// set: the set.
+// low: the first byte.
+// high: the last byte.
+static void addRegexRange(uint32_t *set, int low, int high)
+{
+    for (int byte = low; byte <= high; byte++)
+    {
+        addRegexByte(set, byte);
+    }
+}
+
+// Records the first error found while parsing. Only available in scope of regexsearch.c
+// parser: pointer to the parser.
+// message: the description of the error.
+static void failRegex(regexParser *parser, char *message)
+{
+    if (!parser->failed)
+    {
+        snprintf(parser->error, parser->errorLength, "%s", message);
+        parser->failed = 1;
+    }
+}
+
+// Allocates a node of the tree. Only available in scope of regexsearch.c
+// parser: pointer to the parser, which frees the node.
+// type: the kind of node.
+// left: the first part or the node repeated, or NULL.
+// right: the second part, or NULL.
+//
+// Returns: the node.
+static regexNode *buildRegexNode(regexParser *parser, enum RegexNodeType type, regexNode *left, regexNode *right)
+{
+    regexNode *obj = (regexNode *)calloc(1, sizeof(regexNode));
+    obj->type = type;
+    obj->left = left;
+    obj->right = right;
+    obj->next = parser->nodes;
+    parser->nodes = obj;
+    return obj;
+}
+
+// Converts a hexadecimal digit. Only available in scope of regexsearch.c
+// c: the digit.
+//
+// Returns: the value of the digit, or -1 if it is not one.
+static int convertRegexDigit(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// Parses an escape, after its backslash. Only available in scope of regexsearch.c
+// parser: pointer to the parser.
+// set: the set the bytes of the escape are added to.
+//
+// Returns: the byte of the escape, -1 if it stands for a class of bytes, or -2 if it is not valid.
+static int parseRegexEscape(regexParser *parser, uint32_t *set)
+{
+    char c = *parser->position++;
+    uint32_t class[8] = {0}; // The bytes of a class.
+    int negated = c == 'D' || c == 'W' || c == 'S'; // Whether the class is every byte not listed.
+
+    switch (c)
+    {
+        case '\0':
+            parser->position--;
+            failRegex(parser, "\\ at the end of the expression");
+            return -2;
+        case 'x':
+        {
+            int high = convertRegexDigit(parser->position[0]); // The first digit.
+            int low = high == -1 ? -1 : convertRegexDigit(parser->position[1]); // The second digit.
+            if (low == -1)
+            {
+                failRegex(parser, "\\x must be followed by 2 hexadecimal digits");
+                return -2;
+            }
+            parser->position += 2;
+            addRegexByte(set, high << 4 | low);
+            return high << 4 | low;
+        }
+        case 'n':
+            addRegexByte(set, '\n');
+            return '\n';
+        case 'r':
+            addRegexByte(set, '\r');
+            return '\r';
+        case 't':
+            addRegexByte(set, '\t');
+            return '\t';
+        case '0':
+            addRegexByte(set, 0);
+            return 0;
+        case 'd':
+        case 'D':
+            addRegexRange(class, '0', '9');
+            break;
+        case 'w':
+        case 'W':
+            addRegexRange(class, '0', '9');
+            addRegexRange(class, 'A', 'Z');
+            addRegexRange(class, 'a', 'z');
+            addRegexByte(class, '_');
+            break;
+        case 's':
+        case 'S':
+            addRegexRange(class, '\t', '\r');
+            addRegexByte(class, ' ');
+            break;
+        default:
+            // Letters and digits are kept for escapes that may be added, anything else stands for itself.
+            if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z'))
+            {
+                failRegex(parser, "unknown escape");
+                return -2;
+            }
+            addRegexByte(set, (unsigned char)c);
+            return (unsigned char)c;
+    }
+
+    for (int i = 0; i < 8; i++)
+    {
+        set[i] |= negated ? ~class[i] : class[i];
+    }
+    return -1;
+}
+
+// Parses a set of bytes, after its [. Only available in scope of regexsearch.c
+// parser: pointer to the parser.
+// set: the set the bytes are added to.
+static void parseRegexSet(regexParser *parser, uint32_t *set)
+{
+    uint32_t listed[8] = {0}; // The bytes listed.
+    int negated = *parser->position == '^'; // Whether the set is every byte not listed.
+    if (negated)
+    {
+        parser->position++;
+    }
+
+    // A ] straight after the [ is listed rather than ending the set.
+    for (int first = 1; *parser->position && (*parser->position != ']' || first); first = 0)
+    {
+        int low = (unsigned char)*parser->position++; // The byte, or the first byte of a range.
+        if (low == '\\')
+        {
+            low = parseRegexEscape(parser, listed);
+            if (low < 0)
+            {
+                if (low == -2)
+                {
+                    return;
+                }
+                continue;
+            }
+        }
+
+        if (parser->position[0] != '-' || parser->position[1] == ']' || parser->position[1] == '\0')
+        {
+            addRegexByte(listed, low);
+            continue;
+        }
+
+        parser->position++;
+        int high = (unsigned char)*parser->position++; // The last byte of the range.
+        if (high == '\\')
+        {
+            uint32_t ignored[8] = {0}; // The escape is added as a range instead.
+            high = parseRegexEscape(parser, ignored);
+            if (high == -1)
+            {
+                failRegex(parser, "a range cannot end with a class");
+            }
+            if (high < 0)
+            {
+                return;
+            }
+        }
+        if (high < low)
+        {
+            failRegex(parser, "range out of order");
+            return;
+        }
+        addRegexRange(listed, low, high);
+    }
+
+    if (*parser->position != ']')
+    {
+        failRegex(parser, "missing ]");
+        return;
+    }
+    parser->position++;
+
+    for (int i = 0; i < 8; i++)
+    {
+        set[i] |= negated ? ~listed[i] : listed[i];
+    }
+}
+
+static regexNode *parseRegexAlternation(regexParser *parser);
+
+// Parses a byte, set, escape or group. Only available in scope of regexsearch.c
+// parser: pointer to the parser.
+//
+// Returns: the node, or NULL if it is not valid.
+static regexNode *parseRegexAtom(regexParser *parser)
+{
+    char c = *parser->position;
+
+    if (c == '(')
+    {
+        parser->position++;
+        regexNode *group = parseRegexAlternation(parser);
+        if (parser->failed)
+        {
+            return NULL;
+        }
+        if (*parser->position != ')')
+        {
+            failRegex(parser, "missing )");
+            return NULL;
+        }
+        parser->position++;
+        return group;
+    }
+    if (c == '*' || c == '+' || c == '?' || c == '{')
+    {
+        failRegex(parser, "nothing to repeat");
+        return NULL;
+    }
+    if (c == '^' || c == '$')
+    {
+        failRegex(parser, "anchors are not supported, use \\^ or \\$ for the character");
+        return NULL;
+    }
+
+    regexNode *obj = buildRegexNode(parser, regexBytes, NULL, NULL);
+    parser->position++;
+    if (c == '[')
+    {
+        parseRegexSet(parser, obj->set);
+    }
+    else if (c == '.')
+    {
+        memset(obj->set, 0xff, sizeof(obj->set));
+    }
+    else if (c == '\\')
+    {
+        parseRegexEscape(parser, obj->set);
+    }
+    else
+    {
+        addRegexByte(obj->set, (unsigned char)c);
+    }
+
+    return parser->failed ? NULL : obj;
+}
+
+// Parses a number of a repeat. Only available in scope of regexsearch.c
+// parser: pointer to the parser.
+//
+// Returns: the number, or -1 if there is no number.
+static int parseRegexCount(regexParser *parser)
+{
+    if (*parser->position < '0' || *parser->position > '9')
+    {
+        return -1;
+    }
+
+    int count = 0; // The number so far, held at one past the limit so that it cannot overflow.
+    while (*parser->position >= '0' && *parser->position <= '9')
+    {
+        count = count * 10 + *parser->position++ - '0';
+        if (count > REGEX_MAX_REPEAT)
+        {
+            count = REGEX_MAX_REPEAT + 1;
+        }
+    }
+    return count;
+}
+
+// Parses an atom and the repeats after it. Only available in scope of regexsearch.c
+// parser: pointer to the parser.
+//
+// Returns: the node, or NULL if it is not valid.
+static regexNode *parseRegexRepeat(regexParser *parser)
+{
+    regexNode *obj = parseRegexAtom(parser);
+
+    while (!parser->failed)
+    {
+        int min; // The least number of repeats.
+        int max; // The most number of repeats, or -1 for no limit.
+        char c = *parser->position;
+
+        if (c == '*' || c == '+' || c == '?')
+        {
+            min = c == '+' ? 1 : 0;
+            max = c == '?' ? 1 : -1;
+            parser->position++;
+        }
+        else if (c == '{')
+        {
+            parser->position++;
+            min = parseRegexCount(parser);
+            max = min;
+            if (*parser->position == ',')
+            {
+                parser->position++;
+                max = parseRegexCount(parser);
+            }
+            if (min == -1 || *parser->position != '}')
+            {
+                failRegex(parser, "a repeat must be {m}, {m,} or {m,n}");
+                return NULL;
+            }
+            parser->position++;
+            if (min > REGEX_MAX_REPEAT || max > REGEX_MAX_REPEAT)
+            {
+                failRegex(parser, "repeat count too large");
+                return NULL;
+            }
+            if (max != -1 && max < min)
+            {
+                failRegex(parser, "repeat range out of order");
+                return NULL;
+            }
+        }
+        else
+        {
+            break;
+        }
+
+        obj = buildRegexNode(parser, regexRepeat, obj, NULL);
+        obj->min = min;
+        obj->max = max;
+    }
+
+    return parser->failed ? NULL : obj;
+}
+
+// Parses the atoms up to the next | or ). Only available in scope of regexsearch.c
+// parser: pointer to the parser.
+//
+// Returns: the node, or NULL if it is not valid.
+static regexNode *parseRegexConcat(regexParser *parser)
+{
+    regexNode *obj = NULL;
+
+    while (*parser->position && *parser->position != '|' && *parser->position != ')')
+    {
+        regexNode *atom = parseRegexRepeat(parser);
+        if (parser->failed)
+        {
+            return NULL;
+        }
+        obj = obj ? buildRegexNode(parser, regexConcat, obj, atom) : atom;
+    }
+
+    return obj ? obj : buildRegexNode(parser, regexEmpty, NULL, NULL);
+}
+
+// Parses alternatives separated by |. Only available in scope of regexsearch.c
+// parser: pointer to the parser.
+//
+// Returns: the node, or NULL if it is not valid.
+static regexNode *parseRegexAlternation(regexParser *parser)
+{
+    regexNode *obj = parseRegexConcat(parser);
+
+    while (!parser->failed && *parser->position == '|')
+    {
+        parser->position++;
+        regexNode *right = parseRegexConcat(parser);
+        obj = parser->failed ? NULL : buildRegexNode(parser, regexAlternate, obj, right);
+    }
+
+    return obj;
+}
+
+// Finds whether a node can match no bytes. Only available in scope of regexsearch.c
+// node: the node.
+//
+// Returns: 1 if it can, otherwise 0.
+static int matchesRegexEmpty(regexNode *node)
+{
+    switch (node->type)
+    {
+        case regexBytes:
+            return 0;
+        case regexConcat:
+            return matchesRegexEmpty(node->left) && matchesRegexEmpty(node->right);
+        case regexAlternate:
+            return matchesRegexEmpty(node->left) || matchesRegexEmpty(node->right);
+        case regexRepeat:
+            return node->min == 0 || matchesRegexEmpty(node->left);
+        default:
+            return 1;
+    }
+}
+
+// Adds a state to a program. Only available in scope of regexsearch.c
+// program: pointer to the program.
+// type: the kind of state.
+// out: the next state, or the first state of a split.
+// out1: the second state of a split.
+// set: the bytes that lead to out, or NULL.
+//
+// Returns: the number of the state, or -1 if the program has too many states.
+static int addRegexState(regexProgram *program, enum RegexStateType type, int out, int out1, uint32_t *set)
+{
+    if (program->stateCount == REGEX_MAX_STATES)
+    {
+        return -1;
+    }
+    if (program->stateCount == program->stateCapacity)
+    {
+        program->stateCapacity = program->stateCapacity ? program->stateCapacity * 2 : 64;
+        program->states = (regexState *)realloc(program->states, sizeof(regexState) * program->stateCapacity);
+    }
+
+    regexState *state = &program->states[program->stateCount]; // The new state.
+    state->type = type;
+    state->out = out;
+    state->out1 = out1;
+    if (set)
+    {
+        memcpy(state->set, set, sizeof(state->set));
+    }
+    return program->stateCount++;
+}
+
+// Compiles a node into states that lead to a state once it has matched. Only available in scope of regexsearch.c
+// program: pointer to the program.
+// node: the node.
+// reversed: whether the states match the bytes of the node in reverse.
+// next: the state after the node, or -1 if the program already has too many states.
+//
+// Returns: the first state of the node, or -1 if the program has too many states.
+static int compileRegexNode(regexProgram *program, regexNode *node, int reversed, int next)
+{
+    if (next == -1)
+    {
+        return -1;
+    }
+
+    switch (node->type)
+    {
+        case regexBytes:
+            return addRegexState(program, regexStateBytes, next, -1, node->set);
+        case regexConcat:
+            if (reversed)
+            {
+                return compileRegexNode(program, node->right, 1, compileRegexNode(program, node->left, 1, next));
+            }
+            return compileRegexNode(program, node->left, 0, compileRegexNode(program, node->right, 0, next));
+        case regexAlternate:
+        {
+            int left = compileRegexNode(program, node->left, reversed, next); // The first state of the first side.
+            int right = compileRegexNode(program, node->right, reversed, next); // The first state of the second side.
+            return left == -1 || right == -1 ? -1 : addRegexState(program, regexStateSplit, left, right, NULL);
+        }
+        case regexRepeat:
+        {
+            int first = next; // The first state of the repeats compiled so far, which are compiled last first.
+
+            if (node->max == -1)
+            {
+                // A loop that either matches the node again or leaves.
+                int loop = addRegexState(program, regexStateSplit, -1, next, NULL); // The split of the loop.
+                int body = compileRegexNode(program, node->left, reversed, loop); // The first state of the node.
+                if (loop == -1 || body == -1)
+                {
+                    return -1;
+                }
+                program->states[loop].out = body;
+                first = loop;
+            }
+
+            // Optional repeats, each of which may skip the rest: (x(x)?)?
+            for (int i = node->min; i < node->max && first != -1; i++)
+            {
+                int body = compileRegexNode(program, node->left, reversed, first); // The first state of the repeat.
+                first = body == -1 ? -1 : addRegexState(program, regexStateSplit, body, next, NULL);
+            }
+
+            for (int i = 0; i < node->min && first != -1; i++)
+            {
+                first = compileRegexNode(program, node->left, reversed, first);
+            }
+            return first;
+        }
+        default:
+            return next;
+    }
+}
+
+// Finds the bytes a match can start with, by following the splits from the first state of the forward automaton.
+// Only available in scope of regexsearch.c
+// program: pointer to the program.
+static void findRegexFirstBytes(regexProgram *program)
+{
+    char *seen = (char *)calloc(program->stateCount, 1); // Whether each state has been reached.
+    int *stack = (int *)malloc(sizeof(int) * program->stateCount * 2); // The states left to follow.
+    int depth = 0; // The number of states on the stack.
+    stack[depth++] = program->forward;
+
+    while (depth > 0)
+    {
+        int next = stack[--depth]; // The state being followed.
+        if (seen[next])
+        {
+            continue;
+        }
+        seen[next] = 1;
+
+        regexState *state = &program->states[next];
+        if (state->type == regexStateSplit)
+        {
+            stack[depth++] = state->out;
+            stack[depth++] = state->out1;
+        }
+        for (int i = 0; state->type == regexStateBytes && i < 8; i++)
+        {
+            program->first[i] |= state->set[i];
+        }
+    }
+
+    for (int byte = 0; byte < 256; byte++)
+    {
+        if (program->first[byte >> 5] & 1u << (byte & 31))
+        {
+            program->firstCount++;
+            program->firstByte = byte;
+        }
+    }
+
+    free(seen);
+    free(stack);
+}
+
+// Free a program.
+// program: pointer to the program.
+void freeRegex(regexProgram *program)
+{
+    if (program == NULL)
+    {
+        return;
+    }
+
+    free(program->states);
+    free(program);
+}
+
+// Compiles a regular expression.
+// expression: the text of the expression.
+// error: set to a description of what is wrong with the expression, if it is not valid.
+// errorLength: the size of error.
+//
+// Returns: the compiled expression, or NULL if it is not valid.
+regexProgram *compileRegex(char *expression, char *error, int errorLength)
+{
+    regexParser parser = { expression, NULL, error, errorLength, 0 };
+    regexNode *root = parseRegexAlternation(&parser);
+    if (!parser.failed && *parser.position == ')')
+    {
+        failRegex(&parser, "unmatched )");
+    }
+    if (!parser.failed && matchesRegexEmpty(root))
+    {
+        failRegex(&parser, "the expression can match no bytes");
+    }
+
+    regexProgram *obj = NULL;
+    if (!parser.failed)
+    {
+        obj = (regexProgram *)calloc(1, sizeof(regexProgram));
+        int match = addRegexState(obj, regexStateMatch, -1, -1, NULL); // The state both automata end in.
+        obj->forward = compileRegexNode(obj, root, 0, match);
+        obj->backward = compileRegexNode(obj, root, 1, match);
+        if (obj->forward == -1 || obj->backward == -1)
+        {
+            failRegex(&parser, "the expression is too large");
+            freeRegex(obj);
+            obj = NULL;
+        }
+        else
+        {
+            findRegexFirstBytes(obj);
+        }
+    }
+
+    while (parser.nodes)
+    {
+        regexNode *next = parser.nodes->next;
+        free(parser.nodes);
+        parser.nodes = next;
+    }
+    return obj;
+}
+
+// Empties the cache of an automaton. Only available in scope of regexsearch.c
+// dfa: pointer to the automaton.
+static void emptyRegexDfa(regexDfa *dfa)
+{
+    dfa->count = 0;
+    dfa->contentsUsed = 0;
+    dfa->flushes++;
+    dfa->startState = -1;
+    memset(dfa->table, 0xff, sizeof(int) * REGEX_CACHE_STATES * 2);
+}
+
+// Sets up an automaton with an empty cache. Only available in scope of regexsearch.c
+// dfa: pointer to the automaton.
+// program: pointer to the program.
+// start: the first state of the automaton.
+// grouped: whether a group of states is started at every position.
+static void initRegexDfa(regexDfa *dfa, regexProgram *program, int start, int grouped)
+{
+    memset(dfa, 0, sizeof(regexDfa));
+    dfa->program = program;
+    dfa->start = start;
+    dfa->grouped = grouped;
+    dfa->transitions = (int *)malloc(sizeof(int) * REGEX_CACHE_STATES * 256);
+    dfa->flags = (int *)malloc(sizeof(int) * REGEX_CACHE_STATES);
+    dfa->contentStart = (int *)malloc(sizeof(int) * REGEX_CACHE_STATES);
+    dfa->contentLength = (int *)malloc(sizeof(int) * REGEX_CACHE_STATES);
+    dfa->table = (int *)malloc(sizeof(int) * REGEX_CACHE_STATES * 2);
+    dfa->marks = (int *)calloc(program->stateCount, sizeof(int));
+
+    // Groups are never empty and never share states, so there are at most two ints for each state.
+    dfa->stack = (int *)malloc(sizeof(int) * program->stateCount * 2);
+    dfa->current = (int *)malloc(sizeof(int) * program->stateCount * 2);
+    dfa->build = (int *)malloc(sizeof(int) * program->stateCount * 2);
+    emptyRegexDfa(dfa);
+}
+
+// Frees the cache of an automaton. Only available in scope of regexsearch.c
+// dfa: pointer to the automaton.
+static void freeRegexDfa(regexDfa *dfa)
+{
+    free(dfa->transitions);
+    free(dfa->flags);
+    free(dfa->contentStart);
+    free(dfa->contentLength);
+    free(dfa->contents);
+    free(dfa->table);
+    free(dfa->marks);
+    free(dfa->stack);
+    free(dfa->current);
+    free(dfa->build);
+}
+
+// Finds a state in the cache, adding it if it is not there. Adding a state to a full cache empties it first.
+// Only available in scope of regexsearch.c
+// dfa: pointer to the automaton.
+// content: the groups of the state.
+// length: the number of ints in content.
+// flags: the flags of the state.
+//
+// Returns: the number of the state.
+static int internRegexDfa(regexDfa *dfa, int *content, int length, int flags)
+{
+    uint32_t hash = 2166136261u ^ flags; // FNV-1a of the flags and contents.
+    for (int i = 0; i < length; i++)
+    {
+        hash = (hash ^ (uint32_t)content[i]) * 16777619u;
+    }
+
+    unsigned int mask = REGEX_CACHE_STATES * 2 - 1; // The table is a power of two in size.
+    unsigned int slot = hash & mask; // The slot being checked.
+    for (; dfa->table[slot] != -1; slot = (slot + 1) & mask)
+    {
+        int state = dfa->table[slot];
+        if (dfa->flags[state] == flags && dfa->contentLength[state] == length &&
+            memcmp(dfa->contents + dfa->contentStart[state], content, sizeof(int) * length) == 0)
+        {
+            return state;
+        }
+    }
+
+    if (dfa->count == REGEX_CACHE_STATES)
+    {
+        emptyRegexDfa(dfa);
+        for (slot = hash & mask; dfa->table[slot] != -1; slot = (slot + 1) & mask);
+    }
+    if (dfa->contentsUsed + length > dfa->contentsCapacity)
+    {
+        while (dfa->contentsUsed + length > dfa->contentsCapacity)
+        {
+            dfa->contentsCapacity = dfa->contentsCapacity ? dfa->contentsCapacity * 2 : 4096;
+        }
+        dfa->contents = (int *)realloc(dfa->contents, sizeof(int) * dfa->contentsCapacity);
+    }
+
+    int state = dfa->count++; // The new state.
+    memcpy(dfa->contents + dfa->contentsUsed, content, sizeof(int) * length);
+    dfa->contentStart[state] = dfa->contentsUsed;
+    dfa->contentLength[state] = length;
+    dfa->contentsUsed += length;
+    dfa->flags[state] = flags;
+    memset(dfa->transitions + state * 256, 0xff, sizeof(int) * 256);
+    dfa->table[slot] = state;
+    return state;
+}
+
+// Starts a new step, in which each automaton state can be added once. Only available in scope of regexsearch.c
+// dfa: pointer to the automaton.
+static void markRegexDfa(regexDfa *dfa)
+{
+    if (dfa->mark == INT_MAX)
+    {
+        memset(dfa->marks, 0, sizeof(int) * dfa->program->stateCount);
+        dfa->mark = 0;
+    }
+    dfa->mark++;
+}
+
+// Adds a state and every state its splits lead to, leaving out any added already in this step, to the contents being
+// built. Only splits are followed, so only states that match bytes and the match state are added.
+// Only available in scope of regexsearch.c
+// dfa: pointer to the automaton.
+// state: the state.
+// length: the number of ints built so far, moved past the states added.
+static void addRegexDfaState(regexDfa *dfa, int state, int *length)
+{
+    int depth = 0; // The number of states on the stack.
+    dfa->stack[depth++] = state;
+
+    while (depth > 0)
+    {
+        int next = dfa->stack[--depth]; // The state being added.
+        if (dfa->marks[next] == dfa->mark)
+        {
+            continue;
+        }
+        dfa->marks[next] = dfa->mark;
+
+        regexState *added = &dfa->program->states[next];
+        if (added->type == regexStateSplit)
+        {
+            dfa->stack[depth++] = added->out1;
+            dfa->stack[depth++] = added->out;
+        }
+        else
+        {
+            dfa->build[(*length)++] = next;
+        }
+    }
+}
+
+// Compares two ints for qsort(). Only available in scope of regexsearch.c
+static int compareRegexStates(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+// Ends the group being built, dropping it if it is empty. The states of a group are sorted, so that the same group is
+// always the same contents. Only available in scope of regexsearch.c
+// dfa: pointer to the automaton.
+// groupStart: the position of the group in the contents being built.
+// length: the number of ints built so far, moved past the end of the group.
+static void endRegexDfaGroup(regexDfa *dfa, int groupStart, int *length)
+{
+    if (*length > groupStart)
+    {
+        qsort(dfa->build + groupStart, *length - groupStart, sizeof(int), compareRegexStates);
+        dfa->build[(*length)++] = REGEX_SEPARATOR;
+    }
+}
+
+// Adds the contents being built to the cache, after dropping every group behind the first that has reached the match
+// state. Only available in scope of regexsearch.c
+// dfa: pointer to the automaton.
+// length: the number of ints built.
+// flags: the flags of the state stepped from, of which only REGEX_MATCHED is kept.
+//
+// Returns: the number of the state.
+static int finishRegexDfaState(regexDfa *dfa, int length, int flags)
+{
+    flags &= REGEX_MATCHED;
+
+    int accepting = 0; // Whether the group being checked has reached the match state.
+    for (int i = 0; i < length; i++)
+    {
+        if (dfa->build[i] == REGEX_SEPARATOR && accepting)
+        {
+            length = i + 1;
+            flags |= REGEX_MATCHED | REGEX_ACCEPTING;
+            break;
+        }
+        accepting = accepting || (dfa->build[i] != REGEX_SEPARATOR && dfa->program->states[dfa->build[i]].type == regexStateMatch);
+    }
+    if (length == 0)
+    {
+        flags |= REGEX_DEAD;
+    }
+
+    return internRegexDfa(dfa, dfa->build, length, flags);
+}
+
+// Finds the state an automaton starts a scan in. Only available in scope of regexsearch.c
+// dfa: pointer to the automaton.
+//
+// Returns: the number of the state.
+static int startRegexDfa(regexDfa *dfa)
+{
+    if (dfa->startState == -1)
+    {
+        int length = 0; // The number of ints built.
+        markRegexDfa(dfa);
+        addRegexDfaState(dfa, dfa->start, &length);
+        endRegexDfaGroup(dfa, 0, &length);
+        dfa->startState = finishRegexDfaState(dfa, length, 0);
+    }
+    return dfa->startState;
+}
+
+// Finds the next byte a match can start with. Only available in scope of regexsearch.c
+// program: pointer to the program.
+// bytes: the bytes being scanned.
+// length: the number of bytes.
+//
+// Returns: the position of the byte, or length if there is none.
+static unsigned long int skipRegexStart(regexProgram *program, unsigned char *bytes, unsigned long int length)
+{
+    if (program->firstCount == 1)
+    {
+        unsigned char *found = memchr(bytes, program->firstByte, length);
+        return found ? (unsigned long int)(found - bytes) : length;
+    }
+
+    unsigned long int position = 0; // The byte being checked.
+    while (position < length && !(program->first[bytes[position] >> 5] & 1u << (bytes[position] & 31)))
+    {
+        position++;
+    }
+    return position;
+}
+
+// Works out the transition of a state on a byte, and caches it. Only available in scope of regexsearch.c
+// dfa: pointer to the automaton.
+// state: the state.
+// byte: the byte.
+//
+// Returns: the number of the state the byte leads to.
+static int stepRegexDfa(regexDfa *dfa, int state, int byte)
+{
+    // Adding the next state may empty the cache, so the contents of this one are copied out first.
+    int currentLength = dfa->contentLength[state]; // The number of ints in the state.
+    int flags = dfa->flags[state]; // The flags of the state.
+    memcpy(dfa->current, dfa->contents + dfa->contentStart[state], sizeof(int) * currentLength);
+
+    // Each group moves on by the byte, in order, so a state reached by an earlier group is not added by a later one.
+    int length = 0; // The number of ints built.
+    markRegexDfa(dfa);
+    for (int i = 0; i < currentLength; i++)
+    {
+        int groupStart = length; // The position of the group being built.
+        for (; dfa->current[i] != REGEX_SEPARATOR; i++)
+        {
+            regexState *from = &dfa->program->states[dfa->current[i]];
+            if (from->type == regexStateBytes && from->set[byte >> 5] & 1u << (byte & 31))
+            {
+                addRegexDfaState(dfa, from->out, &length);
+            }
+        }
+        endRegexDfaGroup(dfa, groupStart, &length);
+    }
+
+    // A match found makes any later start too late to be leftmost.
+    if (dfa->grouped && !(flags & REGEX_MATCHED))
+    {
+        int groupStart = length; // The position of the new group.
+        addRegexDfaState(dfa, dfa->start, &length);
+        endRegexDfaGroup(dfa, groupStart, &length);
+    }
+
+    int flushes = dfa->flushes; // Whether the cache is emptied, and the state with it.
+    int next = finishRegexDfaState(dfa, length, flags);
+    if (flushes == dfa->flushes)
+    {
+        dfa->transitions[state * 256 + byte] = next;
+    }
+    return next;
+}
+
+// Generate a matcher, which holds the caches of the automata of an expression. Each thread searching needs its own.
+// program: pointer to the compiled expression.
+//
+// Returns: the generated matcher.
+regexMatcher *buildRegexMatcher(regexProgram *program)
+{
+    regexMatcher *obj = (regexMatcher *)malloc(sizeof(regexMatcher));
+    initRegexDfa(&obj->forward, program, program->forward, 1);
+    initRegexDfa(&obj->backward, program, program->backward, 0);
+    return obj;
+}
+
+// Free a matcher.
+// matcher: pointer to the matcher.
+void freeRegexMatcher(regexMatcher *matcher)
+{
+    if (matcher == NULL)
+    {
+        return;
+    }
+
+    freeRegexDfa(&matcher->forward);
+    freeRegexDfa(&matcher->backward);
+    free(matcher);
+}
+
+// Finds the leftmost-longest match of an expression that starts within a block.
+// matcher: pointer to the matcher.
+// block: the block being searched.
+// length: the length of the block, including any bytes after the last start that a match may cover.
+// starts: the number of positions at the start of the block a match can start at.
+// end: set to the position one past the end of the match.
+//
+// Returns: the position of the match in the block, or -1.
+long int findRegexInBlock(regexMatcher *matcher, unsigned char *block, unsigned long int length, unsigned long int starts, unsigned long int *end)
+{
+    regexDfa *dfa = &matcher->forward; // The automaton being run.
+    int *transitions = dfa->transitions; // The cached transitions, which never move.
+    int *flags = dfa->flags; // The flags of the cached states, which never move.
+    long int matchEnd = -1; // One past the end of the match so far.
+
+    // Most bytes lead to a state with no flags, so only one test is made for them. In the state a scan starts in, no
+    // match has started, and any byte a match cannot start with leads back to it.
+    int state = startRegexDfa(dfa); // The state after the bytes scanned so far.
+    for (unsigned long int i = 0; i < length; i++)
+    {
+        if (state == dfa->startState)
+        {
+            i += skipRegexStart(dfa->program, block + i, length - i);
+            if (i == length)
+            {
+                break;
+            }
+        }
+
+        int next = transitions[state * 256 + block[i]];
+        state = next != REGEX_UNKNOWN ? next : stepRegexDfa(dfa, state, block[i]);
+
+        if (flags[state])
+        {
+            if (flags[state] & REGEX_ACCEPTING)
+            {
+                matchEnd = i + 1;
+            }
+            if (flags[state] & REGEX_DEAD)
+            {
+                break;
+            }
+        }
+    }
+    if (matchEnd == -1)
+    {
+        return -1;
+    }
+
+    // The longest match back from the end starts at the leftmost start, as an earlier one would have been leftmost.
+    dfa = &matcher->backward;
+    transitions = dfa->transitions;
+    flags = dfa->flags;
+    long int matchStart = matchEnd; // The start of the longest match back from the end so far.
+    state = startRegexDfa(dfa);
+    for (long int i = matchEnd - 1; i >= 0; i--)
+    {
+        int next = transitions[state * 256 + block[i]];
+        state = next != REGEX_UNKNOWN ? next : stepRegexDfa(dfa, state, block[i]);
+
+        if (flags[state] & REGEX_ACCEPTING)
+        {
+            matchStart = i;
+        }
+        if (flags[state] & REGEX_DEAD)
+        {
+            break;
+        }
+    }
+
+    if ((unsigned long int)matchStart >= starts)
+    {
+        return -1;
+    }
+    *end = matchEnd;
+    return matchStart;
+}
+
+#endif
@@ -0,0 +1,235 @@
+//
+// hexeditor.c library file
+// savefile.c
+//
+// Provides logic for writing the contents of a piece table to the real file.
+//
+// There are two ways of saving:
+//
+//   In place:  Only the dirty ranges of the piece table are written, straight into the original file with pwritev(),
+//              followed by a single fsync(). A one byte change costs one small write, no matter how large the file is.
+//              No bytes may have been inserted or deleted, even if the size is the same again. Dirty ranges separated
+//              by a short unchanged gap are written as one range, the gap being rewritten with the bytes it already
+//              holds, so that a batch of many small nearby edits costs few writes.
+//
+//   Atomic:    The whole contents are streamed into a new file next to the original, which is synced and renamed over
+//              the original. Used when bytes have been inserted or deleted, as the original can then not be patched.
+//              The original file map refers to the replaced file afterwards, so the file must be loaded again.
+//
+
+// Avoid redefinition errors during compilation
+#ifndef FILE_SAVEFILE_SEEN
+#define FILE_SAVEFILE_SEEN
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "filemap.h"
+#include "piecetable.h"
+
+#define SAVEFILE_BLOCK 1048576 // Size of the blocks the contents are streamed in when saving atomically.
+#define SAVEFILE_GAP 512 // Longest unchanged gap between dirty ranges that is rewritten instead of starting a new range.
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+typedef struct
+{
+    unsigned long int bytesWritten; // Bytes written to the file.
+    unsigned long int rangesWritten; // Contiguous ranges written to the file.
+    unsigned long int writeCalls; // Calls made to write the ranges.
+} saveStats;
+
+// Writes a list of vectors to a contiguous range of a file, retrying partial writes. Only available in scope of savefile.c
+// fd: the file descriptor to write to.
+// vectors: the vectors to write. They are modified as they are written.
+// count: the number of vectors.
+// offset: the start position of the range in the file.
+// stats: statistics that are added to.
+//
+// Returns: 0 on success, -1 if the file could not be written to.
+static int writeVectors(int fd, struct iovec *vectors, int count, unsigned long int offset, saveStats *stats)
+{
+    while (count > 0)
+    {
+        int batch = count < IOV_MAX ? count : IOV_MAX; // Vectors written by this call.
+        ssize_t written = pwritev(fd, vectors, batch, offset);
+        if (written <= 0)
+        {
+            return -1;
+        }
+
+        stats->writeCalls++;
+        stats->bytesWritten += written;
+        offset += written;
+
+        // Skip the vectors that were fully written and move into any partially written one.
+        while (count > 0 && (size_t)written >= vectors->iov_len)
+        {
+            written -= vectors->iov_len;
+            vectors++;
+            count--;
+        }
+        if (count > 0)
+        {
+            vectors->iov_base = (char *)vectors->iov_base + written;
+            vectors->iov_len -= written;
+        }
+    }
+
+    return 0;
+}
+
+// Writes the dirty ranges of a piece table into the original file, then resets the piece table to refer to it.
+// table: pointer to the piece table.
+// stats: statistics about the save. May be NULL.
+//
+// Returns: 0 on success, -1 if the file could not be written to or bytes have been inserted or deleted.
+int saveFileInPlace(pieceTable *table, saveStats *stats)
+{
+    saveStats ignored; // Used if no statistics were asked for.
+    if (stats == NULL)
+    {
+        stats = &ignored;
+    }
+    memset(stats, 0, sizeof(saveStats));
+
+    fileMap *original = table->original;
+    if (!original->writable || original->mode == fileBuffered || table->size != original->size || table->shifted)
+    {
+        return -1;
+    }
+
+    struct iovec *vectors = NULL; // Vectors of the range being written.
+    int capacity = 0; // Allocated number of vectors.
+    int result = 0;
+
+    for (int i = 0; i < table->dirtyCount && result == 0; i++)
+    {
+        unsigned long int start = table->dirty[i].start;
+        unsigned long int end = table->dirty[i].end;
+        while (i + 1 < table->dirtyCount && table->dirty[i + 1].start - end <= SAVEFILE_GAP)
+        {
+            end = table->dirty[++i].end;
+        }
+        unsigned long int length = end - start;
+        int count = gatherPieceTable(table, start, length, &vectors, &capacity);
+
+        if (count == -1)
+        {
+            // The range cannot be viewed in place, so copy it instead.
+            unsigned char *copy = (unsigned char *)malloc(length);
+            readPieceTable(table, start, copy, length);
+            struct iovec single = { copy, length };
+            result = writeVectors(original->fd, &single, 1, start, stats);
+            free(copy);
+        }
+        else
+        {
+            result = writeVectors(original->fd, vectors, count, start, stats);
+        }
+
+        stats->rangesWritten++;
+    }
+    free(vectors);
+
+    if (result == 0 && table->dirtyCount > 0)
+    {
+        result = fsync(original->fd);
+    }
+
+    // The original file now matches the contents, and any cached pages of it are out of date.
+    if (result == 0)
+    {
+        resetPieceTable(table);
+        if (table->cache)
+        {
+            invalidateBlockCache(table->cache);
+        }
+    }
+
+    return result;
+}
+
+// Writes the whole contents of a piece table into a new file and renames it over the real file.
+// table: pointer to the piece table.
+// fileName: the location of the real file.
+// stats: statistics about the save. May be NULL.
+//
+// Returns: 0 on success, -1 if the file could not be written to. The real file is untouched on failure.
+int saveFileAtomic(pieceTable *table, char *fileName, saveStats *stats)
+{
+    saveStats ignored; // Used if no statistics were asked for.
+    if (stats == NULL)
+    {
+        stats = &ignored;
+    }
+    memset(stats, 0, sizeof(saveStats));
+
+    // Create the new file in the same directory, so that it can be renamed over the real file.
+    char tempName[PATH_MAX];
+    snprintf(tempName, PATH_MAX, "%s.save-XXXXXX", fileName);
+    int fd = mkstemp(tempName);
+    if (fd == -1)
+    {
+        return -1;
+    }
+
+    // Keep the permissions of the real file.
+    struct stat info;
+    if (fstat(table->original->fd, &info) == 0)
+    {
+        fchmod(fd, info.st_mode & 07777);
+    }
+
+    unsigned char *scratch = (unsigned char *)malloc(SAVEFILE_BLOCK); // Blocks that span pieces are copied here.
+    int result = 0;
+
+    // Stream the contents in blocks.
+    for (unsigned long int offset = 0; offset < table->size && result == 0; offset += SAVEFILE_BLOCK)
+    {
+        unsigned long int length = table->size - offset < SAVEFILE_BLOCK ? table->size - offset : SAVEFILE_BLOCK;
+        struct iovec block = { viewPieceTable(table, offset, length, scratch), length };
+        result = writeVectors(fd, &block, 1, offset, stats);
+    }
+    free(scratch);
+    stats->rangesWritten = 1;
+
+    if (result == 0)
+    {
+        result = fsync(fd);
+    }
+    close(fd);
+
+    if (result == 0)
+    {
+        result = rename(tempName, fileName);
+    }
+    if (result != 0)
+    {
+        unlink(tempName);
+        return -1;
+    }
+
+    // Sync the directory so that the rename itself survives a crash.
+    char directoryName[PATH_MAX];
+    snprintf(directoryName, PATH_MAX, "%s", fileName);
+    int directory = open(dirname(directoryName), O_RDONLY);
+    if (directory != -1)
+    {
+        fsync(directory);
+        close(directory);
+    }
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,337 @@
+//
+// hexeditor.c library file
+// screen.c
+//
+// Provides a model of the terminal screen, so that only the parts of a frame that changed are written.
+//
+// Demonstration:
+//
+//   Frame:     "\033[10;3H\033[30;47mAB\033[0;0m CD"
+//
+//   Cells:     row 10  | A | B |   | C | D |        Each cell holds a character and a style. Styles are the SGR
+//                        1   1   0   0   0          escape codes in effect, stored once in a table and referred to
+//                                                   by their number.
+//   Styles:    0 = ""
+//              1 = "\033[30;47m"
+//
+// Frames are still built with the frame buffer (read top of frame.h for more info). Instead of being written as they
+// are, they are played into a grid of cells, the same way a terminal would play them, and compared with the cells of
+// the previous frame. Only the cells that differ are written, each run after a single cursor movement. Moving the
+// cursor one byte to the right changes the style of four cells, so it costs tens of bytes instead of a whole frame.
+//
+// Anything drawn to the terminal outside of the model, such as an input prompt, must be followed by
+// invalidateScreen(), so that the next frame is written in full.
+//
+
+// Avoid redefinition errors during compilation
+#ifndef FILE_SCREEN_SEEN
+#define FILE_SCREEN_SEEN
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "consoleutils.h"
+#include "textutils.h"
+#include "frame.h"
+
+#define SCREEN_MAX_STYLES 256 // Most distinct styles a screen can hold.
+#define SCREEN_STYLE_LENGTH 64 // Longest combination of escape codes a style can be made from.
+#define SCREEN_MAX_GAP 4 // Longest run of unchanged cells that is rewritten instead of moved over.
+
+typedef struct
+{
+    unsigned char character; // The character shown in the cell.
+    unsigned char style; // The number of the style the character is shown in.
+} screenCell;
+
+typedef struct
+{
+    int width; // The number of columns.
+    int height; // The number of rows.
+    screenCell *cells; // The cells of the frame being played, row by row.
+    screenCell *shown; // The cells the terminal is showing.
+    int valid; // Whether shown matches the terminal.
+    char *styles[SCREEN_MAX_STYLES]; // The escape codes of each style, which are applied after a reset.
+    int styleCount; // The number of styles.
+    frameBuffer *output; // The changes written to the terminal.
+} screenModel;
+
+// Allocates the cells for the size of the terminal. Only available in scope of screen.c
+// screen: pointer to the screen.
+static void sizeScreen(screenModel *screen)
+{
+    screen->width = w.ws_col > 0 ? w.ws_col : 1;
+    screen->height = w.ws_row > 0 ? w.ws_row : 1;
+
+    free(screen->cells);
+    free(screen->shown);
+    screen->cells = (screenCell *)calloc((long int)screen->width * screen->height, sizeof(screenCell));
+    screen->shown = (screenCell *)calloc((long int)screen->width * screen->height, sizeof(screenCell));
+    screen->valid = 0;
+}
+
+// Generate a screen model for the current size of the terminal.
+//
+// Returns: the generated screen.
+screenModel *buildScreen()
+{
+    // Allocate memory for screen.
+    screenModel *obj = (screenModel *)calloc(1, sizeof(screenModel));
+
+    // Style 0 is the style after a reset.
+    obj->styles[0] = strdup("");
+    obj->styleCount = 1;
+    obj->output = buildFrame();
+    sizeScreen(obj);
+
+    return obj;
+}
+
+// Finds the number of a style, adding it to the table if it is new. Only available in scope of screen.c
+// screen: pointer to the screen.
+// style: the escape codes of the style.
+//
+// Returns: the number of the style, or 0 if the table is full.
+static int internScreenStyle(screenModel *screen, char *style)
+{
+    for (int i = 0; i < screen->styleCount; i++)
+    {
+        if (strcmp(screen->styles[i], style) == 0)
+        {
+            return i;
+        }
+    }
+
+    if (screen->styleCount == SCREEN_MAX_STYLES)
+    {
+        return 0;
+    }
+    screen->styles[screen->styleCount] = strdup(style);
+    return screen->styleCount++;
+}
+
+// Fills every cell of the frame being played with blanks. Only available in scope of screen.c
+// screen: pointer to the screen.
+// cells: the cells to fill.
+static void blankScreen(screenModel *screen, screenCell *cells)
+{
+    for (long int i = 0; i < (long int)screen->width * screen->height; i++)
+    {
+        cells[i].character = ' ';
+        cells[i].style = 0;
+    }
+}
+
+// Plays a frame into the cells, the way a terminal would. Escape codes that do not draw, such as hiding the cursor,
+// are copied to the output. Only available in scope of screen.c
+// screen: pointer to the screen.
+// frame: the frame.
+static void playScreenFrame(screenModel *screen, frameBuffer *frame)
+{
+    int column = 0; // Column of the cursor.
+    int row = 0; // Row of the cursor.
+    char style[SCREEN_STYLE_LENGTH] = ""; // Escape codes of the current style.
+    int styleNumber = 0; // Number of the current style.
+
+    for (unsigned long int i = 0; i < frame->length; i++)
+    {
+        unsigned char c = frame->data[i];
+
+        if (c == '\033' && i + 1 < frame->length && frame->data[i + 1] == '[')
+        {
+            // Find the end of the escape code.
+            unsigned long int start = i; // The escape character.
+            unsigned long int end = i + 2; // The final character.
+            while (end < frame->length && !(frame->data[end] >= 64 && frame->data[end] <= 126))
+            {
+                end++;
+            }
+            if (end == frame->length)
+            {
+                break;
+            }
+            i = end;
+
+            char *parameters = frame->data + start + 2; // The parameters of the escape code.
+            switch (frame->data[end])
+            {
+                case 'H': // Cursor position, numbered from 1, where 0 counts as 1.
+                    row = atoi(parameters);
+                    column = 0;
+                    for (char *p = parameters; p < frame->data + end; p++)
+                    {
+                        if (*p == ';')
+                        {
+                            column = atoi(p + 1);
+                            break;
+                        }
+                    }
+                    row = row > 0 ? row - 1 : 0;
+                    column = column > 0 ? column - 1 : 0;
+                    break;
+                case 'J': // Erase the screen.
+                    blankScreen(screen, screen->cells);
+                    break;
+                case 'm': // Select graphic rendition. A code that starts with a reset replaces the style.
+                {
+                    int length = end + 1 - start; // Length of the escape code.
+                    int used = parameters[0] == '0' || parameters[0] == 'm' ? 0 : strlen(style);
+                    if (strspn(parameters, "0;") == end - start - 2)
+                    {
+                        // Only a reset.
+                        style[0] = '\0';
+                    }
+                    else if (used + length < SCREEN_STYLE_LENGTH)
+                    {
+                        memcpy(style + used, frame->data + start, length);
+                        style[used + length] = '\0';
+                    }
+                    styleNumber = internScreenStyle(screen, style);
+                    break;
+                }
+                default:
+                    appendFrame(screen->output, frame->data + start, end + 1 - start);
+                    break;
+            }
+        }
+        else if (c == '\n')
+        {
+            column = 0;
+            row++;
+        }
+        else if (c == '\r')
+        {
+            column = 0;
+        }
+        else if (c >= 32)
+        {
+            // Characters past the edge of the screen are clipped.
+            if (column < screen->width && row < screen->height)
+            {
+                screenCell *cell = &screen->cells[(long int)row * screen->width + column];
+                cell->character = c;
+                cell->style = styleNumber;
+            }
+            column++;
+        }
+    }
+}
+
+// Marks the terminal as not matching the model, so that the next frame is written in full.
+// screen: pointer to the screen.
+void invalidateScreen(screenModel *screen)
+{
+    screen->valid = 0;
+}
+
+// Writes the cells of a frame that differ from the previous frame to the terminal, then empties the frame.
+// screen: pointer to the screen.
+// frame: the frame, built with the functions of frame.h.
+//
+// Returns: the number of bytes written to the terminal, or -1 if the terminal could not be written to.
+long int flushScreen(screenModel *screen, frameBuffer *frame)
+{
+    // A new terminal size starts from a blank model.
+    if (screen->width != w.ws_col || screen->height != w.ws_row)
+    {
+        sizeScreen(screen);
+    }
+
+    resetFrame(screen->output);
+    blankScreen(screen, screen->cells);
+    playScreenFrame(screen, frame);
+    resetFrame(frame);
+
+    // Clear the terminal if it does not match the model.
+    if (!screen->valid)
+    {
+        appendFrameText(screen->output, SGR_RESET "\033[1;1H\033[2J");
+        blankScreen(screen, screen->shown);
+        screen->valid = 1;
+    }
+
+    int cursorColumn = -1; // Column of the terminal cursor, or -1 if it is unknown.
+    int cursorRow = -1; // Row of the terminal cursor.
+    int cursorStyle = 0; // Style the terminal is drawing in.
+
+    for (int row = 0; row < screen->height; row++)
+    {
+        screenCell *cells = screen->cells + (long int)row * screen->width; // The cells of the row.
+        screenCell *shown = screen->shown + (long int)row * screen->width; // The cells shown on the row.
+
+        for (int column = 0; column < screen->width; column++)
+        {
+            if (cells[column].character == shown[column].character && cells[column].style == shown[column].style)
+            {
+                continue;
+            }
+
+            // Rewrite a short gap of unchanged cells in the current style rather than moving over it.
+            int gap = cursorRow == row && cursorColumn >= 0 ? column - cursorColumn : -1; // Unchanged cells skipped.
+            for (int i = cursorColumn; gap > 0 && gap <= SCREEN_MAX_GAP && i < column; i++)
+            {
+                if (cells[i].style != cursorStyle)
+                {
+                    gap = -1;
+                }
+            }
+            if (gap > 0 && gap <= SCREEN_MAX_GAP)
+            {
+                for (int i = cursorColumn; i < column; i++)
+                {
+                    appendFrame(screen->output, (char *)&cells[i].character, 1);
+                }
+            }
+            else if (gap != 0)
+            {
+                moveFrameCursor(screen->output, column + 1, row + 1);
+            }
+            if (cursorStyle != cells[column].style)
+            {
+                // Styles are applied after a reset, which is not needed if the terminal is already reset.
+                if (cursorStyle != 0 || cells[column].style == 0)
+                {
+                    appendFrameText(screen->output, SGR_RESET);
+                }
+                appendFrameText(screen->output, screen->styles[cells[column].style]);
+                cursorStyle = cells[column].style;
+            }
+            appendFrame(screen->output, (char *)&cells[column].character, 1);
+            shown[column] = cells[column];
+
+            // The cursor does not move past the last column.
+            cursorRow = row;
+            cursorColumn = column + 1 < screen->width ? column + 1 : -1;
+        }
+    }
+
+    if (cursorStyle != 0)
+    {
+        appendFrameText(screen->output, SGR_RESET);
+    }
+
+    long int written = screen->output->length; // The number of bytes of changes.
+    return flushFrame(screen->output) == 0 ? written : -1;
+}
+
+// Frees a screen model.
+// screen: pointer to the screen.
+void freeScreen(screenModel *screen)
+{
+    if (screen == NULL)
+    {
+        return;
+    }
+
+    for (int i = 0; i < screen->styleCount; i++)
+    {
+        free(screen->styles[i]);
+    }
+    freeFrame(screen->output);
+    free(screen->cells);
+    free(screen->shown);
+    free(screen);
+}
+
+#endif
@@ -0,0 +1,946 @@
+//
+// hexeditor.c library file
+// search.c
+//
+// Provides the byte search engine.
+//
+// The contents are scanned in large blocks viewed straight from the piece table. Consecutive blocks overlap by the
+// length of the pattern minus one, so that matches crossing the end of a block are still found. Within a block:
+//
+//   1 byte patterns:       memchr().
+//   With AVX2:             The first and last bytes of the pattern are compared against 32 positions at a time, and only
+//                          positions where both match are verified with memcmp(). This outruns Horspool at every length,
+//                          as the filter rarely lets a position through and the loads never depend on the data.
+//   Long patterns:         Boyer-Moore-Horspool, which skips up to the length of the pattern at a time.
+//   Short patterns:        memchr() finds the first byte, and memcmp() verifies the rest.
+//
+// Patterns are compared as raw bytes, so they may contain 0x00.
+//
+// Patterns may also be masked, so that only some bits of a byte have to match (DE ?? BE EF, or 4? for any byte whose
+// high nibble is 4). Masked patterns are matched at 32 positions at a time (16 without AVX2): each byte of the pattern
+// is ANDed with its mask and compared against the 32 bytes at that offset, and the results are ANDed together.
+// Fully specified bytes are compared first, so most positions are ruled out after one or two comparisons.
+//
+// Large searches are split into chunks that are searched in parallel by a thread pool (read top of threadpool.h for
+// more info). Like blocks, chunks overlap by the length of the pattern minus one, and only report matches that start
+// inside them. When only the first match is wanted, the lowest match found so far is shared between the chunks, and
+// any chunk (or block of a chunk) starting after it is skipped.
+//
+// Finding every match can also run in the background. A background thread hands the pool a few chunks at a time, in
+// order, and appends their matches to a shared list, so the list is always ordered and can be used while it grows.
+// The list holds at most SEARCH_LIST_LIMIT matches; the search stops once it is full.
+//
+// Patterns may also be regular expressions (read top of regexsearch.h for more info), which are searched for in the
+// same blocks and chunks, overlapping by the longest match that is always found in full. Their matches do not overlap:
+// the next match is looked for from the end of the last, and a match that runs into the next chunk hides the matches
+// of that chunk that start inside it.
+//
+// Parallel searches can be given an index of the file (read top of searchindex.h for more info), in which case each
+// block is narrowed to the runs of index blocks that could hold a match before it is scanned.
+//
+
+// Avoid redefinition errors during compilation
+#ifndef FILE_SEARCH_SEEN
+#define FILE_SEARCH_SEEN
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SEARCH_X86
+#endif
+
+#include "piecetable.h"
+#include "threadpool.h"
+#include "searchindex.h"
+#include "regexsearch.h"
+
+#define SEARCH_BLOCK 1048576 // Size of the blocks the contents are scanned in.
+#define SEARCH_CHUNK 16777216 // Size of the chunks the contents are split into for searching in parallel.
+#define SEARCH_MAX_PATTERN 256 // Longest pattern that can be searched for.
+#define SEARCH_LIST_LIMIT 4194304 // Most matches kept by a search for every match.
+#define SEARCH_LONG_PATTERN 16 // Length at which patterns are searched for with Boyer-Moore-Horspool without AVX2.
+
+typedef struct
+{
+    unsigned char *bytes; // The bytes being searched for, with any bits outside the mask cleared.
+    unsigned char *mask; // The bits of each byte that have to match, or NULL if every bit has to match.
+    int *order; // The positions of the bytes that are not fully masked out, most specific first. Only set with a mask.
+    int orderLength; // The number of positions in order.
+    int length; // The length of the pattern.
+    unsigned long int shift[256]; // Distance the pattern can move for each last byte of a window (Horspool).
+    unsigned int *grams; // The index bits of the runs of the pattern that are fully specified (see searchindex.h).
+    int gramCount; // The number of grams.
+    regexProgram *regex; // The regular expression, or NULL if the pattern is bytes.
+} searchPattern;
+
+typedef struct
+{
+    unsigned long int *offsets; // The positions of the matches, in order.
+    unsigned long int count; // The number of matches.
+    unsigned long int capacity; // Allocated number of positions.
+    unsigned long int reach; // The first position the next match can start at.
+} searchHits;
+
+typedef struct
+{
+    unsigned char *bytes; // Buffer for blocks that span pieces.
+    regexMatcher *matcher; // The automata of a regular expression, or NULL.
+} searchScratch;
+
+typedef struct
+{
+    pieceTable *table; // The contents being searched.
+    searchPattern *pattern; // The pattern being searched for.
+    searchIndex *index; // The index blocks are narrowed with, or NULL.
+    unsigned long int from; // The first position a match can start at.
+    unsigned long int to; // One past the last position a match can start at.
+    int collectAll; // Whether every match is collected, rather than just the first.
+    unsigned long int best; // The lowest match found so far, or to. Only used when collectAll is not set.
+    searchHits *chunkHits; // The matches found by each chunk. Only used when collectAll is set.
+    unsigned long int limit; // Most matches each chunk collects. Only used when collectAll is set.
+    volatile int *cancelled; // Stops the search when set. May be NULL.
+} searchJob;
+
+typedef struct
+{
+    threadPool *pool; // The thread pool the chunks are searched by.
+    pieceTable *table; // The contents being searched. Must not be written to while the search is running.
+    searchPattern *pattern; // The pattern being searched for.
+    searchIndex *index; // The index blocks are narrowed with, or NULL.
+    searchHits hits; // The matches found so far, in order.
+    pthread_mutex_t lock; // Protects hits and scanned.
+    pthread_t thread; // The background thread.
+    unsigned long int scanned; // The number of positions searched so far.
+    int full; // Whether the search stopped because SEARCH_LIST_LIMIT matches were found.
+    volatile int cancelled; // Set to stop the search.
+    volatile int running; // Cleared once the search has finished or stopped.
+} searchAll;
+
+// Generate a search pattern.
+// bytes: the bytes being searched for.
+// mask: the bits of each byte that have to match, or NULL if every bit has to match.
+// length: the number of bytes. Must be at least 1.
+//
+// Returns: the generated pattern.
+searchPattern *buildSearchPattern(unsigned char *bytes, unsigned char *mask, int length)
+{
+    // Allocate memory for pattern.
+    searchPattern *obj = (searchPattern *)calloc(1, sizeof(searchPattern));
+    obj->bytes = (unsigned char *)malloc(length);
+    memcpy(obj->bytes, bytes, length);
+    obj->length = length;
+
+    // A mask that keeps every bit is the same as no mask.
+    for (int i = 0; mask && i < length; i++)
+    {
+        if (mask[i] != 0xff)
+        {
+            obj->mask = (unsigned char *)malloc(length);
+            obj->order = (int *)malloc(sizeof(int) * length);
+            break;
+        }
+    }
+
+    if (obj->mask)
+    {
+        memcpy(obj->mask, mask, length);
+
+        for (int i = 0; i < length; i++)
+        {
+            obj->bytes[i] &= mask[i];
+        }
+
+        // Order the bytes by the number of bits they keep, leaving out bytes that keep none.
+        for (int bits = 8; bits > 0; bits--)
+        {
+            for (int i = 0; i < length; i++)
+            {
+                if (__builtin_popcount(mask[i]) == bits)
+                {
+                    obj->order[obj->orderLength++] = i;
+                }
+            }
+        }
+    }
+
+    // Any byte not in the pattern lets it move its whole length. Otherwise it moves to line up the last occurence.
+    for (int i = 0; i < 256; i++)
+    {
+        obj->shift[i] = length;
+    }
+    for (int i = 0; i < length - 1; i++)
+    {
+        obj->shift[bytes[i]] = length - 1 - i;
+    }
+
+    // Runs that are partly masked out could match bytes the index never saw as a run, so only whole runs are used.
+    obj->grams = (unsigned int *)malloc(sizeof(unsigned int) * length);
+    for (int i = 0; i + SEARCHINDEX_GRAM <= length; i++)
+    {
+        int whole = 1; // Whether every bit of the run has to match.
+        for (int j = i; obj->mask && j < i + SEARCHINDEX_GRAM; j++)
+        {
+            whole = whole && obj->mask[j] == 0xff;
+        }
+        if (whole)
+        {
+            uint32_t gram; // The run, first byte in the low bits.
+            memcpy(&gram, obj->bytes + i, SEARCHINDEX_GRAM);
+            obj->grams[obj->gramCount++] = hashSearchIndexGram(gram);
+        }
+    }
+
+    return obj;
+}
+
+// Generate a search pattern from a regular expression.
+// expression: the text of the expression.
+// error: set to a description of what is wrong with the expression, if it is not valid.
+// errorLength: the size of error.
+//
+// Returns: the generated pattern, or NULL if the expression is not valid.
+searchPattern *buildRegexSearchPattern(char *expression, char *error, int errorLength)
+{
+    regexProgram *regex = compileRegex(expression, error, errorLength);
+    if (regex == NULL)
+    {
+        return NULL;
+    }
+
+    // The length sets the overlap of blocks and chunks, so that matches up to that long are found in full.
+    searchPattern *obj = (searchPattern *)calloc(1, sizeof(searchPattern));
+    obj->regex = regex;
+    obj->length = REGEX_MAX_MATCH;
+    return obj;
+}
+
+// Free a search pattern.
+// pattern: pointer to the pattern.
+void freeSearchPattern(searchPattern *pattern)
+{
+    if (pattern == NULL)
+    {
+        return;
+    }
+
+    free(pattern->bytes);
+    free(pattern->mask);
+    free(pattern->order);
+    free(pattern->grams);
+    freeRegex(pattern->regex);
+    free(pattern);
+}
+
+// Searches a block by finding the first byte with memchr(). Only available in scope of search.c
+// pattern: the pattern.
+// block: the block being searched.
+// length: the length of the block.
+//
+// Returns: the position of the first match in the block, or -1.
+static long int findFirstByte(searchPattern *pattern, unsigned char *block, unsigned long int length)
+{
+    unsigned long int position = 0; // Where the next candidate is looked for from.
+    while (position + pattern->length <= length)
+    {
+        unsigned char *candidate = memchr(block + position, pattern->bytes[0], length - pattern->length + 1 - position);
+        if (candidate == NULL)
+        {
+            return -1;
+        }
+        if (!memcmp(candidate + 1, pattern->bytes + 1, pattern->length - 1))
+        {
+            return candidate - block;
+        }
+        position = candidate - block + 1;
+    }
+
+    return -1;
+}
+
+// Searches a block with Boyer-Moore-Horspool. Only available in scope of search.c
+// pattern: the pattern.
+// block: the block being searched.
+// length: the length of the block.
+//
+// Returns: the position of the first match in the block, or -1.
+static long int findHorspool(searchPattern *pattern, unsigned char *block, unsigned long int length)
+{
+    int last = pattern->length - 1; // Position of the last byte of the pattern.
+    unsigned char lastByte = pattern->bytes[last];
+
+    for (unsigned long int position = 0; position + pattern->length <= length; )
+    {
+        unsigned char c = block[position + last]; // Last byte of the window.
+        if (c == lastByte && !memcmp(block + position, pattern->bytes, last))
+        {
+            return position;
+        }
+        position += pattern->shift[c];
+    }
+
+    return -1;
+}
+
+// Checks whether a masked pattern matches at a position. Only available in scope of search.c
+// pattern: the pattern.
+// position: pointer to the bytes at the position. There must be at least pattern->length bytes.
+//
+// Returns: 1 if the pattern matches, otherwise 0.
+static int matchesMasked(searchPattern *pattern, unsigned char *position)
+{
+    for (int i = 0; i < pattern->orderLength; i++)
+    {
+        int j = pattern->order[i];
+        if ((position[j] & pattern->mask[j]) != pattern->bytes[j])
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+#ifdef SEARCH_X86
+// Searches a block for a masked pattern at 16 positions at a time. Only available in scope of search.c
+// pattern: the pattern. Must have a mask.
+// block: the block being searched.
+// length: the length of the block.
+//
+// Returns: the position of the first match in the block, or -1.
+static long int findMaskedSse2(searchPattern *pattern, unsigned char *block, unsigned long int length)
+{
+    unsigned long int position = 0; // The first position of the 16 being compared.
+
+    for (; position + pattern->length - 1 + 16 <= length; position += 16)
+    {
+        unsigned int matched = 0xffff; // The positions that still match.
+
+        // Rule out positions one byte of the pattern at a time, until none are left.
+        for (int i = 0; i < pattern->orderLength && matched; i++)
+        {
+            int j = pattern->order[i];
+            __m128i data = _mm_loadu_si128((__m128i *)(block + position + j));
+            __m128i masked = _mm_and_si128(data, _mm_set1_epi8(pattern->mask[j]));
+            matched &= _mm_movemask_epi8(_mm_cmpeq_epi8(masked, _mm_set1_epi8(pattern->bytes[j])));
+        }
+
+        if (matched)
+        {
+            return position + __builtin_ctz(matched);
+        }
+    }
+
+    // Check the rest of the block that is too short for a full comparison.
+    for (; position + pattern->length <= length; position++)
+    {
+        if (matchesMasked(pattern, block + position))
+        {
+            return position;
+        }
+    }
+
+    return -1;
+}
+
+// Searches a block for a masked pattern at 32 positions at a time. Only available in scope of search.c
+// pattern: the pattern. Must have a mask.
+// block: the block being searched.
+// length: the length of the block.
+//
+// Returns: the position of the first match in the block, or -1.
+__attribute__((target("avx2")))
+static long int findMaskedAvx2(searchPattern *pattern, unsigned char *block, unsigned long int length)
+{
+    unsigned long int position = 0; // The first position of the 32 being compared.
+
+    for (; position + pattern->length - 1 + 32 <= length; position += 32)
+    {
+        unsigned int matched = 0xffffffff; // The positions that still match.
+
+        // Rule out positions one byte of the pattern at a time, until none are left.
+        for (int i = 0; i < pattern->orderLength && matched; i++)
+        {
+            int j = pattern->order[i];
+            __m256i data = _mm256_loadu_si256((__m256i *)(block + position + j));
+            __m256i masked = _mm256_and_si256(data, _mm256_set1_epi8(pattern->mask[j]));
+            matched &= _mm256_movemask_epi8(_mm256_cmpeq_epi8(masked, _mm256_set1_epi8(pattern->bytes[j])));
+        }
+
+        if (matched)
+        {
+            return position + __builtin_ctz(matched);
+        }
+    }
+
+    // Search the rest of the block that is too short for a full comparison.
+    long int result = findMaskedSse2(pattern, block + position, length - position);
+    return result == -1 ? -1 : (long int)position + result;
+}
+
+// Searches a block by comparing the first and last byte of the pattern at 32 positions at a time. Only available in
+// scope of search.c
+// pattern: the pattern. Must be at least 2 bytes long.
+// block: the block being searched.
+// length: the length of the block.
+//
+// Returns: the position of the first match in the block, or -1.
+__attribute__((target("avx2")))
+static long int findFirstLastAvx2(searchPattern *pattern, unsigned char *block, unsigned long int length)
+{
+    int last = pattern->length - 1; // Position of the last byte of the pattern.
+    __m256i first = _mm256_set1_epi8(pattern->bytes[0]);
+    __m256i final = _mm256_set1_epi8(pattern->bytes[last]);
+    unsigned long int position = 0; // The first position of the 32 being compared.
+
+    for (; position + last + 32 <= length; position += 32)
+    {
+        __m256i firstBlock = _mm256_loadu_si256((__m256i *)(block + position));
+        __m256i finalBlock = _mm256_loadu_si256((__m256i *)(block + position + last));
+        unsigned int mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, firstBlock), _mm256_cmpeq_epi8(final, finalBlock)));
+
+        // Verify each position where both bytes matched.
+        while (mask)
+        {
+            int bit = __builtin_ctz(mask);
+            if (!memcmp(block + position + bit + 1, pattern->bytes + 1, last - 1))
+            {
+                return position + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    // Search the rest of the block that is too short for a full comparison.
+    long int result = findFirstByte(pattern, block + position, length - position);
+    return result == -1 ? -1 : (long int)position + result;
+}
+#endif
+
+// Searches a block of memory for a pattern.
+// pattern: the pattern.
+// block: the block being searched.
+// length: the length of the block.
+//
+// Returns: the position of the first match in the block, or -1.
+long int findInBlock(searchPattern *pattern, unsigned char *block, unsigned long int length)
+{
+    if (length < (unsigned long int)pattern->length)
+    {
+        return -1;
+    }
+
+#ifdef SEARCH_X86
+    static int avx2 = -1; // Whether the processor supports AVX2, checked on first use.
+    if (avx2 == -1)
+    {
+        __builtin_cpu_init();
+        avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+#endif
+
+    if (pattern->mask)
+    {
+#ifdef SEARCH_X86
+        return avx2 ? findMaskedAvx2(pattern, block, length) : findMaskedSse2(pattern, block, length);
+#else
+        for (unsigned long int position = 0; position + pattern->length <= length; position++)
+        {
+            if (matchesMasked(pattern, block + position))
+            {
+                return position;
+            }
+        }
+        return -1;
+#endif
+    }
+
+    if (pattern->length == 1)
+    {
+        unsigned char *match = memchr(block, pattern->bytes[0], length);
+        return match == NULL ? -1 : match - block;
+    }
+
+#ifdef SEARCH_X86
+    if (avx2)
+    {
+        return findFirstLastAvx2(pattern, block, length);
+    }
+#endif
+
+    if (pattern->length >= SEARCH_LONG_PATTERN)
+    {
+        return findHorspool(pattern, block, length);
+    }
+
+    return findFirstByte(pattern, block, length);
+}
+
+// Generate the scratch space a thread needs to search for a pattern.
+// pattern: the pattern.
+//
+// Returns: the generated scratch space.
+searchScratch *buildSearchScratch(searchPattern *pattern)
+{
+    searchScratch *obj = (searchScratch *)malloc(sizeof(searchScratch));
+    obj->bytes = (unsigned char *)malloc(SEARCH_BLOCK + pattern->length);
+    obj->matcher = pattern->regex ? buildRegexMatcher(pattern->regex) : NULL;
+    return obj;
+}
+
+// Free scratch space.
+// scratch: pointer to the scratch space.
+void freeSearchScratch(searchScratch *scratch)
+{
+    free(scratch->bytes);
+    freeRegexMatcher(scratch->matcher);
+    free(scratch);
+}
+
+// Finds the first match of a pattern that starts within a segment of the contents.
+// table: pointer to the piece table.
+// pattern: the pattern.
+// from: the first position a match can start at.
+// to: one past the last position a match can start at.
+// scratch: scratch space for the pattern, from buildSearchScratch().
+// result: set to the position of the match.
+// end: set to the position one past the end of the match. May be NULL.
+//
+// Returns: 1 if a match was found, otherwise 0.
+int findInRange(pieceTable *table, searchPattern *pattern, unsigned long int from, unsigned long int to, searchScratch *scratch, unsigned long int *result, unsigned long int *end)
+{
+    if (to > table->size)
+    {
+        to = table->size;
+    }
+
+    for (unsigned long int offset = from; offset < to; offset += SEARCH_BLOCK)
+    {
+        // Include the bytes after the block that a match starting in the block could cover.
+        unsigned long int starts = to - offset < SEARCH_BLOCK ? to - offset : SEARCH_BLOCK; // Positions a match can start at.
+        unsigned long int length = starts + pattern->length - 1; // Length of the block including the overlap.
+        if (length > table->size - offset)
+        {
+            length = table->size - offset;
+        }
+
+        unsigned char *block = viewPieceTable(table, offset, length, scratch->bytes); // The bytes of the block.
+        unsigned long int matchEnd = 0; // The end of the match in the block.
+        long int match; // The position of the match in the block.
+        if (pattern->regex)
+        {
+            match = findRegexInBlock(scratch->matcher, block, length, starts, &matchEnd);
+        }
+        else
+        {
+            match = findInBlock(pattern, block, length);
+            matchEnd = match + pattern->length;
+        }
+
+        if (match != -1 && (unsigned long int)match < starts)
+        {
+            *result = offset + match;
+            if (end)
+            {
+                *end = offset + matchEnd;
+            }
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// Adds a match to a list of matches.
+// hits: pointer to the list.
+// offset: the position of the match.
+void addSearchHit(searchHits *hits, unsigned long int offset)
+{
+    if (hits->count == hits->capacity)
+    {
+        hits->capacity = hits->capacity ? hits->capacity * 2 : 64;
+        hits->offsets = (unsigned long int *)realloc(hits->offsets, sizeof(unsigned long int) * hits->capacity);
+    }
+    hits->offsets[hits->count++] = offset;
+}
+
+// Frees the matches of a list, leaving it empty.
+// hits: pointer to the list.
+void clearSearchHits(searchHits *hits)
+{
+    free(hits->offsets);
+    hits->offsets = NULL;
+    hits->count = 0;
+    hits->capacity = 0;
+    hits->reach = 0;
+}
+
+// Finds where the match after a match is looked for from. Matches of bytes may overlap, so it is the next position,
+// but matches of a regular expression do not, so it is the end of the match.
+// table: pointer to the piece table.
+// pattern: the pattern.
+// match: the position of the match.
+//
+// Returns: the first position the next match can start at.
+unsigned long int nextSearchStart(pieceTable *table, searchPattern *pattern, unsigned long int match)
+{
+    if (pattern->regex == NULL)
+    {
+        return match + 1;
+    }
+
+    searchScratch *scratch = buildSearchScratch(pattern);
+    unsigned long int end = match + 1; // The end of the match.
+    findInRange(table, pattern, match, match + 1, scratch, &match, &end);
+    freeSearchScratch(scratch);
+    return end;
+}
+
+// Collects every match that starts within a block of a search job. The block is viewed once, and each match after the
+// first is looked for in the rest of the same view. Only available in scope of search.c
+// job: pointer to the search job.
+// hits: pointer to the list of matches of the chunk, whose reach is kept past the last match.
+// offset: the first position a match can start at.
+// blockEnd: one past the last position a match can start at. No further than SEARCH_BLOCK past offset.
+// scratch: scratch space for the pattern, from buildSearchScratch().
+static void collectInBlock(searchJob *job, searchHits *hits, unsigned long int offset, unsigned long int blockEnd, searchScratch *scratch)
+{
+    searchPattern *pattern = job->pattern;
+    unsigned long int starts = blockEnd - offset; // Positions a match can start at.
+    unsigned long int length = starts + pattern->length - 1; // Length of the block including the overlap.
+    if (length > job->table->size - offset)
+    {
+        length = job->table->size - offset;
+    }
+
+    unsigned char *block = viewPieceTable(job->table, offset, length, scratch->bytes); // The bytes of the block.
+    unsigned long int position = 0; // The first position in the block the next match can start at.
+    while (position < starts && hits->count < job->limit)
+    {
+        unsigned long int matchEnd = 0; // The end of the match, from position.
+        long int match; // The position of the match, from position.
+        if (pattern->regex)
+        {
+            match = findRegexInBlock(scratch->matcher, block + position, length - position, starts - position, &matchEnd);
+        }
+        else
+        {
+            match = findInBlock(pattern, block + position, length - position);
+            matchEnd = match + pattern->length;
+        }
+
+        if (match == -1 || position + match >= starts)
+        {
+            return;
+        }
+        addSearchHit(hits, offset + position + match);
+        position += pattern->regex ? matchEnd : (unsigned long int)match + 1;
+        hits->reach = offset + position;
+    }
+}
+
+// Searches one chunk of a search job. Run by the thread pool. Only available in scope of search.c
+// argument: pointer to the search job.
+// index: the number of the chunk.
+static void searchChunk(void *argument, unsigned long int index)
+{
+    searchJob *job = (searchJob *)argument;
+    unsigned long int start = job->from + index * SEARCH_CHUNK; // The first position of the chunk.
+    unsigned long int end = job->to - start < SEARCH_CHUNK ? job->to : start + SEARCH_CHUNK; // One past the last position.
+    searchScratch *scratch = buildSearchScratch(job->pattern);
+    unsigned long int match; // The position of a match.
+    unsigned long int runEnd = start; // The end of the run of blocks the index could not rule out.
+
+    for (unsigned long int offset = start; offset < end; )
+    {
+        unsigned long int blockEnd = end - offset < SEARCH_BLOCK ? end : offset + SEARCH_BLOCK; // One past the last position of the block.
+
+        if ((job->cancelled && *job->cancelled) || (job->collectAll && job->chunkHits[index].count >= job->limit))
+        {
+            break;
+        }
+
+        // Skip the part of the block the index rules out, and only scan as far as it can not. The run it leaves is
+        // kept between blocks, and only worked out again once the scan passes its end.
+        if (job->index)
+        {
+            if (offset >= runEnd)
+            {
+                runEnd = blockEnd;
+                if (!narrowSearchIndex(job->index, job->pattern->grams, job->pattern->gramCount, &offset, &runEnd))
+                {
+                    offset = blockEnd;
+                    continue;
+                }
+            }
+            blockEnd = blockEnd < runEnd ? blockEnd : runEnd;
+        }
+
+        if (job->collectAll)
+        {
+            // Collect every match in the block, then move on to the next block, or past the end of the last match if
+            // it runs into the next block.
+            collectInBlock(job, &job->chunkHits[index], offset, blockEnd, scratch);
+            offset = job->chunkHits[index].reach > blockEnd ? job->chunkHits[index].reach : blockEnd;
+            continue;
+        }
+
+        // Skip the rest of the chunk once an earlier match has been found.
+        unsigned long int best = __atomic_load_n(&job->best, __ATOMIC_RELAXED);
+        if (offset >= best)
+        {
+            break;
+        }
+
+        if (findInRange(job->table, job->pattern, offset, blockEnd, scratch, &match, NULL))
+        {
+            // Lower the shared best match, unless another chunk has found an earlier one.
+            while (match < best && !__atomic_compare_exchange_n(&job->best, &best, match, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+            break;
+        }
+        offset = blockEnd;
+    }
+
+    freeSearchScratch(scratch);
+}
+
+// Finds the first match of a pattern, searching chunks of the contents in parallel.
+// pool: the thread pool the chunks are searched by.
+// table: pointer to the piece table.
+// pattern: the pattern.
+// index: the index of the file blocks are narrowed with, or NULL.
+// from: the first position a match can start at.
+// result: set to the position of the match.
+//
+// Returns: 1 if a match was found, otherwise 0.
+int findFirstParallel(threadPool *pool, pieceTable *table, searchPattern *pattern, searchIndex *index, unsigned long int from, unsigned long int *result)
+{
+    if (from >= table->size)
+    {
+        return 0;
+    }
+
+    searchJob job = { table, pattern, index, from, table->size, 0, table->size, NULL, 0, NULL };
+    runThreadPool(pool, searchChunk, &job, (table->size - from + SEARCH_CHUNK - 1) / SEARCH_CHUNK);
+
+    if (job.best < table->size)
+    {
+        *result = job.best;
+        return 1;
+    }
+    return 0;
+}
+
+// Finds every match of a pattern that starts within a segment of the contents, searching chunks of it in parallel.
+// Matches of bytes may overlap.
+// pool: the thread pool the chunks are searched by.
+// table: pointer to the piece table.
+// pattern: the pattern.
+// index: the index of the file blocks are narrowed with, or NULL.
+// from: the first position a match can start at.
+// to: one past the last position a match can start at.
+// hits: pointer to the list the matches are added to, in order. Matches that start before its reach are left out.
+// limit: the most matches added. Only the first matches are added, and chunks stop once they have found enough.
+// cancelled: stops the search when set, leaving only some of the matches added. May be NULL.
+//
+// Returns: the number of matches added, which is limit if there were that many.
+unsigned long int findAllParallel(threadPool *pool, pieceTable *table, searchPattern *pattern, searchIndex *index, unsigned long int from, unsigned long int to, searchHits *hits, unsigned long int limit, volatile int *cancelled)
+{
+    if (to > table->size)
+    {
+        to = table->size;
+    }
+    if (from >= to || limit == 0)
+    {
+        return 0;
+    }
+
+    // Each chunk stops once it has found enough matches to fill the list by itself. Matches of a regular expression at
+    // the start of a chunk may be hidden by a match running into it from the chunk before, so those chunks find a few
+    // more, as a match covers at most REGEX_MAX_MATCH of them.
+    unsigned long int chunkCount = (to - from + SEARCH_CHUNK - 1) / SEARCH_CHUNK; // The number of chunks.
+    unsigned long int chunkLimit = limit; // The most matches each chunk collects.
+    if (pattern->regex && limit <= ULONG_MAX - REGEX_MAX_MATCH)
+    {
+        chunkLimit += REGEX_MAX_MATCH;
+    }
+    searchJob job = { table, pattern, index, from, to, 1, to, NULL, chunkLimit, cancelled };
+    job.chunkHits = (searchHits *)calloc(chunkCount, sizeof(searchHits));
+    runThreadPool(pool, searchChunk, &job, chunkCount);
+
+    // Chunks are in order, so joining their matches keeps them in order. A match that runs into the next chunk hides
+    // the matches of that chunk that start inside it.
+    unsigned long int added = 0; // The number of matches added.
+    for (unsigned long int i = 0; i < chunkCount; i++)
+    {
+        searchHits *chunk = &job.chunkHits[i]; // The matches of the chunk.
+        for (unsigned long int j = 0; j < chunk->count && added < limit; j++)
+        {
+            if (chunk->offsets[j] < hits->reach)
+            {
+                continue;
+            }
+            addSearchHit(hits, chunk->offsets[j]);
+            added++;
+            if (j == chunk->count - 1)
+            {
+                hits->reach = chunk->reach;
+            }
+        }
+        clearSearchHits(chunk);
+    }
+    free(job.chunkHits);
+
+    return added;
+}
+
+// Searches the contents a few chunks at a time, adding the matches to the shared list. Run by the background thread
+// of a search. Only available in scope of search.c
+// argument: pointer to the search.
+//
+// Returns: NULL.
+static void *runSearchAll(void *argument)
+{
+    searchAll *search = (searchAll *)argument;
+    unsigned long int step = (unsigned long int)search->pool->threadCount * 2 * SEARCH_CHUNK; // Positions searched each pass.
+    searchHits found = { NULL, 0, 0, 0 }; // The matches of one pass, which keeps its reach between passes.
+
+    for (unsigned long int offset = 0; offset < search->table->size && !search->cancelled && !search->full; offset += step)
+    {
+        unsigned long int end = search->table->size - offset < step ? search->table->size : offset + step;
+        unsigned long int room = SEARCH_LIST_LIMIT - search->hits.count; // The most matches the list can still take.
+        findAllParallel(search->pool, search->table, search->pattern, search->index, offset, end, &found, room, &search->cancelled);
+
+        pthread_mutex_lock(&search->lock);
+        for (unsigned long int i = 0; i < found.count; i++)
+        {
+            addSearchHit(&search->hits, found.offsets[i]);
+        }
+        search->full = search->hits.count == SEARCH_LIST_LIMIT;
+        search->scanned = search->full ? search->hits.offsets[search->hits.count - 1] : end;
+        pthread_mutex_unlock(&search->lock);
+
+        found.count = 0;
+    }
+
+    clearSearchHits(&found);
+    search->running = 0;
+    return NULL;
+}
+
+// Starts finding every match of a pattern in the background.
+// pool: the thread pool the chunks are searched by.
+// table: pointer to the piece table. Must not be written to until the search is stopped.
+// pattern: the pattern. Must not be freed until the search is stopped.
+// index: the index of the file blocks are narrowed with, or NULL. Must not be closed until the search is stopped.
+//
+// Returns: the search, which must be passed to stopSearchAll().
+searchAll *startSearchAll(threadPool *pool, pieceTable *table, searchPattern *pattern, searchIndex *index)
+{
+    searchAll *obj = (searchAll *)calloc(1, sizeof(searchAll));
+    obj->pool = pool;
+    obj->table = table;
+    obj->pattern = pattern;
+    obj->index = index;
+    obj->running = 1;
+    pthread_mutex_init(&obj->lock, NULL);
+    pthread_create(&obj->thread, NULL, runSearchAll, obj);
+
+    return obj;
+}
+
+// Stops a search if it is still running, and waits for its thread to finish. The matches found so far are kept.
+// search: pointer to the search.
+void cancelSearchAll(searchAll *search)
+{
+    if (search == NULL || search->thread == 0)
+    {
+        return;
+    }
+
+    search->cancelled = 1;
+    pthread_join(search->thread, NULL);
+    search->thread = 0;
+}
+
+// Stops a search and frees it.
+// search: pointer to the search.
+void stopSearchAll(searchAll *search)
+{
+    if (search == NULL)
+    {
+        return;
+    }
+
+    cancelSearchAll(search);
+    pthread_mutex_destroy(&search->lock);
+    clearSearchHits(&search->hits);
+    free(search);
+}
+
+// Gets the progress of a search.
+// search: pointer to the search.
+// count: set to the number of matches found so far.
+// scanned: set to the number of positions searched so far.
+void readSearchAll(searchAll *search, unsigned long int *count, unsigned long int *scanned)
+{
+    pthread_mutex_lock(&search->lock);
+    *count = search->hits.count;
+    *scanned = search->scanned;
+    pthread_mutex_unlock(&search->lock);
+}
+
+// Finds the match of a search nearest to a position in one direction, using the matches found so far.
+// search: pointer to the search.
+// offset: the position.
+// direction: 1 for the first match after offset, -1 for the last match before offset.
+// result: set to the position of the match.
+// number: set to the number of the match, starting from 1.
+//
+// Returns: 1 if there is such a match, otherwise 0.
+int stepSearchAll(searchAll *search, unsigned long int offset, int direction, unsigned long int *result, unsigned long int *number)
+{
+    pthread_mutex_lock(&search->lock);
+
+    // Binary search for the first match after offset.
+    unsigned long int low = 0;
+    unsigned long int high = search->hits.count;
+    while (low < high)
+    {
+        unsigned long int middle = (low + high) / 2;
+        if (search->hits.offsets[middle] <= offset)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    // Step back past offset itself for the last match before it.
+    if (direction < 0)
+    {
+        while (low > 0 && search->hits.offsets[low - 1] >= offset)
+        {
+            low--;
+        }
+        low--;
+    }
+
+    int found = low < search->hits.count; // Going back from the first match wraps low past count.
+    if (found)
+    {
+        *result = search->hits.offsets[low];
+        *number = low + 1;
+    }
+
+    pthread_mutex_unlock(&search->lock);
+    return found;
+}
+
+#endif
@@ -0,0 +1,515 @@
+//
+// hexeditor.c library file
+// searchindex.c
+//
+// Provides an index of the file, kept next to it in {File}.hxi, that lets searches skip blocks that cannot hold a match.
+//
+// Demonstration:
+//
+//   File:      | block 0 (64 KiB) | block 1 | block 2 | ...
+//   Bitmaps:   | 0110...0100      | 1000... | 0000... | ...     One bit for each hash of a 4 byte run (gram).
+//
+//   Pattern:   DE AD BE EF 01      Grams DEADBEEF and ADBEEF01, which hash to bits 1234 and 877.
+//
+// Each block has a bitmap with the bit of every gram that starts in it set, including grams that run into the next
+// block. A match that starts in a block lies within it and the next block, as patterns are never longer than a block,
+// so a block is only searched if every gram of the pattern is set in its bitmap or the bitmap of the next block. Grams
+// that are partly masked out (DE ?? BE EF) are not used, and patterns with no whole gram are searched in full.
+//
+// The index is most useful where blocks hold a limited variety of grams, such as disk images, executables and text.
+// A block of random bytes sets most of its bits, and is searched anyway.
+//
+// The index is built in the background by the thread pool, a batch of blocks at a time, and is usable as it grows:
+// blocks that have not been built yet are searched in full. It describes the file rather than the edited contents, so
+// blocks touched by edits are searched in full until the edits are written, and then only those blocks are built
+// again. Inserting or deleting bytes moves every byte after the edit, so the blocks from there on are treated the same.
+// The header records the size and modification time of the file, so an index left over from another version of the
+// file is started again from empty.
+//
+
+// Avoid redefinition errors during compilation
+#ifndef FILE_SEARCHINDEX_SEEN
+#define FILE_SEARCHINDEX_SEEN
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "filemap.h"
+#include "threadpool.h"
+
+#define SEARCHINDEX_MAGIC "HXINDEX1" // The first bytes of every index.
+#define SEARCHINDEX_BLOCK 65536 // Bytes of the file each bitmap describes. Must not be less than the longest pattern.
+#define SEARCHINDEX_BITS_LOG 15 // Bits of each bitmap, as a power of two.
+#define SEARCHINDEX_BITMAP ((1 << SEARCHINDEX_BITS_LOG) / 8) // Bytes of each bitmap.
+#define SEARCHINDEX_GRAM 4 // Length of the runs of bytes recorded.
+#define SEARCHINDEX_HEADER 4096 // Space kept for the header, so that the bitmaps are aligned to pages.
+#define SEARCHINDEX_BATCH 256 // Blocks handed to the thread pool at a time by the background build.
+
+typedef struct
+{
+    char magic[8]; // SEARCHINDEX_MAGIC.
+    uint64_t size; // Size of the file the index describes.
+    int64_t modifiedSeconds; // Modification time of the file, in seconds.
+    int64_t modifiedNanoseconds; // Nanoseconds of the modification time.
+    uint32_t blockSize; // SEARCHINDEX_BLOCK when the index was made.
+    uint32_t bitmapBytes; // SEARCHINDEX_BITMAP when the index was made.
+} searchIndexHeader;
+
+typedef struct
+{
+    fileMap *original; // The file the index describes.
+    threadPool *pool; // The thread pool blocks are built by.
+    int fd; // The index file.
+    unsigned char *data; // The mapping of the index file: the header, the bitmaps, then a byte for each block.
+    unsigned long int dataLength; // The size of the mapping.
+    unsigned long int blockCount; // The number of blocks of the file.
+    unsigned char *built; // Set for each block once its bitmap has been filled in. Part of data.
+    unsigned char *touched; // Set for each block that has been edited since the file was last written.
+    unsigned long int shiftedFrom; // The first offset moved by inserting or deleting bytes, or ULONG_MAX.
+    unsigned long int builtCount; // The number of blocks built.
+    pthread_t thread; // The background build, or 0 if it is not running.
+    volatile int cancelled; // Set to stop the background build.
+    volatile int running; // Set while the background build is running.
+} searchIndex;
+
+typedef struct
+{
+    searchIndex *index; // The index being built.
+    unsigned long int *blocks; // The blocks of the batch.
+} searchIndexBatch;
+
+// Gets the bit of a gram.
+// gram: the 4 bytes of the gram, first byte in the low bits.
+//
+// Returns: the position of its bit in a bitmap.
+static inline unsigned int hashSearchIndexGram(uint32_t gram)
+{
+    return (gram * 2654435761u) >> (32 - SEARCHINDEX_BITS_LOG);
+}
+
+// Fills in the header for the current state of a file. Only available in scope of searchindex.c
+// header: the header.
+// original: the file the index describes.
+static void describeSearchIndexFile(searchIndexHeader *header, fileMap *original)
+{
+    struct stat info;
+    memset(header, 0, sizeof(searchIndexHeader));
+    memcpy(header->magic, SEARCHINDEX_MAGIC, sizeof(header->magic));
+    header->size = original->size;
+    header->blockSize = SEARCHINDEX_BLOCK;
+    header->bitmapBytes = SEARCHINDEX_BITMAP;
+    if (fstat(original->fd, &info) == 0)
+    {
+        header->modifiedSeconds = info.st_mtim.tv_sec;
+        header->modifiedNanoseconds = info.st_mtim.tv_nsec;
+    }
+}
+
+// Gets the bitmap of a block. Only available in scope of searchindex.c
+// index: pointer to the index.
+// block: the number of the block.
+//
+// Returns: pointer to the bitmap.
+static unsigned char *findSearchIndexBitmap(searchIndex *index, unsigned long int block)
+{
+    return index->data + SEARCHINDEX_HEADER + block * SEARCHINDEX_BITMAP;
+}
+
+// Maps the index file, sized for the current size of the file. Only available in scope of searchindex.c
+// Bitmaps keep their place when the size changes, while the built bytes after them move, so they are left for the
+// caller to fill in.
+// index: pointer to the index, which must not be mapped.
+//
+// Returns: 0 on success, -1 if the index file could not be sized or mapped.
+static int mapSearchIndex(searchIndex *index)
+{
+    index->blockCount = (index->original->size + SEARCHINDEX_BLOCK - 1) / SEARCHINDEX_BLOCK;
+    index->dataLength = SEARCHINDEX_HEADER + index->blockCount * (SEARCHINDEX_BITMAP + 1);
+    if (ftruncate(index->fd, index->dataLength) == -1)
+    {
+        return -1;
+    }
+
+    index->data = (unsigned char *)mmap(NULL, index->dataLength, PROT_READ | PROT_WRITE, MAP_SHARED, index->fd, 0);
+    if (index->data == MAP_FAILED)
+    {
+        index->data = NULL;
+        return -1;
+    }
+    index->built = index->data + SEARCHINDEX_HEADER + index->blockCount * SEARCHINDEX_BITMAP;
+
+    free(index->touched);
+    index->touched = (unsigned char *)calloc(index->blockCount + 1, 1);
+    return 0;
+}
+
+// Builds the bitmaps of a batch of blocks. Run by the thread pool. Only available in scope of searchindex.c
+// argument: pointer to the batch.
+// number: the position of the block in the batch.
+static void buildSearchIndexBlock(void *argument, unsigned long int number)
+{
+    searchIndexBatch *batch = (searchIndexBatch *)argument;
+    searchIndex *index = batch->index;
+    unsigned long int block = batch->blocks[number]; // The block being built.
+    if (index->cancelled)
+    {
+        return;
+    }
+
+    // Read the block along with the start of the next, for the grams that run into it.
+    unsigned long int start = block * SEARCHINDEX_BLOCK; // The first byte of the block.
+    unsigned long int length = SEARCHINDEX_BLOCK + SEARCHINDEX_GRAM - 1; // The bytes read.
+    if (length > index->original->size - start)
+    {
+        length = index->original->size - start;
+    }
+    unsigned char scratch[SEARCHINDEX_BLOCK + SEARCHINDEX_GRAM - 1];
+    unsigned char *bytes = scratch; // The bytes of the block.
+    if (index->original->mode == fileMapped)
+    {
+        bytes = index->original->data + start;
+    }
+    else
+    {
+        readFileMap(index->original, start, scratch, length);
+    }
+
+    unsigned char bitmap[SEARCHINDEX_BITMAP]; // The bitmap, built here so that the mapping is written once.
+    memset(bitmap, 0, sizeof(bitmap));
+    for (unsigned long int i = 0; i + SEARCHINDEX_GRAM <= length; i++)
+    {
+        uint32_t gram; // The gram starting at i.
+        memcpy(&gram, bytes + i, SEARCHINDEX_GRAM);
+        unsigned int bit = hashSearchIndexGram(gram);
+        bitmap[bit >> 3] |= 1 << (bit & 7);
+    }
+
+    // Searches may look at the block as soon as it is marked as built, so the bitmap has to be in place first.
+    memcpy(findSearchIndexBitmap(index, block), bitmap, SEARCHINDEX_BITMAP);
+    __atomic_store_n(&index->built[block], 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&index->builtCount, 1, __ATOMIC_RELAXED);
+}
+
+// Builds every block that has not been built yet, a batch at a time. Run by the background thread of an index. Only
+// available in scope of searchindex.c
+// argument: pointer to the index.
+//
+// Returns: NULL.
+static void *runSearchIndex(void *argument)
+{
+    searchIndex *index = (searchIndex *)argument;
+    unsigned long int blocks[SEARCHINDEX_BATCH]; // The blocks of a batch.
+    searchIndexBatch batch = { index, blocks };
+
+    for (unsigned long int next = 0; next < index->blockCount && !index->cancelled; )
+    {
+        unsigned long int count = 0; // The number of blocks in the batch.
+        for (; next < index->blockCount && count < SEARCHINDEX_BATCH; next++)
+        {
+            if (!index->built[next])
+            {
+                blocks[count++] = next;
+            }
+        }
+        if (count > 0)
+        {
+            runThreadPool(index->pool, buildSearchIndexBlock, &batch, count);
+        }
+    }
+
+    // Hand the finished index to the kernel to write out, rather than leaving it all to be written at exit.
+    if (!index->cancelled)
+    {
+        msync(index->data, index->dataLength, MS_ASYNC);
+    }
+    index->running = 0;
+    return NULL;
+}
+
+// Starts building the blocks that have not been built yet in the background. Only available in scope of searchindex.c
+// index: pointer to the index, which must not be building.
+static void startSearchIndex(searchIndex *index)
+{
+    index->builtCount = 0;
+    for (unsigned long int i = 0; i < index->blockCount; i++)
+    {
+        index->builtCount += index->built[i];
+    }
+
+    index->cancelled = 0;
+    index->running = 1;
+    pthread_create(&index->thread, NULL, runSearchIndex, index);
+}
+
+// Stops the background build, if it is running, and waits for it. Blocks already built are kept.
+// index: pointer to the index, or NULL to do nothing.
+void stopSearchIndex(searchIndex *index)
+{
+    if (index == NULL || index->thread == 0)
+    {
+        return;
+    }
+
+    index->cancelled = 1;
+    pthread_join(index->thread, NULL);
+    index->thread = 0;
+    index->running = 0;
+}
+
+// Opens the index of a file and starts building any blocks that are missing in the background.
+// fileName: the location of the file.
+// original: the file the index describes.
+// pool: the thread pool blocks are built by.
+// create: set to create the index if there is none, otherwise NULL is returned.
+//
+// Returns: the index, or NULL if there is none or it could not be opened.
+searchIndex *openSearchIndex(char *fileName, fileMap *original, threadPool *pool, int create)
+{
+    // Streams are read once, so there is nothing to index.
+    if (original->mode == fileBuffered)
+    {
+        return NULL;
+    }
+
+    char name[PATH_MAX];
+    snprintf(name, PATH_MAX, "%s.hxi", fileName);
+    int fd = open(name, O_RDWR | O_CLOEXEC | (create ? O_CREAT : 0), 0644);
+    if (fd == -1)
+    {
+        return NULL;
+    }
+
+    // Allocate memory for index.
+    searchIndex *obj = (searchIndex *)calloc(1, sizeof(searchIndex));
+    obj->original = original;
+    obj->pool = pool;
+    obj->fd = fd;
+    obj->shiftedFrom = ULONG_MAX;
+
+    // An index of another version of the file is started again from empty.
+    searchIndexHeader header; // The header of the index file.
+    searchIndexHeader current; // The header the index would have for the file as it is now.
+    describeSearchIndexFile(&current, original);
+    if (pread(fd, &header, sizeof(header), 0) != sizeof(header) || memcmp(&header, &current, sizeof(header)) != 0)
+    {
+        if (ftruncate(fd, 0) == -1 || pwrite(fd, &current, sizeof(current), 0) != sizeof(current))
+        {
+            close(fd);
+            free(obj);
+            return NULL;
+        }
+    }
+
+    if (mapSearchIndex(obj) == -1)
+    {
+        close(fd);
+        free(obj->touched);
+        free(obj);
+        return NULL;
+    }
+
+    startSearchIndex(obj);
+    return obj;
+}
+
+// Records that a segment of the contents has been overwritten, so that its blocks are searched in full.
+// index: pointer to the index, or NULL to do nothing.
+// offset: the offset of the first byte edited.
+// length: the number of bytes edited.
+void touchSearchIndex(searchIndex *index, unsigned long int offset, unsigned long int length)
+{
+    if (index == NULL || length == 0)
+    {
+        return;
+    }
+
+    for (unsigned long int block = offset / SEARCHINDEX_BLOCK; block <= (offset + length - 1) / SEARCHINDEX_BLOCK && block < index->blockCount; block++)
+    {
+        index->touched[block] = 1;
+    }
+}
+
+// Records that bytes have been inserted or deleted, so that every block from there on is searched in full.
+// index: pointer to the index, or NULL to do nothing.
+// offset: the offset of the insert or delete.
+void shiftSearchIndex(searchIndex *index, unsigned long int offset)
+{
+    if (index != NULL && offset < index->shiftedFrom)
+    {
+        index->shiftedFrom = offset;
+    }
+}
+
+// Brings the index up to date after the contents have been written to the file, building again only the blocks that
+// were edited.
+// index: pointer to the index, or NULL to do nothing.
+// original: the file as it is after the contents were written, which may have been opened again.
+void refreshSearchIndex(searchIndex *index, fileMap *original)
+{
+    if (index == NULL)
+    {
+        return;
+    }
+    stopSearchIndex(index);
+
+    // The bitmap of a block also holds the grams that run into the next block, so it goes along with that block.
+    for (unsigned long int block = 0; block < index->blockCount; block++)
+    {
+        if (index->touched[block] || (block + 1 < index->blockCount && index->touched[block + 1]))
+        {
+            index->built[block] = 0;
+        }
+    }
+
+    // Blocks from an insert or delete on are built again, and the bitmaps before them keep their place.
+    unsigned long int kept = index->blockCount; // The blocks that are still valid.
+    if (index->shiftedFrom != ULONG_MAX)
+    {
+        unsigned long int first = index->shiftedFrom / SEARCHINDEX_BLOCK; // The first block moved.
+        kept = first > 0 ? first - 1 : 0;
+        kept = kept < index->blockCount ? kept : index->blockCount;
+    }
+    unsigned char *built = (unsigned char *)malloc(kept + 1); // The built bytes of the blocks kept.
+    memcpy(built, index->built, kept);
+
+    munmap(index->data, index->dataLength);
+    index->data = NULL;
+    index->original = original;
+    index->shiftedFrom = ULONG_MAX;
+
+    searchIndexHeader header; // The header for the file as it is now.
+    describeSearchIndexFile(&header, original);
+    if (mapSearchIndex(index) == -1)
+    {
+        // Without a mapping there is nothing to search with, so every block is searched in full.
+        index->blockCount = 0;
+        free(built);
+        return;
+    }
+    kept = kept < index->blockCount ? kept : index->blockCount;
+    memcpy(index->built, built, kept);
+    memset(index->built + kept, 0, index->blockCount - kept);
+    memcpy(index->data, &header, sizeof(header));
+    free(built);
+
+    startSearchIndex(index);
+}
+
+// Checks whether the bitmap of a block describes the contents. Only available in scope of searchindex.c
+// index: pointer to the index.
+// block: the number of the block.
+//
+// Returns: the bitmap, or NULL if the block has not been built or its contents have changed.
+static unsigned char *usableSearchIndexBitmap(searchIndex *index, unsigned long int block)
+{
+    if (block >= index->blockCount || !__atomic_load_n(&index->built[block], __ATOMIC_ACQUIRE) || index->touched[block])
+    {
+        return NULL;
+    }
+    if ((block + 1) * SEARCHINDEX_BLOCK > index->shiftedFrom)
+    {
+        return NULL;
+    }
+    return findSearchIndexBitmap(index, block);
+}
+
+// Checks whether a match of a pattern could start in a block of the contents. Only available in scope of searchindex.c
+// index: pointer to the index.
+// grams: the bits of the grams of the pattern.
+// gramCount: the number of grams.
+// block: the number of the block.
+//
+// Returns: 1 if it could, 0 if the index rules it out.
+static int possibleSearchIndex(searchIndex *index, unsigned int *grams, int gramCount, unsigned long int block)
+{
+    unsigned char *bitmap = usableSearchIndexBitmap(index, block); // The bitmap of the block.
+    if (bitmap == NULL)
+    {
+        return 1;
+    }
+
+    // A match may run into the next block. Past the end of the file there is nothing, unless bytes have been
+    // inserted, in which case the next block is not usable either.
+    unsigned char *next = usableSearchIndexBitmap(index, block + 1); // The bitmap of the next block.
+    if (next == NULL && (block + 1 < index->blockCount || index->shiftedFrom != ULONG_MAX))
+    {
+        return 1;
+    }
+
+    for (int i = 0; i < gramCount; i++)
+    {
+        unsigned int byte = grams[i] >> 3; // The byte of the bit of the gram.
+        unsigned char bit = 1 << (grams[i] & 7); // The bit of the gram in the byte.
+        if (!(bitmap[byte] & bit) && !(next && (next[byte] & bit)))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Narrows a segment of the contents to the first run of blocks that could hold the start of a match.
+// index: pointer to the index.
+// grams: the bits of the grams of the pattern.
+// gramCount: the number of grams.
+// from: the first position of the segment, moved forward past blocks that cannot hold the start of a match.
+// to: one past the last position of the segment, moved back to the end of the run.
+//
+// Returns: 1 if there is such a run, 0 if the whole segment is ruled out.
+int narrowSearchIndex(searchIndex *index, unsigned int *grams, int gramCount, unsigned long int *from, unsigned long int *to)
+{
+    if (gramCount == 0)
+    {
+        return *from < *to;
+    }
+
+    // Skip the blocks that are ruled out.
+    unsigned long int block = *from / SEARCHINDEX_BLOCK; // The block being checked.
+    while (*from < *to && !possibleSearchIndex(index, grams, gramCount, block))
+    {
+        block++;
+        *from = block * SEARCHINDEX_BLOCK;
+    }
+    if (*from >= *to)
+    {
+        return 0;
+    }
+
+    // Take every block after it that is not ruled out.
+    unsigned long int end = (block + 1) * SEARCHINDEX_BLOCK; // The end of the run.
+    while (end < *to && possibleSearchIndex(index, grams, gramCount, end / SEARCHINDEX_BLOCK))
+    {
+        end += SEARCHINDEX_BLOCK;
+    }
+    *to = end < *to ? end : *to;
+    return 1;
+}
+
+// Closes an index, stopping its background build.
+// index: pointer to the index, or NULL to do nothing.
+void closeSearchIndex(searchIndex *index)
+{
+    if (index == NULL)
+    {
+        return;
+    }
+
+    stopSearchIndex(index);
+    if (index->data)
+    {
+        munmap(index->data, index->dataLength);
+    }
+    close(index->fd);
+    free(index->touched);
+    free(index);
+}
+
+#endif
@@ -33,6 +33,10 @@
 #define SGR_FOREGROUND_WHITE "\033[0;37m"
 #define SGR_BACKGROUND_WHITE "\033[0;47m"
 #define SGR_BACKGROUND_RED "\033[0;41m"
+#define SGR_BACKGROUND_GREEN "\033[0;42m"
+#define SGR_BACKGROUND_YELLOW "\033[0;43m"
+#define SGR_BACKGROUND_BLUE "\033[0;44m"
+#define SGR_BACKGROUND_CYAN "\033[0;46m"
 
 // Draws a character for an entire line
 // colour: the ANSI code for any specified colours
@@ -88,4 +92,27 @@ void distributeLines(char* strA, char* strB, int startPos, int y, int widthSegme
     puts(strB);
 }
 
+// Convert a hex character to an integer.
+// hex: the hex character.
+//
+// Returns: the base 10 representation of the hexadecimal character.
+// Note: returns -1 if not a hexadecimal character.
+int convertHexChar(char hex) 
+{
+    if (hex >= '0' && hex <= '9')
+    {
+        return hex - '0';
+    }
+    if (hex >= 'A' && hex <= 'F')
+    {
+        return hex - 'A' + 10;
+    }
+    if (hex >= 'a' && hex <= 'f')
+    {
+        return hex - 'a' + 10;
+    }
+
+    return -1;
+}
+
 #endif
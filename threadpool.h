@@ -0,0 +1,219 @@
+//
+// hexeditor.c library file
+// threadpool.c
+//
+// Provides a pool of worker threads that run batches of numbered tasks.
+//
+// Demonstration:
+//
+//   submitThreadPool(pool, task, argument, 5)
+//
+//   Worker 0:  task(argument, 0)  task(argument, 3)
+//   Worker 1:  task(argument, 1)  task(argument, 4)
+//   Worker 2:  task(argument, 2)
+//
+// Workers take the lowest index that has not been started yet, so tasks start roughly in order. Batches submitted
+// by different threads are queued and run one after another. Tasks are never interrupted; a task that should stop
+// early has to check for itself, for example through a flag in its argument.
+//
+
+// Avoid redefinition errors during compilation
+#ifndef FILE_THREADPOOL_SEEN
+#define FILE_THREADPOOL_SEEN
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
+
+typedef void (*threadTask)(void *argument, unsigned long int index);
+
+typedef struct threadBatch
+{
+    threadTask task; // The function each task runs.
+    void *argument; // The argument passed to every task.
+    unsigned long int count; // The number of tasks.
+    unsigned long int started; // The number of tasks taken by workers.
+    unsigned long int finished; // The number of tasks that have returned.
+    pthread_cond_t done; // Signalled once every task has returned.
+    struct threadBatch *next; // The batch queued after this one.
+} threadBatch;
+
+typedef struct
+{
+    pthread_t *threads; // The worker threads.
+    int threadCount; // The number of worker threads.
+    pthread_mutex_t lock; // Protects the queue and the counters of every batch.
+    pthread_cond_t work; // Signalled when a batch is queued or the pool is stopping.
+    threadBatch *head; // The batch tasks are taken from.
+    threadBatch *tail; // The last queued batch.
+    int stopping; // Set when the pool is being freed.
+} threadPool;
+
+// The loop each worker runs. Only available in scope of threadpool.c
+// argument: pointer to the pool.
+//
+// Returns: NULL.
+static void *runThreadPoolWorker(void *argument)
+{
+    threadPool *pool = (threadPool *)argument;
+
+    pthread_mutex_lock(&pool->lock);
+    while (1)
+    {
+        // Wait for a batch with tasks left.
+        while (pool->head == NULL && !pool->stopping)
+        {
+            pthread_cond_wait(&pool->work, &pool->lock);
+        }
+        if (pool->head == NULL)
+        {
+            break;
+        }
+
+        // Take the next task, and remove the batch from the queue once every task has been taken.
+        threadBatch *batch = pool->head;
+        unsigned long int index = batch->started++;
+        if (batch->started == batch->count)
+        {
+            pool->head = batch->next;
+            if (pool->head == NULL)
+            {
+                pool->tail = NULL;
+            }
+        }
+
+        pthread_mutex_unlock(&pool->lock);
+        batch->task(batch->argument, index);
+        pthread_mutex_lock(&pool->lock);
+
+        batch->finished++;
+        if (batch->finished == batch->count)
+        {
+            pthread_cond_broadcast(&batch->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+// Generate a thread pool.
+// threadCount: the number of worker threads, or 0 for one per online processor.
+//
+// Returns: the generated pool.
+threadPool *buildThreadPool(int threadCount)
+{
+    if (threadCount <= 0)
+    {
+        threadCount = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (threadCount <= 0)
+    {
+        threadCount = 1;
+    }
+
+    // Allocate memory for pool.
+    threadPool *obj = (threadPool *)calloc(1, sizeof(threadPool));
+    obj->threadCount = threadCount;
+    obj->threads = (pthread_t *)malloc(sizeof(pthread_t) * threadCount);
+    pthread_mutex_init(&obj->lock, NULL);
+    pthread_cond_init(&obj->work, NULL);
+
+    for (int i = 0; i < threadCount; i++)
+    {
+        pthread_create(&obj->threads[i], NULL, runThreadPoolWorker, obj);
+    }
+
+    return obj;
+}
+
+// Queue a batch of tasks.
+// pool: pointer to the pool.
+// task: the function each task runs. It is passed argument and the index of the task.
+// argument: the argument passed to every task.
+// count: the number of tasks.
+//
+// Returns: the batch, which must be passed to waitThreadPool().
+threadBatch *submitThreadPool(threadPool *pool, threadTask task, void *argument, unsigned long int count)
+{
+    threadBatch *batch = (threadBatch *)calloc(1, sizeof(threadBatch));
+    batch->task = task;
+    batch->argument = argument;
+    batch->count = count;
+    pthread_cond_init(&batch->done, NULL);
+
+    // A batch without tasks is already finished.
+    if (count == 0)
+    {
+        return batch;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->tail)
+    {
+        pool->tail->next = batch;
+    }
+    else
+    {
+        pool->head = batch;
+    }
+    pool->tail = batch;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    return batch;
+}
+
+// Wait for every task of a batch to return, then free the batch.
+// pool: pointer to the pool.
+// batch: the batch returned by submitThreadPool().
+void waitThreadPool(threadPool *pool, threadBatch *batch)
+{
+    pthread_mutex_lock(&pool->lock);
+    while (batch->finished < batch->count)
+    {
+        pthread_cond_wait(&batch->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    pthread_cond_destroy(&batch->done);
+    free(batch);
+}
+
+// Run a batch of tasks and wait for them to return.
+// pool: pointer to the pool.
+// task: the function each task runs.
+// argument: the argument passed to every task.
+// count: the number of tasks.
+void runThreadPool(threadPool *pool, threadTask task, void *argument, unsigned long int count)
+{
+    waitThreadPool(pool, submitThreadPool(pool, task, argument, count));
+}
+
+// Stop the workers and free a pool. Queued batches are finished first.
+// pool: pointer to the pool.
+void freeThreadPool(threadPool *pool)
+{
+    if (pool == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->threadCount; i++)
+    {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work);
+    free(pool->threads);
+    free(pool);
+}
+
+#endif
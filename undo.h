@@ -0,0 +1,303 @@
+//
+// hexeditor.c library file
+// undo.c
+//
+// Provides an undo / redo log of the edits made to a piece table.
+//
+// Demonstration:
+//
+//   Records:   [0] offset 0x10, length 3, start 0     [1] offset 0x80, length 1, start 3
+//                                                                                       ^ position
+//   Old:       41 42 43 | 7F                           The bytes before each edit.
+//   New:       61 62 63 | 00                           The bytes after each edit.
+//
+// Each record is an edit of a contiguous run of bytes. Its old and new bytes are appended to two arenas, at the same
+// start in both, so a record costs a few words no matter how many bytes it covers. An edit next to the end of the
+// last record, or inside it, extends that record instead of adding one, so typing over a run of bytes is undone in one
+// step.
+//
+// Records of inserted or deleted bytes hold those bytes in both arenas. Inserting straight after the last insert, or
+// deleting again at the offset of the last delete, extends the record the same way, and typing over bytes that were
+// just inserted changes the inserted bytes, so inserting a run and filling it in is undone in one step.
+//
+// Records before the position have been applied. Undo moves the position back one record and writes its old bytes,
+// redo writes the new bytes of the record at the position and moves it forward. Inserts are undone by deleting the
+// bytes again, and deletes by inserting them. A new edit drops every record past the position, as they can no longer
+// be redone.
+//
+
+// Avoid redefinition errors during compilation
+#ifndef FILE_UNDO_SEEN
+#define FILE_UNDO_SEEN
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "piecetable.h"
+
+#define UNDO_INITIAL_RECORDS 64 // Records allocated when the log is built.
+#define UNDO_INITIAL_ARENA 4096 // Bytes of each arena allocated when the log is built.
+
+typedef struct
+{
+    enum EditKind kind; // Whether bytes were overwritten, inserted or deleted.
+    unsigned long int offset; // The offset of the first byte edited.
+    unsigned long int length; // The number of bytes edited.
+    unsigned long int start; // The position of the bytes in the old and new arenas.
+} undoRecord;
+
+typedef struct
+{
+    undoRecord *records; // The edits, oldest first.
+    int count; // The number of records.
+    int position; // The number of records that are applied.
+    int capacity; // Allocated number of records.
+    unsigned char *oldBytes; // The bytes before each edit.
+    unsigned char *newBytes; // The bytes after each edit.
+    unsigned long int arenaLength; // The number of bytes used in each arena.
+    unsigned long int arenaCapacity; // Allocated size of each arena.
+    int sealed; // Set to stop the next edit from extending the last record.
+} undoLog;
+
+// Generate an undo log.
+//
+// Returns: the generated log.
+undoLog *buildUndoLog()
+{
+    // Allocate memory for log.
+    undoLog *obj = (undoLog *)calloc(1, sizeof(undoLog));
+
+    // Initialise log variables.
+    obj->capacity = UNDO_INITIAL_RECORDS;
+    obj->records = (undoRecord *)malloc(sizeof(undoRecord) * obj->capacity);
+    obj->arenaCapacity = UNDO_INITIAL_ARENA;
+    obj->oldBytes = (unsigned char *)malloc(obj->arenaCapacity);
+    obj->newBytes = (unsigned char *)malloc(obj->arenaCapacity);
+
+    return obj;
+}
+
+// Makes space for more bytes in both arenas. Only available in scope of undo.c
+// log: pointer to the log.
+// length: the number of bytes about to be added.
+static void reserveUndoArena(undoLog *log, unsigned long int length)
+{
+    if (log->arenaLength + length > log->arenaCapacity)
+    {
+        while (log->arenaLength + length > log->arenaCapacity)
+        {
+            log->arenaCapacity *= 2;
+        }
+        log->oldBytes = (unsigned char *)realloc(log->oldBytes, log->arenaCapacity);
+        log->newBytes = (unsigned char *)realloc(log->newBytes, log->arenaCapacity);
+    }
+}
+
+// Drops the records that can no longer be redone, and finds the record a new edit may extend. Only available in scope of undo.c
+// log: pointer to the log.
+//
+// Returns: the last record, or NULL if it is sealed or there is none.
+static undoRecord *prepareUndoLog(undoLog *log)
+{
+    // Records past the position can no longer be redone.
+    if (log->position < log->count)
+    {
+        log->count = log->position;
+        log->arenaLength = log->count > 0 ? log->records[log->count - 1].start + log->records[log->count - 1].length : 0;
+        log->sealed = 1;
+    }
+
+    undoRecord *last = log->count > 0 && !log->sealed ? &log->records[log->count - 1] : NULL; // Record that may be extended.
+    log->sealed = 0;
+    return last;
+}
+
+// Adds a record to the end of the log. Only available in scope of undo.c
+// log: pointer to the log.
+// kind: the kind of edit.
+// offset: the offset of the first byte edited.
+// oldBytes: the bytes stored in the old arena.
+// newBytes: the bytes stored in the new arena.
+// length: the number of bytes edited.
+static void addUndoRecord(undoLog *log, enum EditKind kind, unsigned long int offset, void *oldBytes, void *newBytes, unsigned long int length)
+{
+    if (log->count == log->capacity)
+    {
+        log->capacity *= 2;
+        log->records = (undoRecord *)realloc(log->records, sizeof(undoRecord) * log->capacity);
+    }
+    reserveUndoArena(log, length);
+
+    undoRecord *record = &log->records[log->count]; // The new record.
+    record->kind = kind;
+    record->offset = offset;
+    record->length = length;
+    record->start = log->arenaLength;
+    memcpy(log->oldBytes + record->start, oldBytes, length);
+    memcpy(log->newBytes + record->start, newBytes, length);
+    log->arenaLength += length;
+    log->count++;
+    log->position = log->count;
+}
+
+// Records an edit that overwrites bytes.
+// log: pointer to the log.
+// offset: the offset of the first byte edited.
+// oldBytes: the bytes before the edit.
+// newBytes: the bytes after the edit.
+// length: the number of bytes edited.
+void recordUndoLog(undoLog *log, unsigned long int offset, void *oldBytes, void *newBytes, unsigned long int length)
+{
+    if (length == 0)
+    {
+        return;
+    }
+
+    undoRecord *last = prepareUndoLog(log); // Record that may be extended.
+
+    // An edit inside the last record only changes its new bytes; the old bytes are still the ones before the record.
+    // Inside bytes that were just inserted, it changes the bytes that were inserted.
+    if (last && last->kind != editDelete && offset >= last->offset && offset + length <= last->offset + last->length)
+    {
+        memcpy(log->newBytes + last->start + (offset - last->offset), newBytes, length);
+        return;
+    }
+
+    // An edit straight after the last record extends it.
+    if (last && last->kind == editOverwrite && offset == last->offset + last->length)
+    {
+        reserveUndoArena(log, length);
+        memcpy(log->oldBytes + log->arenaLength, oldBytes, length);
+        memcpy(log->newBytes + log->arenaLength, newBytes, length);
+        log->arenaLength += length;
+        last->length += length;
+        return;
+    }
+
+    // Otherwise add a record.
+    addUndoRecord(log, editOverwrite, offset, oldBytes, newBytes, length);
+}
+
+// Records an edit that inserts or deletes bytes.
+// log: pointer to the log.
+// kind: editInsert or editDelete.
+// offset: the offset of the first byte inserted or deleted.
+// bytes: the bytes inserted or deleted.
+// length: the number of bytes inserted or deleted.
+void recordUndoLogResize(undoLog *log, enum EditKind kind, unsigned long int offset, void *bytes, unsigned long int length)
+{
+    if (length == 0)
+    {
+        return;
+    }
+
+    undoRecord *last = prepareUndoLog(log); // Record that may be extended.
+
+    // Inserting straight after the last insert, or deleting the bytes that moved up to the last delete, extends it.
+    if (last && last->kind == kind && offset == last->offset + (kind == editInsert ? last->length : 0))
+    {
+        reserveUndoArena(log, length);
+        memcpy(log->oldBytes + log->arenaLength, bytes, length);
+        memcpy(log->newBytes + log->arenaLength, bytes, length);
+        log->arenaLength += length;
+        last->length += length;
+        return;
+    }
+
+    addUndoRecord(log, kind, offset, bytes, bytes, length);
+}
+
+// Stops the next edit from extending the last record, so that it is undone on its own.
+// log: pointer to the log.
+void sealUndoLog(undoLog *log)
+{
+    log->sealed = 1;
+}
+
+// Undoes the last applied edit by writing its old bytes to a piece table, or by reversing an insert or delete.
+// log: pointer to the log.
+// table: pointer to the piece table the edit was made to.
+// record: set to the record that was undone. May be NULL.
+//
+// Returns: 1 if an edit was undone, 0 if there is nothing to undo.
+int undoPieceTable(undoLog *log, pieceTable *table, undoRecord *record)
+{
+    if (log->position == 0)
+    {
+        return 0;
+    }
+
+    undoRecord *undone = &log->records[--log->position];
+    if (undone->kind == editInsert)
+    {
+        deletePieceTable(table, undone->offset, undone->length);
+    }
+    else if (undone->kind == editDelete)
+    {
+        insertPieceTable(table, undone->offset, log->oldBytes + undone->start, undone->length);
+    }
+    else
+    {
+        writePieceTable(table, undone->offset, log->oldBytes + undone->start, undone->length);
+    }
+    log->sealed = 1;
+
+    if (record)
+    {
+        *record = *undone;
+    }
+    return 1;
+}
+
+// Redoes the next undone edit by writing its new bytes to a piece table, or by inserting or deleting again.
+// log: pointer to the log.
+// table: pointer to the piece table the edit was made to.
+// record: set to the record that was redone. May be NULL.
+//
+// Returns: 1 if an edit was redone, 0 if there is nothing to redo.
+int redoPieceTable(undoLog *log, pieceTable *table, undoRecord *record)
+{
+    if (log->position == log->count)
+    {
+        return 0;
+    }
+
+    undoRecord *redone = &log->records[log->position++];
+    if (redone->kind == editInsert)
+    {
+        insertPieceTable(table, redone->offset, log->newBytes + redone->start, redone->length);
+    }
+    else if (redone->kind == editDelete)
+    {
+        deletePieceTable(table, redone->offset, redone->length);
+    }
+    else
+    {
+        writePieceTable(table, redone->offset, log->newBytes + redone->start, redone->length);
+    }
+    log->sealed = 1;
+
+    if (record)
+    {
+        *record = *redone;
+    }
+    return 1;
+}
+
+// Frees an undo log.
+// log: pointer to the log.
+void freeUndoLog(undoLog *log)
+{
+    if (log == NULL)
+    {
+        return;
+    }
+
+    free(log->records);
+    free(log->oldBytes);
+    free(log->newBytes);
+    free(log);
+}
+
+#endif